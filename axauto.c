@@ -5,13 +5,35 @@
  * knowledge on how to use the library.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <semaphore.h>
 #include <fixmath.h>
+#ifdef PANORAMATV_SIM
+#include <malloc.h>
+#endif
 #include <axsdk/axptz.h>
 #include <axsdk/axparameter.h>
 #include <licensekey.h>
+#include "motion.h"
+#include "motion_math.h"
+#include "trace.h"
+#include "status_snapshot.h"
+#include "preset_interrupt.h"
+#include "tour_sync.h"
+#include "lap_plan.h"
 
 /* This activates logging to syslog */
 #define WRITE_TO_SYS_LOG
@@ -19,9 +41,7 @@
 #ifdef WRITE_TO_SYS_LOG
 #define LOGINFO(fmt, args...) \
   do { \
-    syslog(LOG_INFO, fmt, ## args); \
-    printf(fmt, ## args); \
-    printf("\n"); \
+    log_info(fmt, ## args); \
   } while(0)
 #else
 #define LOGINFO(fmt, args...)
@@ -42,44 +62,815 @@
 #define MAJOR_VERSION 1
 #define MINOR_VERSION 0
 
-/* The number of fractional bits used in fix-point variables */
-#define FIXMATH_FRAC_BITS 16
-
 #define VIDEO_CHANNEL 1
 
 #define MAX_PAN_TILT_SPEED 0.5
 #define MIN_PAN_TILT_SPEED 0.1
+#define SCURVE_MAX_PAN_TILT_SPEED 1.0
 #define MAX_PRESET_NUMBER 20
+#define MAX_PRESET_NAME_LENGTH 30
+
+/* Tour profiles, selected by a preset name prefix such as "night_" */
+#define MAX_TOUR_PROFILES 8
+#define TOUR_PROFILE_NAME_LENGTH 16
+#define DEFAULT_TOUR_PROFILE "default"
 
 #define NPT 2 //the number of points between the presets
 
 #define SLEEP_TIME_MILLISECONDS 100
 
-typedef struct PTZ_POS{
-  
-	fixed_t pan_val;
-	fixed_t tilt_val;
-	fixed_t zoom_val;
-  
-}PTZ_POS;
+/* Real-time control thread defaults, overridden by parameters */
+#define RT_DEFAULT_PRIORITY 50
+#define RT_MIN_PRIORITY 1
+#define RT_MAX_PRIORITY 99
+
+/* Tick latency histogram: 100 us buckets up to one full tick */
+#define TICK_HIST_BUCKET_US 100
+#define TICK_HIST_BUCKETS ((SLEEP_TIME_MILLISECONDS * 1000) / TICK_HIST_BUCKET_US + 1)
+
+#define METRICS_INTERVAL_SECONDS 60
+
+/* Log ring between the logging threads and the log thread */
+#define LOG_RING_LENGTH 256
+#define LOG_MESSAGE_LENGTH 256
+#define LOG_SLOT_WAIT_US 100
+
+/* Constant on-screen velocity */
+#define PAN_MAX_DEGREES_PER_SECOND 700.0
+#define TILT_MAX_DEGREES_PER_SECOND 500.0
+#define WIDE_FIELD_OF_VIEW_DEFAULT 58.9f
+#define MAX_ZOOM_RATIO_DEFAULT 24.0f
+#define SCREEN_SPEED_DEFAULT_LIMIT 0.5f
+#define SCREEN_SPEED_RESCALE 0.05
+#define ZOOM_FOV_TABLE_SIZE 64
+#define UNITS_PER_DEGREE (32768.0 / 180.0)
+
+/* S-curve speed ramps, limits in unitless speed per second (squared) */
+#define SCURVE_DEFAULT_ACCEL 1.0f
+#define SCURVE_DEFAULT_JERK 4.0f
+#define SCURVE_UPDATE_STEP 0.05f
+#define PAN_UNITS_PER_SECOND (PAN_MAX_DEGREES_PER_SECOND * UNITS_PER_DEGREE)
+#define TILT_UNITS_PER_SECOND (TILT_MAX_DEGREES_PER_SECOND * UNITS_PER_DEGREE)
+
+/* Coverage scan */
+#define SCAN_PROFILE_NAME "scan"
+#define SCAN_OVERLAP_DEFAULT 0.2f
+#define SCAN_OVERLAP_MAX 0.9f
+#define SCAN_MAX_ROWS 64
+
+/* Teach mode, holds and speeds in camera time */
+#define TEACH_PROFILE_NAME "teach"
+#define TEACH_PLAN_DEFAULT_FILE "/tmp/panoramatv.teach"
+#define TEACH_DEFAULT_SECONDS 60
+#define TEACH_MAX_SECONDS 3600
+#define TEACH_DEFAULT_TOLERANCE_UNITS 100
+#define TEACH_MIN_HOLD_MS 500
+#define TEACH_MIN_SPEED 0.02f
+
+/* Status sampler */
+#define STATUS_SAMPLE_DEFAULT_HZ 20
+#define STATUS_SAMPLE_MAX_HZ 100
+#define STATUS_HISTORY_LENGTH 32
+#define STATUS_VELOCITY_WINDOW_US (500 * 1000)
+#define JITTER_BENCH_DEFAULT_SECONDS 20
+
+/* Soak benchmark, simulator build only */
+#define SOAK_DEFAULT_TICKS 2000000
+#define SOAK_TICK_PERIOD_US 200
+#define SOAK_TIMESCALE "500"
+#define SOAK_MAX_GROWTH_KB 256
+
+/* Error domain and missing preset code of sim/axptz_sim.c */
+#define SIM_ERROR_DOMAIN "axptz-sim-error"
+#define SIM_ERROR_NO_PRESET 2
+
+/* Lap benchmark, simulator build only */
+#define LAP_BENCH_DEFAULT_LAPS 5
+#define LAP_BENCH_TIMESCALE 20
+
+/* Corner blending at pass-through waypoints, fraction of the segment */
+#define BLEND_TOLERANCE_DEFAULT 0.2f
+#define BLEND_TOLERANCE_MAX 0.5f
+
+/* Segment executor, distances in unitless position units */
+#define ABSOLUTE_HOP_DEFAULT_UNITS 1500
+#define FINAL_APPROACH_DEFAULT_UNITS 1000
+#define ARRIVAL_TOLERANCE_DEFAULT_UNITS 100
+#define ABSOLUTE_MOVE_TIMEOUT_TICKS 300
+#define ABSOLUTE_MOVE_START_TICKS 2
+#define ACCURACY_MIN_SAMPLES 3
+#define ACCURACY_RESAMPLE_INTERVAL 10
+#define ACCURACY_SAMPLE_WAIT_TICKS 8
+
+/* Preemption, bounds for the poll_time the control queue asks for */
+#define PAUSE_MIN_POLL_MS 100
+#define PAUSE_MAX_POLL_MS 5000
+
+/* Stall detection, the window is in camera time and scaled with the tick */
+#define STALL_DEFAULT_WINDOW_MS 1500
+#define STALL_DEFAULT_MIN_PROGRESS_UNITS 100
+#define STALL_RING_LENGTH 64
+#define STALL_RECOVERY_TIMEOUT_TICKS 100
+
+/* Settle detection after preset moves, in camera time and scaled with the tick */
+#define SETTLE_POLL_MIN_MS 20
+#define SETTLE_POLL_MAX_MS 160
+#define SETTLE_DENSE_LEAD_MS 100
+#define SETTLE_START_MS 300
+#define SETTLE_STABLE_POLLS 2
+#define SETTLE_SLOWDOWN 0.9
+#define SETTLE_TOLERANCE_UNITS 4
+#define SETTLE_TIMEOUT_FACTOR 3.0
+#define SETTLE_TIMEOUT_MARGIN_MS 3000
+#define CALIBRATION_PRESET_SPEED 0.4f
+
+/* Residual correction at presets */
+#define CORRECTION_TOLERANCE_DEFAULT_UNITS 50
+#define CORRECTION_DEFAULT_MAX_MOVES 2
+#define CORRECTION_DEFAULT_BUDGET_MS 1000
+
+/* Drift check of the calibrated presets during dwell, in camera time */
+#define DRIFT_DEFAULT_LAPS 1
+#define DRIFT_DEFAULT_TOLERANCE_UNITS 20
+#define DRIFT_DEFAULT_MAX_STEP_UNITS 100
+#define DRIFT_MIN_DWELL_MS 1500
+#define DRIFT_PRESET_SPEED 0.4f
+
+/* Preset interrupt */
+#define INTERRUPT_DEFAULT_HOLD_MS 10000
+#define INTERRUPT_MAX_HOLD_MS 3600000
+#define INTERRUPT_SPEED 1.0f
+#define INTERRUPT_POLL_MS 200
+#define INTERRUPT_MOVE_TIMEOUT_TICKS 300
+#define INTERRUPT_MOTION_UNITS 50
+#define INTERRUPT_TRIGGER_MAX_AGE_US (10 * G_USEC_PER_SEC)
+
+/* Synchronized tours, the tolerance in camera time */
+#define SYNC_DEFAULT_TOLERANCE_MS 500
+#define SYNC_PERIOD_MARGIN 1.1
+#define SYNC_MAX_SPEED_SCALE 1.5
+#define SYNC_SPEED_GAIN 5.0
+#define SYNC_ANNOUNCE_MS 1000
+#define SYNC_SCHEDULE_TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+/* Lap-time budget, in camera time */
+#define BUDGET_DEFAULT_TOLERANCE_MS 1000
+
+/* Recovery from axptz errors, backoff in camera time */
+#define ERROR_DEFAULT_RETRIES 20
+#define ERROR_DEFAULT_REINIT_AFTER 3
+#define ERROR_BACKOFF_MIN_MS 100
+#define ERROR_BACKOFF_MAX_MS 10000
+
+/* Motion trace */
+#define TRACE_DEFAULT_FILE "/tmp/panoramatv.trace"
+
+/* Dry run, model accelerations in unitless speed per second */
+#define PRESET_FILE_DEFAULT "/tmp/panoramatv.presets"
+#define PREDICT_DEFAULT_ACCEL 2.0f
+#define PREDICT_DEFAULT_LATENCY_MS 40
+#define PREDICT_ZOOM_FULL_RANGE_SECONDS 3.0
+#define PREDICT_DEFAULT_ZOOM_MIN 3
+#define PREDICT_DEFAULT_ZOOM_MAX 35748
+
+/* axptz hands out plain g_malloc'ed status and limits structs */
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(AXPTZStatus, g_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(AXPTZLimits, g_free)
 
 /* global variables */
 static AXPTZControlQueueGroup *ax_ptz_control_queue_group = NULL;
 static GList *capabilities = NULL;
-static AXPTZStatus *unitless_status = NULL;
+static GList* realPath = NULL;//path of the active tour profile
+
+/*
+ * A tour profile: the presets named with one prefix ("default" for none),
+ * calibrated and compiled into its own path once at start
+ */
+typedef struct TOUR_PROFILE{
+
+	gchar name[TOUR_PROFILE_NAME_LENGTH];
+	gint preset_numbers[MAX_PRESET_NUMBER + 1];
+	gint preset_indices[MAX_PRESET_NUMBER + 1];
+	gint preset_delay[MAX_PRESET_NUMBER + 1];
+	gint preset_count;
+	GList *stops;	/* calibrated preset positions in tour order */
+	GList *path;	/* the stops with the interpolated waypoints */
+	gint npt;	/* interpolated waypoints after each stop */
+	gboolean scan;	/* a coverage scan between two corner presets */
+	gdouble scan_area;	/* square degrees imaged per scan cycle */
+	gboolean teach;	/* a taught path, replayed with its own timing */
+	gfloat *teach_speeds;	/* max speed of the segment to each waypoint */
+	gint *teach_holds;	/* hold at each waypoint in ms */
+	gboolean budgeted;	/* speed and dwells planned for LapTarget */
+	gfloat budget_speed;
+	gint budget_delay[MAX_PRESET_NUMBER + 1];
+
+}TOUR_PROFILE;
+
+static TOUR_PROFILE tour_profiles[MAX_TOUR_PROFILES];
+static gint tour_profile_count = 0;
+
+/* presets already calibrated, shared by the tour profiles */
+static gint calibrated_indices[MAX_TOUR_PROFILES * MAX_PRESET_NUMBER];
+static PTZ_POS calibrated_positions[MAX_TOUR_PROFILES * MAX_PRESET_NUMBER];
+static gint calibrated_count = 0;
+
+/* where the presets settled in the last run, to time the settle polls */
+static gint settle_hint_indices[MAX_TOUR_PROFILES * MAX_PRESET_NUMBER];
+static PTZ_POS settle_hint_positions[MAX_TOUR_PROFILES * MAX_PRESET_NUMBER];
+static gint settle_hint_count = 0;
+static gint active_profile = 0;//tour thread only
+static gint requested_profile = 0;//atomic, set by the TourProfile callback
 
 static fixed_t fx_zero = fx_itox(0, FIXMATH_FRAC_BITS);
 static fixed_t fx_two = fx_ftox(2.0f, FIXMATH_FRAC_BITS);
 static fixed_t fx_four = fx_ftox(4.0f, FIXMATH_FRAC_BITS);
 
 static fixed_t arrival_accuracy = fx_ftox(0.002f, FIXMATH_FRAC_BITS);
+static fixed_t blend_tolerance = fx_ftox(BLEND_TOLERANCE_DEFAULT, FIXMATH_FRAC_BITS);
+static gboolean endless_pan = TRUE;//pan limits are one full turn apart
+static fixed_t pan_limit_min = 0;
+static fixed_t pan_limit_max = 0;
+static fixed_t tilt_limit_min = 0;
+static fixed_t tilt_limit_max = 0;
 
 static gfloat cont_max_speed = 0.3f;//max pan_tilt_speed
+
+/* jerk-limited speed ramps of continuous segments */
+static gboolean scurve_mode = FALSE;
+static gfloat scurve_accel = SCURVE_DEFAULT_ACCEL;
+static gfloat scurve_jerk = SCURVE_DEFAULT_JERK;
+static MOTION_SCURVE scurve;
 static gint stop_in_preset = 0;//stop in preset for 1 sec
 
 static gint queue_pos = -1;
 static gint time_to_pos_one = -1;
 static gint poll_time = -1;
+
+/* real-time control thread settings */
+static gboolean rt_mode = FALSE;
+static gint rt_priority = RT_DEFAULT_PRIORITY;
+static gint rt_cpu = -1;
+static gboolean rt_lock_memory = TRUE;
+
+/* logging thread, keeps syslog/stdout writes off the control thread */
+typedef struct LOG_SLOT{
+
+	gint ready;
+	gchar text[LOG_MESSAGE_LENGTH];
+
+}LOG_SLOT;
+
+static LOG_SLOT log_ring[LOG_RING_LENGTH];
+static gint log_head = 0;//slots handed out
+static gint log_tail = 0;//slots written out
+static gint log_dropped = 0;
+static gint log_running = FALSE;
+static sem_t log_pending;
+static GThread *log_thread = NULL;
+
+/* tick latency statistics, written by the control thread, read by metrics */
+static gint tick_histogram[TICK_HIST_BUCKETS];
+static gint tick_overruns = 0;
+static gint tick_max_latency_us = 0;
+
+static GMainLoop *main_loop = NULL;
+
+/* control tick, shortened by the soak benchmark */
+static gint64 tick_period_us = SLEEP_TIME_MILLISECONDS * 1000;
+static gint tick_count = 0;
+static gint tour_running = TRUE;
+static gint tour_lap_limit = 0;
+static gboolean log_discard = FALSE;
+
+/* tour profile to start with, TourProfile parameter */
+static gchar *tour_profile_name = NULL;
+
+/* motion trace settings */
+static gboolean trace_mode = FALSE;
+static gchar *trace_file = NULL;
+static gint trace_capacity = TRACE_DEFAULT_RECORDS;
+/* max speed the traced segments were planned with, as in the last TRACE_CONFIG or TRACE_SPEED */
+static fixed_t traced_max_speed = 0;
+
+/* status snapshot for status.cgi */
+static gboolean status_snapshot_mode = TRUE;
+
+/* coverage scan settings */
+static gboolean scan_mode = FALSE;
+static gint scan_corners[2] = { 0, 0 };
+static gfloat scan_zoom_ratio = 0.0f;//0 for the zoom of the first corner
+static gfloat scan_overlap = SCAN_OVERLAP_DEFAULT;
+
+/* scan cycles, written by the tour thread */
+static gint scan_cycle_count = 0;
+static gint64 scan_cycle_sum_us = 0;
+static gint64 scan_cycle_last_us = 0;
+static gdouble scan_area_sum = 0;
+
+/* teach mode settings */
+static gboolean teach_mode = FALSE;
+static gchar *teach_plan_file = NULL;
+static gint teach_tolerance_units = TEACH_DEFAULT_TOLERANCE_UNITS;
+static gint teach_seconds = 0;//recording time of --teach
+
+/* dry run: presets from a file, nothing is sent to the camera */
+static gboolean dry_run = FALSE;
+static gfloat predict_accel[3] = { PREDICT_DEFAULT_ACCEL, PREDICT_DEFAULT_ACCEL, PREDICT_DEFAULT_ACCEL };
+static gint predict_latency_ms = PREDICT_DEFAULT_LATENCY_MS;
+
+/* preset interrupt settings */
+static gboolean interrupt_mode = FALSE;
+static gchar *interrupt_socket = NULL;
+static gint interrupt_hold_ms = INTERRUPT_DEFAULT_HOLD_MS;
+
+/* synchronized tour settings */
+typedef enum
+{
+	SYNC_OFF,
+	SYNC_LEADER,
+	SYNC_FOLLOWER
+} SYNC_MODE;
+
+static const gchar *sync_mode_names[] = { "off", "leader", "follower" };
+
+static gint sync_mode = SYNC_OFF;
+static gchar *sync_group = NULL;
+static gint sync_port = TOUR_SYNC_DEFAULT_PORT;
+static gint sync_period_ms = 0;//0 for the predicted lap with a margin
+static gfloat sync_phase = 0.0f;//share of the period behind the epoch
+static gint sync_tolerance_ms = SYNC_DEFAULT_TOLERANCE_MS;
+
+/* lap-time budget settings */
+static gint lap_target_ms = 0;//0 for no budget
+static gint lap_tolerance_ms = BUDGET_DEFAULT_TOLERANCE_MS;
+
+/* axptz error recovery settings */
+static gint error_retries = ERROR_DEFAULT_RETRIES;
+static gint error_reinit_after = ERROR_DEFAULT_REINIT_AFTER;//0 for never
+
+static void report_status_metrics(void);
+static void report_arrival_metrics(void);
+static void publish_status(gint state, gint segment, const PTZ_POS *from, const PTZ_POS *target);
+static gfloat profile_max_speed(const TOUR_PROFILE *profile, gint count);
+static void sync_start_lap(GList *first);
+static gfloat sync_max_speed(gint count, gfloat max_speed);
+static gint sync_dwell_ms(gint count, gint delay_ms);
+static void budget_plan_profile(gint index);
+static void budget_prepare(gint index);
+static void budget_start_lap(GList *first);
+static void budget_end_lap(gint64 lap_us);
+static gint budget_dwell_ms(gint count, gint delay_ms);
+
+typedef struct TICK_TIMER{
+
+	gint64 period_us;
+	gint64 next_us;
+	gboolean record_latency;
+
+}TICK_TIMER;
+
+/*
+ * Write a log line, through the logging thread when it is running. The
+ * line is formatted into a preallocated ring slot, so a real-time thread
+ * logs without malloc and without a lock the log thread could hold; when
+ * syslog falls behind and the ring is full the line is dropped and counted.
+ */
+static void log_info(const gchar *fmt, ...)
+{
+	va_list args;
+
+	if(log_discard)
+		return;
+	va_start(args, fmt);
+	if(g_atomic_int_get(&log_running))
+	{
+		gint head;
+
+		do
+		{
+			head = g_atomic_int_get(&log_head);
+			if((guint)(head - g_atomic_int_get(&log_tail)) >= LOG_RING_LENGTH)
+			{
+				g_atomic_int_inc(&log_dropped);
+				va_end(args);
+				return;
+			}
+		}
+		while(!g_atomic_int_compare_and_exchange(&log_head, head, head + 1));
+		vsnprintf(log_ring[(guint)head % LOG_RING_LENGTH].text, LOG_MESSAGE_LENGTH, fmt, args);
+		g_atomic_int_set(&log_ring[(guint)head % LOG_RING_LENGTH].ready, TRUE);
+		sem_post(&log_pending);
+	}
+	else
+	{
+		gchar *msg = g_strdup_vprintf(fmt, args);
+		syslog(LOG_INFO, "%s", msg);
+		printf("%s\n", msg);
+		g_free(msg);
+	}
+	va_end(args);
+}
+
+static gpointer log_thread_func(gpointer data)
+{
+	gint dropped = 0;
+
+	for(;;)
+	{
+		LOG_SLOT *slot;
+		gint tail = g_atomic_int_get(&log_tail);
+
+		while(sem_wait(&log_pending) != 0 && errno == EINTR)
+			;
+		if(tail == g_atomic_int_get(&log_head))
+		{
+			if(!g_atomic_int_get(&log_running))
+				break;
+			continue;
+		}
+		/* a writer that took the slot before a later one may still be formatting */
+		slot = &log_ring[(guint)tail % LOG_RING_LENGTH];
+		while(!g_atomic_int_get(&slot->ready))
+			g_usleep(LOG_SLOT_WAIT_US);
+		if(!log_discard)
+		{
+			syslog(LOG_INFO, "%s", slot->text);
+			printf("%s\n", slot->text);
+		}
+		g_atomic_int_set(&slot->ready, FALSE);
+		g_atomic_int_set(&log_tail, tail + 1);
+		if(g_atomic_int_get(&log_dropped) != dropped)
+		{
+			dropped = g_atomic_int_get(&log_dropped);
+			syslog(LOG_INFO, "%d log lines dropped so far, the log ring was full", dropped);
+		}
+	}
+	fflush(stdout);
+	return NULL;
+}
+
+static void start_log_thread(void)
+{
+	sem_init(&log_pending, 0, 0);
+	g_atomic_int_set(&log_running, TRUE);
+	log_thread = g_thread_new("log", log_thread_func, NULL);
+}
+
+/*
+ * Flush the pending log lines and fall back to direct logging
+ */
+static void stop_log_thread(void)
+{
+	if(log_thread == NULL)
+		return;
+	g_atomic_int_set(&log_running, FALSE);
+	sem_post(&log_pending);
+	g_thread_join(log_thread);
+	log_thread = NULL;
+	sem_destroy(&log_pending);
+}
+
+/*
+ * Put the calling thread under SCHED_FIFO and pin it to the configured cpu
+ */
+static gboolean apply_realtime_settings(gint priority, gint cpu)
+{
+	struct sched_param sp;
+	gboolean ok = TRUE;
+	gint ret;
+
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = priority;
+	if((ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp)) != 0)
+	{
+		LOGINFO("CAN NOT SET SCHED_FIFO PRIORITY %d: %s", priority, strerror(ret));
+		ok = FALSE;
+	}
+
+	if(cpu >= 0)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		if((ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) != 0)
+		{
+			LOGINFO("CAN NOT PIN CONTROL THREAD TO CPU %d: %s", cpu, strerror(ret));
+			ok = FALSE;
+		}
+	}
+	return ok;
+}
+
+/*
+ * Stay in a preset for delay_ms, in control ticks so the soak benchmark can
+ * run the tour faster than real time
+ */
+static void dwell(gint delay_ms)
+{
+	g_usleep((gint64)delay_ms * tick_period_us / SLEEP_TIME_MILLISECONDS);
+}
+
+static void tick_timer_start(TICK_TIMER *timer, gint64 period_us, gboolean record_latency)
+{
+	timer->period_us = period_us;
+	timer->record_latency = record_latency;
+	timer->next_us = g_get_monotonic_time() + period_us;
+}
+
+/*
+ * Sleep until the next absolute tick deadline and record how late we woke up.
+ * Deadlines are absolute so a slow tick does not push every later tick back.
+ */
+static gint64 tick_timer_wait(TICK_TIMER *timer)
+{
+	struct timespec ts;
+	gint64 now;
+	gint64 latency;
+
+	ts.tv_sec = timer->next_us / G_USEC_PER_SEC;
+	ts.tv_nsec = (timer->next_us % G_USEC_PER_SEC) * 1000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+
+	now = g_get_monotonic_time();
+	latency = now - timer->next_us;
+	if(latency < 0)
+		latency = 0;
+
+	if(timer->record_latency)
+	{
+		g_atomic_int_inc(&tick_count);
+		if(latency / TICK_HIST_BUCKET_US < TICK_HIST_BUCKETS - 1)
+			g_atomic_int_inc(&tick_histogram[latency / TICK_HIST_BUCKET_US]);
+		else
+			g_atomic_int_inc(&tick_histogram[TICK_HIST_BUCKETS - 1]);
+		if(latency > g_atomic_int_get(&tick_max_latency_us))
+			g_atomic_int_set(&tick_max_latency_us, (gint)latency);
+	}
+
+	timer->next_us += timer->period_us;
+	if(timer->next_us <= now)
+	{
+		/* we missed at least one whole tick, resynchronise */
+		if(timer->record_latency)
+			g_atomic_int_inc(&tick_overruns);
+		timer->next_us = now + timer->period_us;
+	}
+	return latency;
+}
+
+/*
+ * Latency in microseconds below which the given fraction of ticks fall
+ */
+static gint tick_histogram_percentile(const gint *hist, gint total, gdouble fraction)
+{
+	gint i;
+	gint sum = 0;
+	gint limit = (gint)(total * fraction);
+
+	for(i = 0 ; i < TICK_HIST_BUCKETS ; i ++)
+	{
+		sum += hist[i];
+		if(sum > limit)
+			return (i + 1) * TICK_HIST_BUCKET_US;
+	}
+	return TICK_HIST_BUCKETS * TICK_HIST_BUCKET_US;
+}
+
+/*
+ * Take the tick histogram gathered since the last call and return its size
+ */
+static gint tick_histogram_take(gint *hist)
+{
+	gint i;
+	gint total = 0;
+
+	for(i = 0 ; i < TICK_HIST_BUCKETS ; i ++)
+	{
+		do
+		{
+			hist[i] = g_atomic_int_get(&tick_histogram[i]);
+		}
+		while(!g_atomic_int_compare_and_exchange(&tick_histogram[i], hist[i], 0));
+		total += hist[i];
+	}
+	return total;
+}
+
+/*
+ * Periodic metrics report, runs in the main loop at normal priority
+ */
+static gboolean report_metrics(gpointer data)
+{
+	gint hist[TICK_HIST_BUCKETS];
+	gint total = tick_histogram_take(hist);
+
+	if(total > 0)
+	{
+		LOGINFO("TICK LATENCY ticks:%d p50:%dus p90:%dus p99:%dus p99.9:%dus max:%dus overruns:%d",
+			total,
+			tick_histogram_percentile(hist, total, 0.50),
+			tick_histogram_percentile(hist, total, 0.90),
+			tick_histogram_percentile(hist, total, 0.99),
+			tick_histogram_percentile(hist, total, 0.999),
+			g_atomic_int_get(&tick_max_latency_us),
+			g_atomic_int_get(&tick_overruns));
+	}
+	report_status_metrics();
+	report_arrival_metrics();
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean quit_main_loop(gpointer data)
+{
+	if(main_loop != NULL)
+		g_main_loop_quit(main_loop);
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Synthetic tick-latency benchmark. Runs the same absolute-deadline tick loop
+ * as the tour, idle and with one busy thread per cpu, with and without the
+ * real-time settings, and prints the latency percentiles of each run.
+ */
+static gint jitter_bench_hogs_running = 0;
+static gint jitter_bench_seconds = JITTER_BENCH_DEFAULT_SECONDS;
+
+static gpointer jitter_bench_hog_func(gpointer data)
+{
+	volatile guint64 spin = 0;
+
+	while(g_atomic_int_get(&jitter_bench_hogs_running))
+		spin ++;
+	return NULL;
+}
+
+static gpointer jitter_bench_tick_func(gpointer data)
+{
+	gboolean realtime = GPOINTER_TO_INT(data);
+	TICK_TIMER timer;
+	gint64 end;
+
+	if(realtime)
+		apply_realtime_settings(rt_priority, rt_cpu);
+
+	end = g_get_monotonic_time() + (gint64)jitter_bench_seconds * G_USEC_PER_SEC;
+	tick_timer_start(&timer, SLEEP_TIME_MILLISECONDS * 1000, TRUE);
+	while(g_get_monotonic_time() < end)
+		tick_timer_wait(&timer);
+	return NULL;
+}
+
+static void run_jitter_bench(void)
+{
+	const struct
+	{
+		const gchar *name;
+		gboolean realtime;
+		gboolean hog;
+	} runs[] = {
+		{ "normal   idle   ", FALSE, FALSE },
+		{ "normal   cpu-hog", FALSE, TRUE },
+		{ "realtime cpu-hog", TRUE, TRUE },
+	};
+	gint hist[TICK_HIST_BUCKETS];
+	gint ncpu = (gint)sysconf(_SC_NPROCESSORS_ONLN);
+	gint r;
+	gint i;
+
+	if(ncpu < 1)
+		ncpu = 1;
+	printf("tick latency, %d ms period, %d s per run, %d hog threads, priority %d cpu %d\n",
+		SLEEP_TIME_MILLISECONDS, jitter_bench_seconds, ncpu, rt_priority, rt_cpu);
+	printf("run               ticks    p50    p90    p99  p99.9    max  overruns (us)\n");
+
+	for(r = 0 ; r < (gint)G_N_ELEMENTS(runs) ; r ++)
+	{
+		GThread *hogs[ncpu];
+		GThread *ticker;
+		gint total;
+
+		tick_histogram_take(hist);
+		g_atomic_int_set(&tick_max_latency_us, 0);
+		g_atomic_int_set(&tick_overruns, 0);
+
+		if(runs[r].realtime && rt_lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+			printf("CAN NOT LOCK MEMORY: %s\n", strerror(errno));
+
+		g_atomic_int_set(&jitter_bench_hogs_running, runs[r].hog);
+		for(i = 0 ; i < ncpu ; i ++)
+			hogs[i] = runs[r].hog ? g_thread_new("hog", jitter_bench_hog_func, NULL) : NULL;
+
+		ticker = g_thread_new("ticker", jitter_bench_tick_func, GINT_TO_POINTER(runs[r].realtime));
+		g_thread_join(ticker);
+
+		g_atomic_int_set(&jitter_bench_hogs_running, FALSE);
+		for(i = 0 ; i < ncpu ; i ++)
+		{
+			if(hogs[i] != NULL)
+				g_thread_join(hogs[i]);
+		}
+		if(runs[r].realtime && rt_lock_memory)
+			munlockall();
+
+		total = tick_histogram_take(hist);
+		printf("%s %7d %6d %6d %6d %6d %6d %9d\n", runs[r].name, total,
+			tick_histogram_percentile(hist, total, 0.50),
+			tick_histogram_percentile(hist, total, 0.90),
+			tick_histogram_percentile(hist, total, 0.99),
+			tick_histogram_percentile(hist, total, 0.999),
+			g_atomic_int_get(&tick_max_latency_us),
+			g_atomic_int_get(&tick_overruns));
+	}
+}
+
+/*
+ * Read an optional integer parameter, falling back to a default
+ */
+static gint get_int_parameter(AXParameter *param, const gchar *name, gint default_value)
+{
+	GError *local_error = NULL;
+	gchar *value = NULL;
+	gint result = default_value;
+
+	if(ax_parameter_get(param, name, &value, &local_error))
+	{
+		syslog(LOG_INFO, "The value of \"%s\" is \"%s\"", name, value);
+		result = (gint)atoi(value);
+	}
+	else
+	{
+		LOGINFO("Parameter \"%s\" is not set, using %d", name, default_value);
+		g_error_free(local_error);
+	}
+	g_free(value);
+	return result;
+}
+
+/*
+ * Read an optional decimal parameter, falling back to a default
+ */
+static gfloat get_float_parameter(AXParameter *param, const gchar *name, gfloat default_value)
+{
+	GError *local_error = NULL;
+	gchar *value = NULL;
+	gfloat result = default_value;
+
+	if(ax_parameter_get(param, name, &value, &local_error))
+	{
+		syslog(LOG_INFO, "The value of \"%s\" is \"%s\"", name, value);
+		result = (gfloat)g_ascii_strtod(value, NULL);
+	}
+	else
+	{
+		LOGINFO("Parameter \"%s\" is not set, using %f", name, default_value);
+		g_error_free(local_error);
+	}
+	g_free(value);
+	return result;
+}
+
+/*
+ * Read an optional yes/no parameter, falling back to a default
+ */
+static gboolean get_bool_parameter(AXParameter *param, const gchar *name, gboolean default_value)
+{
+	GError *local_error = NULL;
+	gchar *value = NULL;
+	gboolean result = default_value;
+
+	if(ax_parameter_get(param, name, &value, &local_error))
+	{
+		syslog(LOG_INFO, "The value of \"%s\" is \"%s\"", name, value);
+		result = (g_ascii_strcasecmp(value, "yes") == 0 || g_ascii_strcasecmp(value, "true") == 0 || g_strcmp0(value, "1") == 0);
+	}
+	else
+	{
+		LOGINFO("Parameter \"%s\" is not set, using %s", name, default_value ? "yes" : "no");
+		g_error_free(local_error);
+	}
+	g_free(value);
+	return result;
+}
+
+/*
+ * Read an optional text parameter, falling back to a default. Free the result.
+ */
+static gchar *get_string_parameter(AXParameter *param, const gchar *name, const gchar *default_value)
+{
+	GError *local_error = NULL;
+	gchar *value = NULL;
+
+	if(ax_parameter_get(param, name, &value, &local_error))
+	{
+		syslog(LOG_INFO, "The value of \"%s\" is \"%s\"", name, value);
+		return value;
+	}
+	LOGINFO("Parameter \"%s\" is not set, using %s", name, default_value);
+	g_error_free(local_error);
+	return g_strdup(default_value);
+}
 /* camera information
  * Pan Max 180 
  * Pan Min -180
@@ -112,11 +903,10 @@ static void logCameraInfo(char *fmt)
  */
 static gboolean get_ptz_move_capabilities(void)
 {
-	GError *local_error = NULL;
+	g_autoptr(GError) local_error = NULL;
 
 	if (!(capabilities = ax_ptz_movement_handler_get_move_capabilities(VIDEO_CHANNEL, &local_error))) 
 	{
-		g_error_free(local_error);
 		return FALSE;
 	}
 	LOGINFO("GETTING capabilities");
@@ -152,57 +942,53 @@ static gboolean is_capability_supported(const char *capability)
 }
 
 /*
- * Wait for the camera to reach it's position
+ * Preset interrupt state. The interrupt thread sends the preset move and
+ * sets interrupt_active with ptz_command_lock held. The movement commands
+ * below take the same lock and are dropped while the interrupt has the
+ * camera, so no tour command already on its way can follow the preset
+ * move. The tour thread notices at its next tick, holds the preset and
+ * clears interrupt_active again. While the tour is paused for another
+ * control queue client control_paused is set and triggers are rejected.
  */
-static gboolean wait_for_camera_movement_to_finish()
-{
-	gboolean is_moving = TRUE;
-	gushort timer = 0;
-	gushort timeout = 5000;
-	GError *local_error = NULL;
+typedef struct PRESET_INTERRUPT{
 
-	/* Check if camera is moving */
-	if (!(ax_ptz_movement_handler_is_ptz_moving(VIDEO_CHANNEL, &is_moving, &local_error))) 
-	{
-		g_error_free(local_error);
-		return FALSE;
-	}
-
-	/* Wait until camera is in position or until we get a timeout */
-	while (is_moving && (timer < timeout)) 
-	{
-		if (!(ax_ptz_movement_handler_is_ptz_moving(VIDEO_CHANNEL, &is_moving, &local_error))) 
-		{
-			LOGINFO(local_error->message);
-			g_error_free(local_error);
-			return FALSE;
-		}
+	gint preset;
+	gint hold_ms;
+	gint64 trigger_us;	/* the sender's time when it sent one */
+	gint64 command_us;	/* the preset move went out */
+	gint sequence;		/* bumped per trigger, a new one restarts the hold */
+	gboolean release;
 
-		usleep(SLEEP_TIME_MILLISECONDS * 1000);
+}PRESET_INTERRUPT;
 
-		timer++;
-	}
+static GMutex ptz_command_lock;
+static gint interrupt_active = FALSE;
+static gboolean control_paused = FALSE;//guarded by ptz_command_lock
+static PRESET_INTERRUPT interrupt_request;//guarded by ptz_command_lock
 
-	if (is_moving) 
-	{
-		/* Camera is still moving */
-		LOGINFO("WAITING FOR CAMERA MOVEMENT TO FINISH TIME OUT");
-		return FALSE;
-	} 
-	else 
-	{
-		/* Camera is in position */
-		return TRUE;
-	}
-}
+/* interrupt statistics, the command latency is written by the interrupt thread, the rest by the tour thread */
+static gint interrupt_count = 0;
+static gint64 interrupt_command_latency_sum_us = 0;
+static gint64 interrupt_command_latency_max_us = 0;
+static gint interrupt_motion_count = 0;
+static gint64 interrupt_motion_latency_sum_us = 0;
+static gint64 interrupt_motion_latency_max_us = 0;
+static gint64 interrupt_hold_total_us = 0;
 
 /*
  * Perform camera movement to absolute position
  */
-static gboolean move_to_absolute_position(fixed_t pan_value, fixed_t tilt_value, AXPTZMovementPanTiltSpace pan_tilt_space, gfloat speed, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, fixed_t zoom_value, AXPTZMovementZoomSpace zoom_space)
+static gboolean move_to_absolute_position(fixed_t pan_value, fixed_t tilt_value, AXPTZMovementPanTiltSpace pan_tilt_space, gfloat speed, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, fixed_t zoom_value, AXPTZMovementZoomSpace zoom_space, GError **error)
 {
 	AXPTZAbsoluteMovement *abs_movement = NULL;
-	GError *local_error = NULL;
+	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+	/* the preset interrupt has the camera */
+	if(g_atomic_int_get(&interrupt_active))
+		return TRUE;
+
+	trace_write(TRACE_COMMAND, TRACE_CMD_ABSOLUTE, pan_value, tilt_value, zoom_value, fx_ftox(speed, FIXMATH_FRAC_BITS), 0, 0);
 
 	/* Set the unit spaces for an absolute movement */
 	if ((ax_ptz_movement_handler_set_absolute_spaces(pan_tilt_space, pan_tilt_speed_space, zoom_space, &local_error))) 
@@ -216,7 +1002,7 @@ static gboolean move_to_absolute_position(fixed_t pan_value, fixed_t tilt_value,
 			{
 				ax_ptz_absolute_movement_destroy(abs_movement, NULL);
 				LOGINFO(local_error->message);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 
@@ -225,7 +1011,7 @@ static gboolean move_to_absolute_position(fixed_t pan_value, fixed_t tilt_value,
 			{	
 				ax_ptz_absolute_movement_destroy(abs_movement, NULL);
 				LOGINFO(local_error->message);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 
@@ -233,21 +1019,21 @@ static gboolean move_to_absolute_position(fixed_t pan_value, fixed_t tilt_value,
 			if (!(ax_ptz_absolute_movement_destroy(abs_movement, &local_error))) 
 			{
 				LOGINFO(local_error->message);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 		} 
 		else 
 		{
 			LOGINFO(local_error->message);
-			g_error_free(local_error);
+			g_propagate_error(error, g_steal_pointer(&local_error));
 			return FALSE;
 		}
 	}
 	else 
 	{
 		LOGINFO(local_error->message);
-		g_error_free(local_error);
+		g_propagate_error(error, g_steal_pointer(&local_error));
 		return FALSE;
 	}
 
@@ -257,10 +1043,17 @@ static gboolean move_to_absolute_position(fixed_t pan_value, fixed_t tilt_value,
 /*
  * Perform camera movement to relative position
  */
-static gboolean move_to_relative_position(fixed_t pan_value, fixed_t tilt_value, AXPTZMovementPanTiltSpace pan_tilt_space, gfloat speed, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, fixed_t zoom_value, AXPTZMovementZoomSpace zoom_space)
+static gboolean move_to_relative_position(fixed_t pan_value, fixed_t tilt_value, AXPTZMovementPanTiltSpace pan_tilt_space, gfloat speed, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, fixed_t zoom_value, AXPTZMovementZoomSpace zoom_space, GError **error)
 {
 	AXPTZRelativeMovement *rel_movement = NULL;
-	GError *local_error = NULL;
+	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+	/* the preset interrupt has the camera */
+	if(g_atomic_int_get(&interrupt_active))
+		return TRUE;
+
+	trace_write(TRACE_COMMAND, TRACE_CMD_RELATIVE, pan_value, tilt_value, zoom_value, fx_ftox(speed, FIXMATH_FRAC_BITS), 0, 0);
 
 	/* Set the unit spaces for a relative movement */
 	if ((ax_ptz_movement_handler_set_relative_spaces(pan_tilt_space, pan_tilt_speed_space, zoom_space, &local_error))) 
@@ -274,7 +1067,7 @@ static gboolean move_to_relative_position(fixed_t pan_value, fixed_t tilt_value,
 			if (!(ax_ptz_relative_movement_set_pan_tilt_zoom(rel_movement, pan_value, tilt_value, fx_ftox(speed, FIXMATH_FRAC_BITS), zoom_value, AX_PTZ_MOVEMENT_NO_VALUE, &local_error))) 
 			{
 				ax_ptz_relative_movement_destroy(rel_movement, NULL);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 
@@ -282,39 +1075,68 @@ static gboolean move_to_relative_position(fixed_t pan_value, fixed_t tilt_value,
 			if (!(ax_ptz_movement_handler_relative_move(ax_ptz_control_queue_group, VIDEO_CHANNEL, rel_movement, AX_PTZ_INVOKE_ASYNC, NULL, NULL, &local_error))) 
 			{
 				ax_ptz_relative_movement_destroy(rel_movement, NULL);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 
 			/* Now we don't need the relative movement structure anymore, destroy it */
 			if (!(ax_ptz_relative_movement_destroy(rel_movement, &local_error))) 
 			{
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 		} 
 		else 
 		{
-			g_error_free(local_error);
+			g_propagate_error(error, g_steal_pointer(&local_error));
 			return FALSE;
 		}
 	} 
 	else 
 	{
-		g_error_free(local_error);
+		g_propagate_error(error, g_steal_pointer(&local_error));
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
+/*
+ * Move to a preset the camera stores
+ */
+static gboolean move_to_preset(gint preset_index, gfloat speed, GError **error)
+{
+	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+	/* the preset interrupt has the camera */
+	if(g_atomic_int_get(&interrupt_active))
+		return TRUE;
+
+	trace_write(TRACE_COMMAND, TRACE_CMD_PRESET, preset_index, fx_ftox(speed, FIXMATH_FRAC_BITS), 0, 0, 0, 0);
+	if(!ax_ptz_preset_handler_goto_preset_number(ax_ptz_control_queue_group, VIDEO_CHANNEL, preset_index, fx_ftox(speed, FIXMATH_FRAC_BITS), AX_PTZ_PRESET_MOVEMENT_UNITLESS, AX_PTZ_INVOKE_ASYNC, NULL, NULL, &local_error))
+	{
+		LOGINFO(local_error->message);
+		g_propagate_error(error, g_steal_pointer(&local_error));
+		return FALSE;
+	}
+	return TRUE;
+}
+
 /*
  * Perform continous camera movement
  */
-static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, fixed_t zoom_speed, gfloat timeout)
+static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, fixed_t zoom_speed, gfloat timeout, GError **error)
 {
 	AXPTZContinuousMovement *cont_movement = NULL;
-	GError *local_error = NULL;
+	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+	/* the preset interrupt has the camera */
+	if(g_atomic_int_get(&interrupt_active))
+		return TRUE;
+
+	trace_write(TRACE_COMMAND, TRACE_CMD_CONTINUOUS, pan_speed, tilt_speed, zoom_speed, (gint32)(timeout * 1000), 0, 0);
 
 	/* Set the unit spaces for a continous movement */
 	if ((ax_ptz_movement_handler_set_continuous_spaces(pan_tilt_speed_space, &local_error))) 
@@ -330,7 +1152,7 @@ static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed,
 				ax_ptz_continuous_movement_destroy(cont_movement, NULL);
 				LOGINFO("SETPANTILTZOOMERR");
 				LOGINFO(local_error->message);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			} 
 
@@ -340,7 +1162,7 @@ static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed,
 				ax_ptz_continuous_movement_destroy(cont_movement, NULL);
 				LOGINFO("STARTERR");
 				LOGINFO(local_error->message);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 
@@ -349,7 +1171,7 @@ static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed,
 			{
 				LOGINFO("DESTROYERR");
 				LOGINFO(local_error->message);
-				g_error_free(local_error);
+				g_propagate_error(error, g_steal_pointer(&local_error));
 				return FALSE;
 			}
 		} 
@@ -357,7 +1179,7 @@ static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed,
 		{
 			LOGINFO("CREATEERR");
 			LOGINFO(local_error->message);
-			g_error_free(local_error);
+			g_propagate_error(error, g_steal_pointer(&local_error));
 			return FALSE;
 		}
 	} 
@@ -365,208 +1187,838 @@ static gboolean start_continous_movement(fixed_t pan_speed, fixed_t tilt_speed,
 	{
 		LOGINFO("SETSPACEERR");
 		LOGINFO(local_error->message);
-		g_error_free(local_error);
+		g_propagate_error(error, g_steal_pointer(&local_error));
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
+/*
+ * Constant on-screen velocity. The field of view shrinks with zoom, so the
+ * same unitless pan/tilt speed sweeps the image much faster at the tele end.
+ * The zoom range from the ptz limits is mapped to a horizontal field of view
+ * once at startup, assuming the magnification grows linearly with the
+ * unitless zoom value, and the pan/tilt speeds are scaled down so that the
+ * image never moves faster than screen_speed_limit image widths per second.
+ */
+static gboolean screen_speed_mode = FALSE;
+static gfloat screen_speed_limit = SCREEN_SPEED_DEFAULT_LIMIT;
+static gfloat wide_field_of_view = WIDE_FIELD_OF_VIEW_DEFAULT;
+static gfloat max_zoom_ratio = MAX_ZOOM_RATIO_DEFAULT;
+
+static gfloat zoom_fov_table[ZOOM_FOV_TABLE_SIZE];
+static fixed_t zoom_fov_min_zoom = 0;
+static fixed_t zoom_fov_max_zoom = 1;
+
+static void build_zoom_fov_table(fixed_t min_zoom, fixed_t max_zoom)
+{
+	gdouble half_wide = wide_field_of_view * G_PI / 360.0;
+	gint i;
+
+	zoom_fov_min_zoom = min_zoom;
+	zoom_fov_max_zoom = (max_zoom > min_zoom) ? max_zoom : min_zoom + 1;
+	for(i = 0 ; i < ZOOM_FOV_TABLE_SIZE ; i ++)
+	{
+		gdouble magnification = 1.0 + (max_zoom_ratio - 1.0) * i / (ZOOM_FOV_TABLE_SIZE - 1);
+		zoom_fov_table[i] = (gfloat)(atan(tan(half_wide) / magnification) * 360.0 / G_PI);
+	}
+	LOGINFO("Zoom FOV table: zoom %d..%d => %.2f..%.2f degrees", zoom_fov_min_zoom, zoom_fov_max_zoom, zoom_fov_table[0], zoom_fov_table[ZOOM_FOV_TABLE_SIZE - 1]);
+}
+
+/*
+ * Horizontal field of view in degrees at a unitless zoom value
+ */
+static gfloat zoom_to_fov(fixed_t zoom_val)
+{
+	gfloat pos = (gfloat)(zoom_val - zoom_fov_min_zoom) * (ZOOM_FOV_TABLE_SIZE - 1) / (zoom_fov_max_zoom - zoom_fov_min_zoom);
+	gint i;
+
+	if(pos <= 0)
+		return zoom_fov_table[0];
+	if(pos >= ZOOM_FOV_TABLE_SIZE - 1)
+		return zoom_fov_table[ZOOM_FOV_TABLE_SIZE - 1];
+	i = (gint)pos;
+	return zoom_fov_table[i] + (zoom_fov_table[i + 1] - zoom_fov_table[i]) * (pos - i);
+}
+
+/*
+ * Vertical field of view for a horizontal one, for the 16:9 stream
+ */
+static gfloat hfov_to_vfov(gfloat hfov)
+{
+	return (gfloat)(atan(tan(hfov * G_PI / 360.0) * 9.0 / 16.0) * 360.0 / G_PI);
+}
+
+/*
+ * Factor (at most 1) that keeps the image motion of the given pan/tilt
+ * speeds within the on-screen limit at the given zoom
+ */
+static gdouble screen_speed_scale(fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_val)
+{
+	gfloat hfov;
+	gdouble pan_screen;
+	gdouble tilt_screen;
+	gdouble screen;
+
+	if(!screen_speed_mode)
+		return 1.0;
+	hfov = zoom_to_fov(zoom_val);
+	pan_screen = fabs(fx_xtof(pan_speed, FIXMATH_FRAC_BITS)) * PAN_MAX_DEGREES_PER_SECOND / hfov;
+	tilt_screen = fabs(fx_xtof(tilt_speed, FIXMATH_FRAC_BITS)) * TILT_MAX_DEGREES_PER_SECOND / hfov_to_vfov(hfov);
+	screen = MAX(pan_screen, tilt_screen);
+	if(screen <= screen_speed_limit)
+		return 1.0;
+	return screen_speed_limit / screen;
+}
+
+static fixed_t scale_speed(fixed_t speed, gdouble scale)
+{
+	fixed_t scaled = (fixed_t)(speed * scale);
+
+	/* never scale a moving axis down to a stop */
+	if(speed != 0 && scaled == 0)
+		scaled = (speed > 0) ? 1 : -1;
+	return scaled;
+}
+
+/*
+ * Start a continuous movement with the pan/tilt speeds limited for the zoom
+ */
+static gboolean start_screen_limited_movement(fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_speed, fixed_t zoom_val, gdouble *applied_scale, GError **error)
+{
+	gdouble scale = screen_speed_scale(pan_speed, tilt_speed, zoom_val);
+
+	if(applied_scale != NULL)
+		*applied_scale = scale;
+	if(scale < 1.0)
+		LOGINFO("SCREEN SPEED SCALE %.3f at FOV %.2f", scale, zoom_to_fov(zoom_val));
+	return start_continous_movement(scale_speed(pan_speed, scale), scale_speed(tilt_speed, scale), AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS, zoom_speed, 600.0f, error);
+}
+
+/*
+ * Start the planned segment speeds at <factor> of their size. Without
+ * S-curves the factor is always 1 and a segment steps from standstill to
+ * full speed, which is what keeps MaxPanTiltSpeed at 0.5.
+ */
+static gboolean start_segment_movement(fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_speed, gfloat factor, fixed_t zoom_val, gdouble *applied_scale, GError **error)
+{
+	if(factor < 1.0f)
+	{
+		pan_speed = scale_speed(pan_speed, factor);
+		tilt_speed = scale_speed(tilt_speed, factor);
+		zoom_speed = scale_speed(zoom_speed, factor);
+	}
+	return start_screen_limited_movement(pan_speed, tilt_speed, zoom_speed, zoom_val, applied_scale, error);
+}
+
+/*
+ * Camera ticks the pan/tilt axes still need at the full planned speeds
+ */
+static gfloat scurve_remaining_ticks(const PTZ_POS *target, fixed_t pan_pos, fixed_t tilt_pos, fixed_t pan_speed, fixed_t tilt_speed)
+{
+	gdouble tick_s = SLEEP_TIME_MILLISECONDS / 1000.0;
+	gdouble ticks = 0;
+
+	if(pan_speed != 0)
+		ticks = MAX(ticks, ABS(motion_pan_delta(pan_pos, target->pan_val)) / (fabs(fx_xtof(pan_speed, FIXMATH_FRAC_BITS)) * PAN_UNITS_PER_SECOND * tick_s));
+	if(tilt_speed != 0)
+		ticks = MAX(ticks, ABS(fx_subx(target->tilt_val, tilt_pos)) / (fabs(fx_xtof(tilt_speed, FIXMATH_FRAC_BITS)) * TILT_UNITS_PER_SECOND * tick_s));
+	return (gfloat)ticks;
+}
+
 /*
  * Stop continous camera movement
  */
-static gboolean stop_continous_movement(gboolean stop_pan_tilt, gboolean stop_zoom)
+static gboolean stop_continous_movement(gboolean stop_pan_tilt, gboolean stop_zoom, GError **error)
 {
-	GError *local_error = NULL;
+	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+	/* the preset interrupt has the camera */
+	if(g_atomic_int_get(&interrupt_active))
+		return TRUE;
+
+	trace_write(TRACE_COMMAND, TRACE_CMD_STOP, stop_pan_tilt, stop_zoom, 0, 0, 0, 0);
 
 	/* Stop the continous movement */
 	if (!(ax_ptz_movement_handler_continuous_stop(ax_ptz_control_queue_group, VIDEO_CHANNEL, stop_pan_tilt, stop_zoom, AX_PTZ_INVOKE_ASYNC, NULL, NULL, &local_error))) 
 	{
 		LOGINFO(local_error->message);
 		LOGINFO("CAN NOT STOP CONTINUOUS MOVEMENT");
-		g_error_free(local_error);
+		g_propagate_error(error, g_steal_pointer(&local_error));
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
-//static gfloat arrival_accuracy = 0.001f;
+/*
+ * Background PTZ status sampler. One thread polls the status over IPC and
+ * publishes timestamped samples; the controller, metrics and logging read
+ * the latest sample (or the short history) without ever blocking on IPC.
+ *
+ * The single writer fills the slot after the newest one and only then
+ * advances the published count, so readers copy finished slots and just
+ * check afterwards that the writer has not come round the ring onto them.
+ * A reader never waits for the writer, which matters when the reader runs
+ * at a higher real-time priority on the same cpu.
+ */
+static STATUS_SAMPLE status_history[STATUS_HISTORY_LENGTH];
+static gint status_count = 0;
+static gint status_errors = 0;
+
+static gint status_sample_rate = STATUS_SAMPLE_DEFAULT_HZ;
+static gint status_sampler_running = FALSE;
+static GThread *status_sampler_thread = NULL;
 
-static gboolean is_arrived_at_specific_pan_pos(fixed_t pan_val , fixed_t pan_speed)
+static void status_slot_publish(const AXPTZStatus *ptz_status, gint64 time_us)
 {
-	AXPTZStatus* ptz_status = NULL;
-	GError* local_error = NULL;
-	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &ptz_status, &local_error))) 
-	{
-		g_free(ptz_status);
-		LOGINFO(local_error->message);
-		g_error_free(local_error);
-		return FALSE;
-	}
-	LOGINFO("ARRIVALCHECK PAN status : %d dest : %d , current pan speed : %d" , ptz_status->pan_value , pan_val , pan_speed) ;
-	if(pan_speed > 0)
-	{
-		//arrival accuracy = pan_speed / 10(time interval 100ms)
+	gint count = status_count;
+	STATUS_SAMPLE *slot = &status_history[count % STATUS_HISTORY_LENGTH];
 
-		if(ptz_status->pan_value >= fx_subx(pan_val , 200/*fx_mulx(pan_speed, fx_ftox(0.0514f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/))// 360 / 700 * 0.1
-			return TRUE;
-	}
-	else
+	slot->time_us = time_us;
+	slot->pan_val = ptz_status->pan_value;
+	slot->tilt_val = ptz_status->tilt_value;
+	slot->zoom_val = ptz_status->zoom_value;
+	g_atomic_int_set(&status_count, count + 1);
+}
+
+/*
+ * Copy up to max_samples of the newest samples, oldest first
+ */
+static gint status_history_read(STATUS_SAMPLE *samples, gint max_samples)
+{
+	gint count;
+	gint n;
+	gint i;
+
+	if(max_samples > STATUS_HISTORY_LENGTH - 2)
+		max_samples = STATUS_HISTORY_LENGTH - 2;
+	for(;;)
 	{
-		if(ptz_status->pan_value <= fx_addx(pan_val , 200/*fx_mulx(pan_speed, fx_ftox(-0.0514f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/))
-			return TRUE;
+		count = g_atomic_int_get(&status_count);
+		n = MIN(count, max_samples);
+		for(i = 0 ; i < n ; i ++)
+			samples[i] = status_history[(count - n + i) % STATUS_HISTORY_LENGTH];
+		/* the writer is filling slot <now>, it must not have reached our oldest copy */
+		if(g_atomic_int_get(&status_count) - count < STATUS_HISTORY_LENGTH - n)
+			break;
 	}
-	g_free(ptz_status);
-	return FALSE;
+	return n;
 }
 
-static gboolean is_arrived_at_specific_tilt_pos(fixed_t tilt_val , fixed_t tilt_speed)
+/*
+ * Copy the latest sample, returns FALSE if nothing has been sampled yet
+ */
+static gboolean status_slot_read(STATUS_SAMPLE *sample)
 {
-	AXPTZStatus* ptz_status = NULL;
-	GError* local_error = NULL;
-	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &ptz_status, &local_error))) 
-	{
-		g_free(ptz_status);
-		LOGINFO(local_error->message);
-		g_error_free(local_error);
+	return status_history_read(sample, 1) == 1;
+}
+
+/*
+ * Trace a sample the controller is about to act on
+ */
+static void trace_status(const STATUS_SAMPLE *sample)
+{
+	trace_write(TRACE_STATUS, 0, sample->pan_val, sample->tilt_val, sample->zoom_val, (gint32)(g_get_monotonic_time() - sample->time_us), 0, 0);
+}
+
+/*
+ * Trace the max speed of the next segment when it differs from the last one
+ * traced, so a replay plans per-segment speeds (teach, sync) the same way
+ */
+static void trace_max_speed(gfloat max_speed)
+{
+	fixed_t speed = fx_ftox(max_speed, FIXMATH_FRAC_BITS);
+
+	if(speed == traced_max_speed)
+		return;
+	trace_write(TRACE_SPEED, 0, speed, 0, 0, 0, 0, 0);
+	traced_max_speed = speed;
+}
+
+/*
+ * Velocity in units per second over the newest samples spanning window_us
+ */
+static gboolean status_history_velocity(gint64 window_us, gdouble *pan_vel, gdouble *tilt_vel, gdouble *zoom_vel)
+{
+	STATUS_SAMPLE samples[STATUS_HISTORY_LENGTH];
+	gint n = status_history_read(samples, STATUS_HISTORY_LENGTH);
+	gint first = 0;
+	gint64 pan_travel = 0;
+	gdouble dt;
+	gint i;
+
+	if(n < 2)
 		return FALSE;
-	}
-	LOGINFO("ARRIVALCHECK TILT status : %d dest : %d, current tilt speed : %d" , ptz_status->tilt_value , tilt_val , tilt_speed) ;
-	if(tilt_speed > 0)
+	while(first < n - 2 && samples[n - 1].time_us - samples[first].time_us > window_us)
+		first ++;
+	dt = (gdouble)(samples[n - 1].time_us - samples[first].time_us) / G_USEC_PER_SEC;
+	if(dt <= 0)
+		return FALSE;
+	/* sum the steps so that a pan across the seam does not count as a full turn */
+	for(i = first ; i < n - 1 ; i ++)
+		pan_travel += motion_pan_delta(samples[i].pan_val, samples[i + 1].pan_val);
+	*pan_vel = pan_travel / dt;
+	*tilt_vel = (samples[n - 1].tilt_val - samples[first].tilt_val) / dt;
+	*zoom_vel = (samples[n - 1].zoom_val - samples[first].zoom_val) / dt;
+	return TRUE;
+}
+
+/*
+ * Status part of the periodic metrics report, from the sampler history only
+ */
+static void report_status_metrics(void)
+{
+	STATUS_SAMPLE sample;
+	gdouble pan_vel = 0;
+	gdouble tilt_vel = 0;
+	gdouble zoom_vel = 0;
+
+	if(!status_slot_read(&sample))
+		return;
+	status_history_velocity(STATUS_VELOCITY_WINDOW_US, &pan_vel, &tilt_vel, &zoom_vel);
+	LOGINFO("STATUS samples:%d errors:%d age:%" G_GINT64_FORMAT "ms PAN:%d TILT:%d ZOOM:%d velocity PAN:%.0f TILT:%.0f ZOOM:%.0f /s",
+		g_atomic_int_get(&status_count), g_atomic_int_get(&status_errors),
+		(g_get_monotonic_time() - sample.time_us) / 1000,
+		sample.pan_val, sample.tilt_val, sample.zoom_val, pan_vel, tilt_vel, zoom_vel);
+}
+
+static gpointer status_sampler_func(gpointer data)
+{
+	TICK_TIMER timer;
+
+	if(rt_mode)
+		apply_realtime_settings(MAX(rt_priority - 1, RT_MIN_PRIORITY), rt_cpu);
+
+	tick_timer_start(&timer, G_USEC_PER_SEC / status_sample_rate, FALSE);
+	while(g_atomic_int_get(&status_sampler_running))
 	{
+		g_autoptr(AXPTZStatus) ptz_status = NULL;
+		g_autoptr(GError) local_error = NULL;
 
-		if(ptz_status->tilt_value >= fx_subx(tilt_val , 200/*fx_mulx(tilt_speed, fx_ftox(0.072f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/))// 360 / 500 * 0.1
-			return TRUE;
+		if(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &ptz_status, &local_error))
+		{
+			status_slot_publish(ptz_status, g_get_monotonic_time());
+		}
+		else
+		{
+			if(g_atomic_int_add(&status_errors, 1) % 100 == 0)
+				LOGINFO("STATUS SAMPLER ERROR: %s", local_error ? local_error->message : "unknown");
+		}
+		tick_timer_wait(&timer);
 	}
-	else
+	return NULL;
+}
+
+/*
+ * Start the sampler and wait for its first sample
+ */
+static gboolean start_status_sampler(void)
+{
+	STATUS_SAMPLE sample;
+	gint waited = 0;
+
+	g_atomic_int_set(&status_sampler_running, TRUE);
+	status_sampler_thread = g_thread_new("status", status_sampler_func, NULL);
+	while(!status_slot_read(&sample))
 	{
-		if(ptz_status->tilt_value <= fx_addx(tilt_val , 200/*fx_mulx(tilt_speed, fx_ftox(-0.072f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/))
-			return TRUE;
+		if(waited ++ > 100)
+		{
+			LOGINFO("STATUS SAMPLER GOT NO SAMPLE");
+			return FALSE;
+		}
+		usleep(SLEEP_TIME_MILLISECONDS * 1000);
 	}
-	g_free(ptz_status);
-	return FALSE;
+	LOGINFO("Status sampler running at %d Hz", status_sample_rate);
+	return TRUE;
 }
 
-static gboolean is_arrived_at_specific_zoom_pos(fixed_t zoom_val , fixed_t zoom_speed)
+static void stop_status_sampler(void)
+{
+	if(status_sampler_thread == NULL)
+		return;
+	g_atomic_int_set(&status_sampler_running, FALSE);
+	g_thread_join(status_sampler_thread);
+	status_sampler_thread = NULL;
+}
+
+/*
+ * Preset interrupt listener. Requests come in on a local datagram socket
+ * (see preset_interrupt.h). The thread sleeps in poll() and sends the
+ * preset move at full speed itself, at the control thread's priority in
+ * real-time mode, so a trigger costs one axptz call and not a control tick.
+ */
+static gint interrupt_listener_fd = -1;
+static gint interrupt_listener_running = FALSE;
+static GThread *interrupt_listener_thread = NULL;
+
+static void trigger_preset_interrupt(gint preset, gint hold_ms, gint64 trigger_us)
 {
-	AXPTZStatus* ptz_status = NULL;
-	GError* local_error = NULL;
-	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &ptz_status, &local_error))) 
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+	g_autoptr(GError) local_error = NULL;
+	gint64 latency_us;
+
+	if(control_paused)
 	{
-		g_free(ptz_status);
-		LOGINFO(local_error->message);
-		g_error_free(local_error);
-		return FALSE;
+		LOGINFO("PRESET INTERRUPT to preset %d rejected, another client has the PTZ control", preset);
+		return;
 	}
-	LOGINFO("ARRIVALCHECK ZOOM status : %d dest : %d, current zoom speed : %d" , ptz_status->zoom_value , zoom_val , zoom_speed) ;
-	if(zoom_speed > 0)
+	trace_write(TRACE_COMMAND, TRACE_CMD_PRESET, preset, fx_ftox(INTERRUPT_SPEED, FIXMATH_FRAC_BITS), 0, 0, 0, 0);
+	if(!ax_ptz_preset_handler_goto_preset_number(ax_ptz_control_queue_group, VIDEO_CHANNEL, preset, fx_ftox(INTERRUPT_SPEED, FIXMATH_FRAC_BITS), AX_PTZ_PRESET_MOVEMENT_UNITLESS, AX_PTZ_INVOKE_ASYNC, NULL, NULL, &local_error))
 	{
-		if(ptz_status->zoom_value >= fx_subx(zoom_val , fx_mulx(zoom_speed, fx_ftox(0.05f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)))
-			return TRUE;
+		LOGINFO("PRESET INTERRUPT to preset %d failed: %s", preset, local_error->message);
+		return;
 	}
-	else
-	{
+	interrupt_request.preset = preset;
+	interrupt_request.hold_ms = (hold_ms >= 0) ? MIN(hold_ms, INTERRUPT_MAX_HOLD_MS) : interrupt_hold_ms;
+	interrupt_request.trigger_us = trigger_us;
+	interrupt_request.command_us = g_get_monotonic_time();
+	interrupt_request.sequence ++;
+	interrupt_request.release = FALSE;
+	g_atomic_int_set(&interrupt_active, TRUE);
 
-		if(ptz_status->zoom_value <= fx_addx(zoom_val , fx_mulx(zoom_speed, fx_ftox(-0.05f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)))
-			return TRUE;
-	}
-	g_free(ptz_status);
-	return FALSE;
+	latency_us = interrupt_request.command_us - trigger_us;
+	interrupt_count ++;
+	interrupt_command_latency_sum_us += latency_us;
+	interrupt_command_latency_max_us = MAX(interrupt_command_latency_max_us, latency_us);
+	LOGINFO("PRESET INTERRUPT to preset %d, hold %d ms, command sent %" G_GINT64_FORMAT " us after the trigger", preset, interrupt_request.hold_ms, latency_us);
 }
 
-static gboolean is_arrived_at_specific_pos(fixed_t pan_val , fixed_t tilt_val , fixed_t pan_speed , fixed_t tilt_speed)
+static void handle_interrupt_message(gchar *message, gint64 received_us)
 {
-	AXPTZStatus* ptz_status = NULL;
-	GError* local_error = NULL;
-	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &ptz_status, &local_error))) 
+	gint preset = 0;
+	gint hold_ms = -1;
+	gint64 sent_us = 0;
+	gint64 trigger_us = received_us;
+
+	g_strstrip(message);
+	if(g_strcmp0(message, "release") == 0)
 	{
-		g_free(ptz_status);
-		LOGINFO(local_error->message);
-		g_error_free(local_error);
-		return FALSE;
+		g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+		interrupt_request.release = TRUE;
+		LOGINFO("PRESET INTERRUPT released");
+		return;
 	}
-	LOGINFO("ARRIVALCHECK PAN status : %d dest : %d , TITL status : %d dest : %d" , ptz_status->pan_value , pan_val , ptz_status->tilt_value , tilt_val) ;
-	if(pan_speed > 0)
+	if(sscanf(message, "preset %d %d %" G_GINT64_FORMAT, &preset, &hold_ms, &sent_us) < 1)
 	{
-		if(ptz_status->pan_value >= fx_subx(pan_val , fx_mulx(pan_speed, fx_ftox(0.0514f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)))
-			return TRUE;
+		LOGINFO("Unknown interrupt request \"%s\"", message);
+		return;
 	}
-	else
+	/* a send time only counts when it is plausibly from the same clock */
+	if(sent_us > 0 && sent_us <= received_us && received_us - sent_us < INTERRUPT_TRIGGER_MAX_AGE_US)
+		trigger_us = sent_us;
+	trigger_preset_interrupt(preset, hold_ms, trigger_us);
+}
+
+static gpointer interrupt_listener_func(gpointer data)
+{
+	struct pollfd pfd = { interrupt_listener_fd, POLLIN, 0 };
+	gchar message[PRESET_INTERRUPT_MESSAGE_LENGTH];
+
+	if(rt_mode)
+		apply_realtime_settings(rt_priority, rt_cpu);
+
+	while(g_atomic_int_get(&interrupt_listener_running))
 	{
-		if(ptz_status->pan_value <= fx_addx(pan_val , fx_mulx(pan_speed, fx_ftox(-0.0514f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)))
-			return TRUE;
+		ssize_t length;
+
+		if(poll(&pfd, 1, INTERRUPT_POLL_MS) <= 0)
+			continue;
+		length = recv(interrupt_listener_fd, message, sizeof(message) - 1, 0);
+		if(length <= 0)
+			continue;
+		message[length] = '\0';
+		handle_interrupt_message(message, g_get_monotonic_time());
 	}
-	if(tilt_speed > 0)
+	return NULL;
+}
+
+static gboolean start_interrupt_listener(GError **error)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(interrupt_socket) >= sizeof(addr.sun_path))
 	{
-		if(ptz_status->tilt_value >= fx_subx(tilt_val , fx_mulx(tilt_speed, fx_ftox(0.072f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)))
-			return TRUE;
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NAMETOOLONG, "interrupt socket path %s is too long", interrupt_socket);
+		return FALSE;
 	}
-	else
+	g_strlcpy(addr.sun_path, interrupt_socket, sizeof(addr.sun_path));
+
+	/* a socket left behind by a crashed run would fail the bind */
+	unlink(interrupt_socket);
+	if((interrupt_listener_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0
+		|| bind(interrupt_listener_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
 	{
-		if(ptz_status->tilt_value <= fx_addx(tilt_val , fx_mulx(tilt_speed, fx_ftox(-0.072f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)))
-			return TRUE;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "can not listen on %s: %s", interrupt_socket, strerror(errno));
+		if(interrupt_listener_fd >= 0)
+			close(interrupt_listener_fd);
+		interrupt_listener_fd = -1;
+		return FALSE;
 	}
-	g_free(ptz_status);
-	return FALSE;
+
+	g_atomic_int_set(&interrupt_listener_running, TRUE);
+	interrupt_listener_thread = g_thread_new("interrupt", interrupt_listener_func, NULL);
+	LOGINFO("Preset interrupts on %s, hold %d ms", interrupt_socket, interrupt_hold_ms);
+	return TRUE;
 }
 
-static gboolean wait_for_camera_arrive_to_specific_pos(fixed_t pan_val , fixed_t tilt_val , fixed_t zoom_val , fixed_t pan_speed , fixed_t tilt_speed , fixed_t zoom_speed)
+static void stop_interrupt_listener(void)
 {
-	gint timer = 0;
-	gboolean pan_tilt_arrived = FALSE;
-	gboolean pan_arrived = FALSE;
-	gboolean tilt_arrived = FALSE;
-	gboolean zoom_arrived = FALSE;
-	gboolean panStopped = FALSE;
-	gboolean tiltStopped = FALSE;
-	gboolean zoomStopped = FALSE;
-	if(zoom_speed == 0)
-		zoom_arrived = TRUE;
-	if(pan_speed == 0)
-		pan_arrived = TRUE;
-	if(tilt_speed == 0)
-		tilt_arrived = TRUE;
-	while(!pan_arrived || !tilt_arrived || !zoom_arrived)
-	{    
-		timer ++;
-		if(pan_speed != 0 && !pan_arrived)
-			pan_arrived = is_arrived_at_specific_pan_pos(pan_val , pan_speed);
-		
-		if(tilt_speed != 0 && !tilt_arrived)
-			tilt_arrived = is_arrived_at_specific_tilt_pos(tilt_val , tilt_speed);
-		
-		if(zoom_speed != 0 && !zoom_arrived)
-			zoom_arrived = is_arrived_at_specific_zoom_pos(zoom_val , zoom_speed); 
-		
-		if(pan_arrived && !panStopped)
-		{
-			//if(!stop_continous_movement(TRUE , FALSE))
-			//LOGINFO("CAN NOT STOP PAN_TILT_MOVEMENT");
-			stop_continous_movement(TRUE , TRUE);
-			pan_speed = 0;
-			tilt_speed = ((tiltStopped)?0:fx_ftox((tilt_speed>0)?cont_max_speed*1.4:-cont_max_speed*1.4, FIXMATH_FRAC_BITS));
-			if(tilt_speed == 0)
-				zoom_speed = ((zoomStopped)?0:fx_ftox((zoom_speed>0)?cont_max_speed*1.4:-cont_max_speed*1.4, FIXMATH_FRAC_BITS));
-			else
-				zoom_speed = ((zoomStopped)?0:zoom_speed);
-			start_continous_movement(pan_speed , tilt_speed , AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS , zoom_speed , 600.0f);
-			
-			panStopped = TRUE;
+	if(interrupt_listener_thread == NULL)
+		return;
+	g_atomic_int_set(&interrupt_listener_running, FALSE);
+	g_thread_join(interrupt_listener_thread);
+	interrupt_listener_thread = NULL;
+	close(interrupt_listener_fd);
+	interrupt_listener_fd = -1;
+	unlink(interrupt_socket);
+}
+
+//static gfloat arrival_accuracy = 0.001f;
+
+static gboolean is_arrived_at_specific_pan_pos(const STATUS_SAMPLE *sample , fixed_t pan_val , fixed_t pan_speed)
+{
+	gboolean arrived = motion_pan_arrived(sample->pan_val , pan_val , pan_speed);
+
+	LOGINFO("ARRIVALCHECK PAN status : %d dest : %d , current pan speed : %d" , sample->pan_val , pan_val , pan_speed) ;
+	trace_write(TRACE_ARRIVAL, TRACE_AXIS_PAN, sample->pan_val, pan_val, pan_speed, arrived, 0, 0);
+	return arrived;
+}
+
+static gboolean is_arrived_at_specific_tilt_pos(const STATUS_SAMPLE *sample , fixed_t tilt_val , fixed_t tilt_speed)
+{
+	gboolean arrived = motion_tilt_arrived(sample->tilt_val , tilt_val , tilt_speed);
+
+	LOGINFO("ARRIVALCHECK TILT status : %d dest : %d, current tilt speed : %d" , sample->tilt_val , tilt_val , tilt_speed) ;
+	trace_write(TRACE_ARRIVAL, TRACE_AXIS_TILT, sample->tilt_val, tilt_val, tilt_speed, arrived, 0, 0);
+	return arrived;
+}
+
+static gboolean is_arrived_at_specific_zoom_pos(const STATUS_SAMPLE *sample , fixed_t zoom_val , fixed_t zoom_speed)
+{
+	gboolean arrived = motion_zoom_arrived(sample->zoom_val , zoom_val , zoom_speed);
+
+	LOGINFO("ARRIVALCHECK ZOOM status : %d dest : %d, current zoom speed : %d" , sample->zoom_val , zoom_val , zoom_speed) ;
+	trace_write(TRACE_ARRIVAL, TRACE_AXIS_ZOOM, sample->zoom_val, zoom_val, zoom_speed, arrived, 0, 0);
+	return arrived;
+}
+
+/*
+ * Preemption. A higher priority client (an operator joystick) moves this
+ * application down the control queue. The tour then pauses: it sends no
+ * commands and only asks for the queue status every poll_time, keeping a
+ * plan for the nearest upcoming waypoint up to date meanwhile, so that the
+ * first command goes out as soon as control is back.
+ */
+typedef struct RESUME_PLAN{
+
+	gboolean ready;
+	GList *waypoint;
+	STATUS_SAMPLE sample;	/* the plan starts from this one */
+	PTZ_POS from;
+	fixed_t pan_speed;
+	fixed_t tilt_speed;
+	fixed_t zoom_speed;
+
+}RESUME_PLAN;
+
+/* pause statistics, written by the tour thread */
+static gint pause_count = 0;
+static gint pause_polls = 0;
+static gint64 pause_total_us = 0;
+static gint resume_count = 0;
+static gint64 resume_latency_sum_us = 0;
+static gint64 resume_latency_max_us = 0;
+
+/*
+ * Ask the control queue whether this application still has the PTZ, in
+ * <held>. Returns FALSE with <error> set when the query fails.
+ */
+static gboolean control_still_held(gboolean *held, GError **error)
+{
+	g_autoptr(GError) local_error = NULL;
+
+	if(!ax_ptz_control_queue_request(ax_ptz_control_queue_group, VIDEO_CHANNEL, AX_PTZ_CONTROL_QUEUE_QUERY_STATUS, &queue_pos, &time_to_pos_one, &poll_time, &local_error))
+	{
+		LOGINFO(local_error->message);
+		g_propagate_error(error, g_steal_pointer(&local_error));
+		return FALSE;
+	}
+	trace_write(TRACE_QUEUE, AX_PTZ_CONTROL_QUEUE_QUERY_STATUS, queue_pos, time_to_pos_one, poll_time, 0, 0, 0);
+	*held = (queue_pos == 1);
+	return TRUE;
+}
+
+/*
+ * Where to resume: of the waypoints from <next> up to and including the
+ * next preset, the one closest to the camera, and the speeds to get there
+ */
+static gboolean plan_resume(GList *next, RESUME_PLAN *plan)
+{
+	STATUS_SAMPLE sample;
+	fixed_t best = G_MAXINT32;
+	GList *it;
+
+	plan->waypoint = next;
+	plan->ready = status_slot_read(&sample);
+	if(!plan->ready)
+		return FALSE;
+	plan->sample = sample;
+	plan->from.pan_val = sample.pan_val;
+	plan->from.tilt_val = sample.tilt_val;
+	plan->from.zoom_val = sample.zoom_val;
+	plan->from.pass_through = FALSE;
+	for(it = next ; it != NULL ; it = g_list_next(it))
+	{
+		fixed_t distance = motion_travel(&plan->from, (PTZ_POS*)(it->data));
+
+		if(distance < best)
+		{
+			best = distance;
+			plan->waypoint = it;
+		}
+		/* never skip a preset and its dwell */
+		if(!((PTZ_POS*)(it->data))->pass_through)
+			break;
+	}
+	motion_segment_speeds(&plan->from, (PTZ_POS*)(plan->waypoint->data), profile_max_speed(&tour_profiles[active_profile], g_list_position(realPath, plan->waypoint) + 1),
+		&plan->pan_speed, &plan->tilt_speed, &plan->zoom_speed);
+	return TRUE;
+}
+
+static void set_control_paused(gboolean paused)
+{
+	g_autoptr(GMutexLocker) command_locker = g_mutex_locker_new(&ptz_command_lock);
+
+	control_paused = paused;
+}
+
+/*
+ * Pause until the control queue puts this application first again.
+ * Returns with <plan> filled in for resuming from <next>, ready unless no
+ * status sample came in while paused. Preset interrupts are rejected
+ * meanwhile.
+ */
+static gboolean pause_until_control(GList *next, RESUME_PLAN *plan, GError **error)
+{
+	gint64 start_us = g_get_monotonic_time();
+
+	set_control_paused(TRUE);
+	pause_count ++;
+	LOGINFO("PTZ CONTROL LOST, queue position %d, pausing the tour", queue_pos);
+	plan_resume(next, plan);
+	publish_status(STATUS_STATE_PAUSED, g_list_position(realPath, next) + 1, NULL, NULL);
+	while(queue_pos != 1 && g_atomic_int_get(&tour_running))
+	{
+		dwell(CLAMP(poll_time, PAUSE_MIN_POLL_MS, PAUSE_MAX_POLL_MS));
+		pause_polls ++;
+		if(!ax_ptz_control_queue_request(ax_ptz_control_queue_group, VIDEO_CHANNEL, AX_PTZ_CONTROL_QUEUE_QUERY_STATUS, &queue_pos, &time_to_pos_one, &poll_time, error))
+		{
+			set_control_paused(FALSE);
+			return FALSE;
+		}
+		trace_write(TRACE_QUEUE, AX_PTZ_CONTROL_QUEUE_QUERY_STATUS, queue_pos, time_to_pos_one, poll_time, 0, 0, 0);
+		plan_resume(next, plan);
+		publish_status(STATUS_STATE_PAUSED, g_list_position(realPath, next) + 1, NULL, NULL);
+	}
+	set_control_paused(FALSE);
+	pause_total_us += g_get_monotonic_time() - start_us;
+	LOGINFO("PTZ CONTROL BACK after %.1f s", (g_get_monotonic_time() - start_us) / (gdouble)G_USEC_PER_SEC);
+	return TRUE;
+}
+
+/*
+ * Stall detection. A segment that makes less than stall_min_progress
+ * units of progress towards its target over stall_window_ticks ticks is
+ * stalled: a limit, a lost command or another client holding the control.
+ * The continuous command is re-sent once; if the segment stalls again the
+ * executor falls back to an absolute move and finally skips the waypoint,
+ * all within a bounded number of ticks.
+ */
+typedef enum
+{
+	WAIT_ARRIVED,
+	WAIT_STALLED,
+	WAIT_PREEMPTED,
+	WAIT_INTERRUPTED,
+	WAIT_ERROR
+} WAIT_RESULT;
+
+static gint stall_window_ticks = STALL_DEFAULT_WINDOW_MS / SLEEP_TIME_MILLISECONDS;
+static fixed_t stall_min_progress = STALL_DEFAULT_MIN_PROGRESS_UNITS;
+
+/* stall and recovery counters, written by the tour thread */
+static gint stall_count = 0;
+static gint stall_resends = 0;
+static gint stall_absolute_recoveries = 0;
+static gint stall_skips = 0;
+static gint64 stall_recovery_max_us = 0;
+
+/*
+ * Distance still to go on the axes that have not arrived yet
+ */
+static fixed_t remaining_distance(const PTZ_POS *target, const STATUS_SAMPLE *sample, gboolean pan_arrived, gboolean tilt_arrived, gboolean zoom_arrived)
+{
+	fixed_t remaining = 0;
+
+	if(!pan_arrived)
+		remaining += ABS(motion_pan_delta(sample->pan_val , target->pan_val));
+	if(!tilt_arrived)
+		remaining += ABS(fx_subx(target->tilt_val , sample->tilt_val));
+	if(!zoom_arrived)
+		remaining += ABS(fx_subx(target->zoom_val , sample->zoom_val));
+	return remaining;
+}
+
+/*
+ * Wait until the camera reaches the target, stopping each axis as it
+ * arrives. With <blend_from> set the target is a pass-through waypoint:
+ * return without stopping as soon as the blend zone around it is reached,
+ * the caller then applies the next segment's speeds. With <approach_units>
+ * set, stop everything once pan and tilt are that close to the target and
+ * leave the rest to an absolute move. With <scurve_step> not negative the
+ * speeds follow the S-curve on from that step, braking for the target
+ * unless it is blended through; <speed_factor> is the share already sent.
+ * Once an axis arrives the others go on at the segment's <max_speed>.
+ * Returns WAIT_STALLED when the segment stalls again after one re-send, and
+ * WAIT_ERROR with <error> set when a command or control query fails.
+ */
+static WAIT_RESULT wait_for_camera_arrive_to_specific_pos(fixed_t pan_val , fixed_t tilt_val , fixed_t zoom_val , fixed_t pan_speed , fixed_t tilt_speed , fixed_t zoom_speed , const PTZ_POS *blend_from , fixed_t approach_units , gint scurve_step , gfloat speed_factor , gfloat max_speed , GError **error)
+{
+	PTZ_POS target = { pan_val , tilt_val , zoom_val , TRUE };
+	gint timer = 0;
+	gboolean pan_tilt_arrived = FALSE;
+	gboolean pan_arrived = FALSE;
+	gboolean tilt_arrived = FALSE;
+	gboolean zoom_arrived = FALSE;
+	gboolean panStopped = FALSE;
+	gboolean tiltStopped = FALSE;
+	gboolean zoomStopped = FALSE;
+	STATUS_SAMPLE sample;
+	TICK_TIMER tick_timer;
+	gdouble applied_scale = 1.0;
+	fixed_t progress_ring[STALL_RING_LENGTH];
+	gint progress_ticks = 0;
+	gboolean resent = FALSE;
+	gboolean held = TRUE;
+	if(status_slot_read(&sample))
+		applied_scale = screen_speed_scale(scale_speed(pan_speed, speed_factor), scale_speed(tilt_speed, speed_factor), sample.zoom_val);
+	tick_timer_start(&tick_timer, tick_period_us, TRUE);
+	if(zoom_speed == 0)
+		zoom_arrived = TRUE;
+	if(pan_speed == 0)
+		pan_arrived = TRUE;
+	if(tilt_speed == 0)
+		tilt_arrived = TRUE;
+	while(!pan_arrived || !tilt_arrived || !zoom_arrived)
+	{    
+		timer ++;
+		if(g_atomic_int_get(&interrupt_active))
+			return WAIT_INTERRUPTED;
+		if(!status_slot_read(&sample))
+		{
+			tick_timer_wait(&tick_timer);
+			continue;
+		}
+		trace_status(&sample);
+		if(blend_from != NULL)
+		{
+			gboolean blended = motion_blend_reached(blend_from , &target , &sample , blend_tolerance);
+			trace_write(TRACE_ARRIVAL, TRACE_AXIS_BLEND, sample.pan_val, sample.tilt_val, sample.zoom_val, blended, 0, 0);
+			if(blended)
+			{
+				LOGINFO("BLENDING THROUGH pan:%d tilt:%d zoom:%d" , pan_val , tilt_val , zoom_val);
+				return WAIT_ARRIVED;
+			}
+		}
+		if(approach_units > 0 && motion_residual(&target , &sample) <= approach_units)
+		{
+			if(!stop_continous_movement(TRUE , TRUE , error))
+				return WAIT_ERROR;
+			LOGINFO("FINAL APPROACH FROM pan:%d tilt:%d zoom:%d" , sample.pan_val , sample.tilt_val , sample.zoom_val);
+			return WAIT_ARRIVED;
+		}
+		if(scurve_step >= 0)
+		{
+			gfloat factor = motion_scurve_factor(&scurve , ++ scurve_step , (blend_from != NULL) ? G_MAXFLOAT : scurve_remaining_ticks(&target , sample.pan_val , sample.tilt_val , pan_speed , tilt_speed));
+
+			/* small steps are not worth a command, the ends of the ramp are */
+			if(factor != speed_factor && (fabsf(factor - speed_factor) >= SCURVE_UPDATE_STEP || factor == 1.0f || factor == scurve.factor[0]))
+			{
+				speed_factor = factor;
+				if(!start_segment_movement(pan_speed , tilt_speed , zoom_speed , speed_factor , sample.zoom_val , &applied_scale , error))
+					return WAIT_ERROR;
+			}
+		}
+
+		/* progress over the last stall_window_ticks ticks */
+		progress_ring[progress_ticks % STALL_RING_LENGTH] = remaining_distance(&target , &sample , pan_arrived , tilt_arrived , zoom_arrived);
+		if(progress_ticks >= stall_window_ticks
+			&& progress_ring[(progress_ticks - stall_window_ticks) % STALL_RING_LENGTH] - progress_ring[progress_ticks % STALL_RING_LENGTH] < stall_min_progress)
+		{
+			stall_count ++;
+			LOGINFO("STALL at pan:%d tilt:%d zoom:%d, %d units to go" , sample.pan_val , sample.tilt_val , sample.zoom_val , progress_ring[progress_ticks % STALL_RING_LENGTH]);
+			if(!control_still_held(&held , error))
+				return WAIT_ERROR;
+			if(!held)
+				return WAIT_PREEMPTED;
+			if(resent)
+				return WAIT_STALLED;
+			stall_resends ++;
+			resent = TRUE;
+			if(!start_segment_movement(pan_speed , tilt_speed , zoom_speed , speed_factor , sample.zoom_val , &applied_scale , error))
+				return WAIT_ERROR;
+			progress_ticks = 0;
+			tick_timer_wait(&tick_timer);
+			continue;
+		}
+		progress_ticks ++;
+		if(pan_speed != 0 && !pan_arrived)
+			pan_arrived = is_arrived_at_specific_pan_pos(&sample , pan_val , pan_speed);
+		
+		if(tilt_speed != 0 && !tilt_arrived)
+			tilt_arrived = is_arrived_at_specific_tilt_pos(&sample , tilt_val , tilt_speed);
+		
+		if(zoom_speed != 0 && !zoom_arrived)
+			zoom_arrived = is_arrived_at_specific_zoom_pos(&sample , zoom_val , zoom_speed); 
+		
+		if(pan_arrived && !panStopped)
+		{
+			//if(!stop_continous_movement(TRUE , FALSE))
+			//LOGINFO("CAN NOT STOP PAN_TILT_MOVEMENT");
+			if(!stop_continous_movement(TRUE , TRUE , error))
+				return WAIT_ERROR;
+			pan_speed = 0;
+			tilt_speed = ((tiltStopped)?0:fx_ftox((tilt_speed>0)?max_speed*1.4:-max_speed*1.4, FIXMATH_FRAC_BITS));
+			if(tilt_speed == 0)
+				zoom_speed = ((zoomStopped)?0:fx_ftox((zoom_speed>0)?max_speed*1.4:-max_speed*1.4, FIXMATH_FRAC_BITS));
+			else
+				zoom_speed = ((zoomStopped)?0:zoom_speed);
+			if(!start_segment_movement(pan_speed , tilt_speed , zoom_speed , speed_factor , sample.zoom_val , &applied_scale , error))
+				return WAIT_ERROR;
+			
+			panStopped = TRUE;
 		}
 		
 		if(tilt_arrived && !tiltStopped)
 		{
 			//if(!stop_continous_movement(TRUE , FALSE))
 			//LOGINFO("CAN NOT STOP PAN_TILT_MOVEMENT");
-			stop_continous_movement(TRUE , TRUE);
-			pan_speed = ((panStopped)?0:fx_ftox((pan_speed>0)?cont_max_speed:-1 * cont_max_speed , FIXMATH_FRAC_BITS));
+			if(!stop_continous_movement(TRUE , TRUE , error))
+				return WAIT_ERROR;
+			pan_speed = ((panStopped)?0:fx_ftox((pan_speed>0)?max_speed:-1 * max_speed , FIXMATH_FRAC_BITS));
 			tilt_speed = 0;
 			if(pan_speed == 0)
-				zoom_speed = ((zoomStopped)?0:fx_ftox((zoom_speed>0)?cont_max_speed*1.4:-cont_max_speed*1.4, FIXMATH_FRAC_BITS));
+				zoom_speed = ((zoomStopped)?0:fx_ftox((zoom_speed>0)?max_speed*1.4:-max_speed*1.4, FIXMATH_FRAC_BITS));
 			else
 				zoom_speed = ((zoomStopped)?0:zoom_speed);
-			start_continous_movement(pan_speed , tilt_speed , AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS , zoom_speed , 600.0f);
+			if(!start_segment_movement(pan_speed , tilt_speed , zoom_speed , speed_factor , sample.zoom_val , &applied_scale , error))
+				return WAIT_ERROR;
 			tiltStopped = TRUE;
 		}
 		
@@ -574,14 +2026,25 @@ static gboolean wait_for_camera_arrive_to_specific_pos(fixed_t pan_val , fixed_t
 		{
 			//if(!stop_continous_movement(FALSE , TRUE))
 			//LOGINFO("CAN NOT STOP ZOOM_MOVEMENT");
-			stop_continous_movement(TRUE , TRUE);
+			if(!stop_continous_movement(TRUE , TRUE , error))
+				return WAIT_ERROR;
 			pan_speed = ((panStopped)?0:pan_speed);
 			tilt_speed = ((tiltStopped)?0:tilt_speed);
 			zoom_speed = 0;
-			start_continous_movement(pan_speed , tilt_speed , AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS , zoom_speed , 600.0f);
+			if(!start_segment_movement(pan_speed , tilt_speed , zoom_speed , speed_factor , sample.zoom_val , &applied_scale , error))
+				return WAIT_ERROR;
 			zoomStopped = TRUE;
 		}
-		usleep(SLEEP_TIME_MILLISECONDS * 1000);
+
+		/* follow the zoom with the pan/tilt speeds */
+		if(screen_speed_mode && (pan_speed != 0 || tilt_speed != 0))
+		{
+			gdouble scale = screen_speed_scale(scale_speed(pan_speed, speed_factor), scale_speed(tilt_speed, speed_factor), sample.zoom_val);
+			if(fabs(scale - applied_scale) > applied_scale * SCREEN_SPEED_RESCALE
+				&& !start_segment_movement(pan_speed , tilt_speed , zoom_speed , speed_factor , sample.zoom_val , &applied_scale , error))
+				return WAIT_ERROR;
+		}
+		tick_timer_wait(&tick_timer);
 	}
 	LOGINFO("GETTING CLOSER IS STOPPED");
 
@@ -595,184 +2058,2878 @@ static gboolean wait_for_camera_arrive_to_specific_pos(fixed_t pan_val , fixed_t
 	//else
 	//{
 	LOGINFO("ARRVIED AT pan:%d tilt:%d zoom:%d" , pan_val , tilt_val , zoom_val);
-	return TRUE;
+	return WAIT_ARRIVED;
 	//}
 
 }
 
-static GList* tempPath = NULL;
-static GList* realPath = NULL;
+/*
+ * Segment executor. Continuous moves pass through waypoints and blend, but
+ * stop wherever the last status sample caught the camera. Absolute moves
+ * leave the deceleration to the camera's own servo and land on the target,
+ * at the cost of a full stop. In hybrid mode short hops are absolute,
+ * pass-through segments are continuous, and a preset is approached
+ * continuously and finished with an absolute move while the measured
+ * continuous arrival error is above the tolerance.
+ */
+typedef enum
+{
+	SEGMENT_CONTINUOUS,
+	SEGMENT_ABSOLUTE,
+	SEGMENT_HYBRID
+} SEGMENT_MODE;
+
+typedef enum
+{
+	EXEC_CONTINUOUS,
+	EXEC_ABSOLUTE,
+	EXEC_APPROACH,
+	EXEC_KINDS
+} EXEC_KIND;
+
+typedef struct ACCURACY_STAT{
+
+	gint count;
+	gint64 sum;
+	fixed_t max;
+
+}ACCURACY_STAT;
+
+static const gchar *segment_mode_names[] = { "continuous", "absolute", "hybrid" };
+static const gchar *exec_kind_names[] = { "continuous", "absolute", "approach" };
+
+static gint segment_mode = SEGMENT_CONTINUOUS;
+static fixed_t absolute_hop_units = ABSOLUTE_HOP_DEFAULT_UNITS;
+static fixed_t final_approach_units = FINAL_APPROACH_DEFAULT_UNITS;
+static fixed_t arrival_tolerance_units = ARRIVAL_TOLERANCE_DEFAULT_UNITS;
+
+/* preset arrival error per way of executing, written by the tour thread */
+static ACCURACY_STAT arrival_error[EXEC_KINDS];
+static gint preset_arrivals = 0;
+
+/* completed laps, written by the tour thread */
+static gint lap_count = 0;
+static gint64 lap_time_sum_us = 0;
+static gint64 lap_time_max_us = 0;
+static gint64 lap_time_last_us = 0;
+
+/* preset residual correction results, written by the tour thread */
+static ACCURACY_STAT corrected_error;
+static gint correction_moves = 0;
+static gint correction_budget_hits = 0;
+
+/* drift checks, written by the tour thread */
+static gint drift_checks = 0;
+static gint drift_corrections = 0;
+static gint drift_timeouts = 0;
+static fixed_t drift_error_max = 0;
+
+/* lap starts against the shared schedule, in camera ms, written by the tour thread */
+static gint sync_laps = 0;
+static gint64 sync_error_sum_ms = 0;
+static gint64 sync_error_max_ms = 0;
+static gint sync_speedups = 0;
+static gint sync_short_dwells = 0;
+
+/* lap-time budget stats, in camera time */
+static gint budget_laps = 0;
+static gint budget_misses = 0;
+static gint budget_replans = 0;
+static gint64 budget_error_sum_ms = 0;
+static gint64 budget_error_max_ms = 0;
+
+/* axptz error recovery stats, written by the tour thread */
+static gint ptz_error_count = 0;
+static gint ptz_error_streak = 0;
+static gint ptz_reinit_count = 0;
+static gint64 ptz_outage_start_us = 0;
+static gint64 ptz_outage_max_us = 0;
+
+static void accuracy_stat_add(ACCURACY_STAT *stat, fixed_t error)
+{
+	stat->count ++;
+	stat->sum += error;
+	stat->max = MAX(stat->max, error);
+}
+
+static gdouble accuracy_stat_mean(const ACCURACY_STAT *stat)
+{
+	return stat->count ? (gdouble)stat->sum / stat->count : 0.0;
+}
+
+static void report_arrival_metrics(void)
+{
+	gint i;
+
+	if(lap_count > 0)
+		LOGINFO("Lap time: %d laps, mean %.1f s, max %.1f s", lap_count, lap_time_sum_us / (gdouble)lap_count / G_USEC_PER_SEC, lap_time_max_us / (gdouble)G_USEC_PER_SEC);
+	for(i = 0 ; i < EXEC_KINDS ; i ++)
+	{
+		if(arrival_error[i].count > 0)
+			LOGINFO("Arrival error %s: %d presets, mean %.0f, max %d units", exec_kind_names[i], arrival_error[i].count, accuracy_stat_mean(&arrival_error[i]), arrival_error[i].max);
+	}
+	if(stall_count > 0)
+		LOGINFO("Stalls: %d, re-sent %d, absolute recoveries %d, skipped waypoints %d, longest recovery %" G_GINT64_FORMAT " ms", stall_count, stall_resends, stall_absolute_recoveries, stall_skips, stall_recovery_max_us / 1000);
+	if(corrected_error.count > 0)
+		LOGINFO("Corrected error: %d presets, %d moves, mean %.0f, max %d units, budget used up %d times", corrected_error.count, correction_moves, accuracy_stat_mean(&corrected_error), corrected_error.max, correction_budget_hits);
+	if(pause_count > 0)
+		LOGINFO("Preempted: %d pauses, %.1f s paused, %d status polls, resume latency mean %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us", pause_count, pause_total_us / (gdouble)G_USEC_PER_SEC, pause_polls, resume_latency_sum_us / MAX(resume_count, 1), resume_latency_max_us);
+	if(scan_cycle_count > 0)
+		LOGINFO("Scan: %d cycles, mean %.1f s, last %.1f s, %.1f square degrees/s", scan_cycle_count, scan_cycle_sum_us / (gdouble)scan_cycle_count / G_USEC_PER_SEC,
+			scan_cycle_last_us / (gdouble)G_USEC_PER_SEC, scan_area_sum * G_USEC_PER_SEC / scan_cycle_sum_us);
+	if(drift_checks > 0 || drift_timeouts > 0)
+		LOGINFO("Drift checks: %d, %d corrections, %d not settled in the dwell, largest drift %d units", drift_checks, drift_corrections, drift_timeouts, drift_error_max);
+	if(sync_laps > 0)
+		LOGINFO("Synchronized laps: %d, phase error mean %" G_GINT64_FORMAT " ms, max %" G_GINT64_FORMAT " ms, %d segments sped up, %d dwells cut short", sync_laps,
+			sync_error_sum_ms / sync_laps, sync_error_max_ms, sync_speedups, sync_short_dwells);
+	if(ptz_error_count > 0)
+		LOGINFO("AXPTZ errors: %d, %d library restarts, longest outage %.1f s", ptz_error_count, ptz_reinit_count, ptz_outage_max_us / (gdouble)G_USEC_PER_SEC);
+	if(budget_laps > 0)
+		LOGINFO("Lap budget: %d laps, %d off target, error mean %" G_GINT64_FORMAT " ms, max %" G_GINT64_FORMAT " ms, %d plans", budget_laps, budget_misses,
+			budget_error_sum_ms / budget_laps, budget_error_max_ms, budget_replans);
+	if(interrupt_count > 0)
+		LOGINFO("Preset interrupts: %d, %.1f s held, trigger to command mean %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us, trigger to motion mean %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us (%d measured)", interrupt_count, interrupt_hold_total_us / (gdouble)G_USEC_PER_SEC,
+			interrupt_command_latency_sum_us / interrupt_count, interrupt_command_latency_max_us, interrupt_motion_latency_sum_us / MAX(interrupt_motion_count, 1), interrupt_motion_latency_max_us, interrupt_motion_count);
+}
+
+/*
+ * Publish the tour state and counters for status.cgi. Called by the tour
+ * thread at segment, lap and pause boundaries (by main before the tour), so
+ * there is one writer at a time. <from> and <target> keep their last value
+ * when NULL.
+ */
+static STATUS_SNAPSHOT status_snapshot;
+
+static void publish_status(gint state, gint segment, const PTZ_POS *from, const PTZ_POS *target)
+{
+	STATUS_SNAPSHOT *s = &status_snapshot;
+	gint i;
+
+	if(!status_snapshot_mode)
+		return;
+
+	s->updated_us = g_get_monotonic_time();
+	s->state = state;
+	s->segment_mode = segment_mode;
+	if(tour_profile_count > 0)
+		g_strlcpy(s->profile, tour_profiles[active_profile].name, sizeof(s->profile));
+	s->lap = lap_count + 1;
+	s->segment = segment;
+	s->waypoints = g_list_length(realPath);
+	if(from != NULL)
+	{
+		s->position[0] = from->pan_val;
+		s->position[1] = from->tilt_val;
+		s->position[2] = from->zoom_val;
+	}
+	if(target != NULL)
+	{
+		s->target[0] = target->pan_val;
+		s->target[1] = target->tilt_val;
+		s->target[2] = target->zoom_val;
+	}
+	s->queue_pos = queue_pos;
+	s->time_to_pos_one = time_to_pos_one;
+	s->poll_time = poll_time;
+
+	s->laps = lap_count;
+	s->lap_mean_ms = lap_count ? lap_time_sum_us / lap_count / 1000 : 0;
+	s->lap_max_ms = lap_time_max_us / 1000;
+	s->lap_last_ms = lap_time_last_us / 1000;
+	s->presets = preset_arrivals;
+	for(i = 0 ; i < EXEC_KINDS ; i ++)
+	{
+		s->arrival_mean[i] = (gint32)accuracy_stat_mean(&arrival_error[i]);
+		s->arrival_max[i] = arrival_error[i].max;
+	}
+	s->stalls = stall_count;
+	s->skipped = stall_skips;
+	s->pauses = pause_count;
+	s->paused_ms = pause_total_us / 1000;
+	s->resume_latency_max_us = resume_latency_max_us;
+	s->interrupts = interrupt_count;
+	s->interrupt_command_max_us = interrupt_command_latency_max_us;
+	s->interrupt_motion_max_us = interrupt_motion_latency_max_us;
+	s->tick_overruns = g_atomic_int_get(&tick_overruns);
+	s->tick_max_latency_us = g_atomic_int_get(&tick_max_latency_us);
+	s->ptz_errors = ptz_error_count;
+	s->ptz_restarts = ptz_reinit_count;
+	s->ptz_outage_max_ms = ptz_outage_max_us / 1000;
+	status_snapshot_publish(s);
+}
+
+/*
+ * Pick how a segment is executed
+ */
+static EXEC_KIND choose_execution(const PTZ_POS *from, const PTZ_POS *target)
+{
+	const ACCURACY_STAT *continuous = &arrival_error[EXEC_CONTINUOUS];
+
+	if(segment_mode == SEGMENT_CONTINUOUS)
+		return EXEC_CONTINUOUS;
+	if(segment_mode == SEGMENT_ABSOLUTE)
+		return EXEC_ABSOLUTE;
+	if(target->pass_through)
+		return EXEC_CONTINUOUS;
+	if(motion_travel(from, target) <= absolute_hop_units)
+		return EXEC_ABSOLUTE;
+	/* keep measuring plain continuous arrivals now and then */
+	if(continuous->count < ACCURACY_MIN_SAMPLES || preset_arrivals % ACCURACY_RESAMPLE_INTERVAL == 0)
+		return EXEC_CONTINUOUS;
+	if(accuracy_stat_mean(continuous) > arrival_tolerance_units)
+		return EXEC_APPROACH;
+	return EXEC_CONTINUOUS;
+}
+
+/*
+ * Wait for an absolute or relative move to end, polling once per tick.
+ * A move still running after max_ticks counts as stalled.
+ */
+static WAIT_RESULT wait_for_move_to_end(gint max_ticks, GError **error)
+{
+	g_autoptr(GError) local_error = NULL;
+	gboolean is_moving = TRUE;
+	TICK_TIMER tick_timer;
+	gint ticks = 0;
+
+	tick_timer_start(&tick_timer, tick_period_us, TRUE);
+	while(ticks < max_ticks)
+	{
+		tick_timer_wait(&tick_timer);
+		ticks ++;
+		if(g_atomic_int_get(&interrupt_active))
+			return WAIT_INTERRUPTED;
+		if(!ax_ptz_movement_handler_is_ptz_moving(VIDEO_CHANNEL, &is_moving, &local_error))
+		{
+			LOGINFO(local_error->message);
+			g_propagate_error(error, g_steal_pointer(&local_error));
+			return WAIT_ERROR;
+		}
+		/* the move is asynchronous, it may not have started on the first poll */
+		if(!is_moving && ticks >= ABSOLUTE_MOVE_START_TICKS)
+			return WAIT_ARRIVED;
+	}
+	LOGINFO("WAITING FOR MOVE TO END TIME OUT");
+	return WAIT_STALLED;
+}
+
+/*
+ * Error left at a preset, measured on a sample taken after the stop
+ */
+static gboolean read_sample_after_stop(STATUS_SAMPLE *sample)
+{
+	gint64 stopped_us = g_get_monotonic_time();
+	gint i;
+
+	if(!status_slot_read(sample))
+		return FALSE;
+	/* wait for a sample newer than the stop, at most a few ticks */
+	for(i = 0 ; i < ACCURACY_SAMPLE_WAIT_TICKS && sample->time_us <= stopped_us ; i ++)
+	{
+		g_usleep(tick_period_us / 4);
+		status_slot_read(sample);
+	}
+	trace_status(sample);
+	return TRUE;
+}
+
+static fixed_t measure_arrival_error(const PTZ_POS *target)
+{
+	STATUS_SAMPLE sample;
+
+	if(!read_sample_after_stop(&sample))
+		return 0;
+	return motion_residual(target, &sample);
+}
+
+/*
+ * Residual correction at a preset. The continuous stop leaves up to the
+ * arrival window (and the status latency) of error, different every lap.
+ * Relative moves take out what is above the tolerance, at most
+ * correction_max_moves of them and never for longer than the budget, so
+ * the dwell starts late by a bounded amount.
+ */
+static gboolean residual_correction = FALSE;
+static fixed_t correction_tolerance_units = CORRECTION_TOLERANCE_DEFAULT_UNITS;
+static gint correction_max_moves = CORRECTION_DEFAULT_MAX_MOVES;
+static gint correction_budget_ms = CORRECTION_DEFAULT_BUDGET_MS;
+
+static void correct_residual_error(const PTZ_POS *target, fixed_t error, gfloat max_speed)
+{
+	gint64 start_us = g_get_monotonic_time();
+	/* the budget is scaled with the tick like the dwell */
+	gint64 deadline_us = start_us + (gint64)correction_budget_ms * tick_period_us / SLEEP_TIME_MILLISECONDS;
+	STATUS_SAMPLE sample;
+	gint moves = 0;
+
+	while(error > correction_tolerance_units && moves < correction_max_moves && !g_atomic_int_get(&interrupt_active) && status_slot_read(&sample))
+	{
+		WAIT_RESULT result;
+		gint remaining_ticks = (gint)((deadline_us - g_get_monotonic_time()) / tick_period_us);
+		fixed_t pan_offset = motion_pan_delta(sample.pan_val , target->pan_val);
+		fixed_t tilt_offset = fx_subx(target->tilt_val , sample.tilt_val);
+		fixed_t zoom_offset = fx_subx(target->zoom_val , sample.zoom_val);
+
+		if(remaining_ticks <= ABSOLUTE_MOVE_START_TICKS)
+		{
+			correction_budget_hits ++;
+			break;
+		}
+		if(ABS(pan_offset) <= correction_tolerance_units)
+			pan_offset = 0;
+		if(ABS(tilt_offset) <= correction_tolerance_units)
+			tilt_offset = 0;
+		if(ABS(zoom_offset) <= correction_tolerance_units)
+			zoom_offset = 0;
+
+		if(!move_to_relative_position(pan_offset, tilt_offset, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, max_speed, AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS, zoom_offset, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, NULL))
+		{
+			LOGINFO("CAN NOT START CORRECTION MOVE");
+			break;
+		}
+		/* dropped or overtaken by the preset move, not a correction */
+		if(g_atomic_int_get(&interrupt_active))
+			break;
+		moves ++;
+		result = wait_for_move_to_end(remaining_ticks, NULL);
+		if(result == WAIT_INTERRUPTED)
+			break;
+		if(result != WAIT_ARRIVED)
+		{
+			correction_budget_hits ++;
+			stop_continous_movement(TRUE , TRUE , NULL);
+			error = measure_arrival_error(target);
+			break;
+		}
+		error = measure_arrival_error(target);
+	}
+	correction_moves += moves;
+	if(g_atomic_int_get(&interrupt_active))
+	{
+		LOGINFO("Correction cut short by a preset interrupt after %d moves", moves);
+		return;
+	}
+	accuracy_stat_add(&corrected_error, error);
+	LOGINFO("Corrected to %d units with %d moves in %" G_GINT64_FORMAT " ms", error, moves, (g_get_monotonic_time() - start_us) / 1000);
+}
+
+/*
+ * Recovery after a stall: one absolute move at <max_speed> with a short
+ * timeout, then give up on the waypoint. Returns FALSE when the waypoint
+ * was skipped. A preset interrupt drops the recovery uncounted; the caller
+ * sees interrupt_active.
+ */
+static gboolean recover_stalled_segment(const PTZ_POS *target, gfloat max_speed)
+{
+	gint64 start_us = g_get_monotonic_time();
+	gboolean recovered = FALSE;
+
+	stop_continous_movement(TRUE , TRUE , NULL);
+	if(move_to_absolute_position(target->pan_val, target->tilt_val, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, max_speed, AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS, target->zoom_val, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, NULL)
+		&& !g_atomic_int_get(&interrupt_active))
+	{
+		stall_absolute_recoveries ++;
+		if(wait_for_move_to_end(STALL_RECOVERY_TIMEOUT_TICKS, NULL) == WAIT_ARRIVED)
+			recovered = (measure_arrival_error(target) <= MOTION_PAN_TILT_ARRIVAL_UNITS);
+	}
+	if(g_atomic_int_get(&interrupt_active))
+		return TRUE;
+	if(!recovered)
+	{
+		stop_continous_movement(TRUE , TRUE , NULL);
+		stall_skips ++;
+		LOGINFO("SKIPPING WAYPOINT pan:%d tilt:%d zoom:%d" , target->pan_val , target->tilt_val , target->zoom_val);
+	}
+	else
+	{
+		LOGINFO("RECOVERED WITH ABSOLUTE MOVE");
+	}
+	stall_recovery_max_us = MAX(stall_recovery_max_us, g_get_monotonic_time() - start_us);
+	return recovered;
+}
+
+/*
+ * Share of the planned pan/tilt speeds the camera already moves at, from
+ * the status samples of the last two ticks in camera time, so that a
+ * blended segment picks up the ramp where the previous one left it
+ */
+static gfloat scurve_entry_factor(fixed_t pan_speed, fixed_t tilt_speed)
+{
+	gdouble pan_vel;
+	gdouble tilt_vel;
+	gdouble zoom_vel;
+	gdouble camera_time = (gdouble)tick_period_us / (SLEEP_TIME_MILLISECONDS * 1000);
+	gdouble factor = 0;
+
+	if(!status_history_velocity(2 * tick_period_us, &pan_vel, &tilt_vel, &zoom_vel))
+		return 0.0f;
+	if(pan_speed != 0)
+		factor = MAX(factor, fabs(pan_vel) * camera_time / (fabs(fx_xtof(pan_speed, FIXMATH_FRAC_BITS)) * PAN_UNITS_PER_SECOND));
+	if(tilt_speed != 0)
+		factor = MAX(factor, fabs(tilt_vel) * camera_time / (fabs(fx_xtof(tilt_speed, FIXMATH_FRAC_BITS)) * TILT_UNITS_PER_SECOND));
+	return (gfloat)MIN(factor, 1.0);
+}
+
+/*
+ * Move from <from> to <target> with the planned continuous speeds or an
+ * absolute move, whichever choose_execution picks, at the segment's
+ * <max_speed> throughout so that it runs as planned. WAIT_ARRIVED also covers
+ * a skipped waypoint; WAIT_PREEMPTED means another client took the control,
+ * WAIT_INTERRUPTED that a preset interrupt did.
+ */
+static WAIT_RESULT execute_segment(const PTZ_POS *from, const PTZ_POS *target, fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_speed, gfloat max_speed, GError **error)
+{
+	EXEC_KIND kind = choose_execution(from, target);
+	WAIT_RESULT result;
+	gint scurve_step = -1;
+	gfloat speed_factor = 1.0f;
+
+	LOGINFO("Segment executed %s", exec_kind_names[kind]);
+	if(kind == EXEC_ABSOLUTE)
+	{
+		if(!move_to_absolute_position(target->pan_val, target->tilt_val, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, max_speed, AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS, target->zoom_val, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, error))
+		{
+			LOGINFO("Error occured during absolute move");
+			return WAIT_ERROR;
+		}
+		result = wait_for_move_to_end(ABSOLUTE_MOVE_TIMEOUT_TICKS, error);
+	}
+	else
+	{
+		if(scurve_mode)
+		{
+			scurve_step = motion_scurve_entry(&scurve, scurve_entry_factor(pan_speed, tilt_speed));
+			speed_factor = motion_scurve_factor(&scurve, scurve_step, target->pass_through ? G_MAXFLOAT : scurve_remaining_ticks(target, from->pan_val, from->tilt_val, pan_speed, tilt_speed));
+		}
+		if (!(start_segment_movement(pan_speed, tilt_speed, zoom_speed, speed_factor, from->zoom_val, NULL, error))) 
+		{
+			LOGINFO("Error occured during starting continuouse move");
+			return WAIT_ERROR;
+		}
+
+		g_usleep(tick_period_us / 5);
+
+		result = wait_for_camera_arrive_to_specific_pos(target->pan_val , target->tilt_val , target->zoom_val , pan_speed , tilt_speed , zoom_speed , target->pass_through ? from : NULL , (kind == EXEC_APPROACH) ? final_approach_units : 0 , scurve_step , speed_factor , max_speed , error);
+		if(result == WAIT_ARRIVED && kind == EXEC_APPROACH)
+		{
+			if(!move_to_absolute_position(target->pan_val, target->tilt_val, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, max_speed, AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS, target->zoom_val, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, error))
+			{
+				LOGINFO("Error occured during final approach");
+				return WAIT_ERROR;
+			}
+			result = wait_for_move_to_end(ABSOLUTE_MOVE_TIMEOUT_TICKS, error);
+		}
+	}
+
+	if(result == WAIT_ERROR)
+	{
+		LOGINFO("Error occured during waiting");
+		return WAIT_ERROR;
+	}
+	if(result == WAIT_INTERRUPTED || g_atomic_int_get(&interrupt_active))
+		return WAIT_INTERRUPTED;
+	if(result == WAIT_STALLED)
+	{
+		gboolean held = TRUE;
+
+		if(!control_still_held(&held, error))
+			return WAIT_ERROR;
+		if(!held)
+			result = WAIT_PREEMPTED;
+	}
+	if(result == WAIT_PREEMPTED)
+		return WAIT_PREEMPTED;
+	if(result == WAIT_STALLED && !recover_stalled_segment(target, max_speed))
+		return WAIT_ARRIVED;//skipped, go on with the next waypoint
+	if(g_atomic_int_get(&interrupt_active))
+		return WAIT_INTERRUPTED;
+
+	if(!target->pass_through)
+	{
+		fixed_t error = measure_arrival_error(target);
+		accuracy_stat_add(&arrival_error[kind], error);
+		preset_arrivals ++;
+		LOGINFO("Arrival error %d units (%s)", error, exec_kind_names[kind]);
+		if(residual_correction && error > correction_tolerance_units)
+			correct_residual_error(target, error, max_speed);
+	}
+	return WAIT_ARRIVED;
+}
+
+/*
+ * Drift check. The calibrated coordinates serve for weeks, while slip or a
+ * re-homing moves the real presets. During a long enough dwell the camera
+ * goes to the preset it stands at, and where it settles is compared with
+ * the plan. Differences above the tolerance move the plan towards it by at
+ * most drift_max_step per check. One preset is checked every
+ * drift_check_laps laps, in turn, and never past the end of the dwell.
+ */
+static gboolean drift_mode = FALSE;
+static gint drift_check_laps = DRIFT_DEFAULT_LAPS;
+static fixed_t drift_tolerance_units = DRIFT_DEFAULT_TOLERANCE_UNITS;
+static fixed_t drift_max_step_units = DRIFT_DEFAULT_MAX_STEP_UNITS;
+static gint drift_next_stop = 0;
+static gint drift_checked_lap = -1;
+
+static void shift_position(PTZ_POS *pos, fixed_t pan, fixed_t tilt, fixed_t zoom)
+{
+	pos->pan_val = motion_pan_wrap(fx_addx(pos->pan_val, pan));
+	pos->tilt_val = fx_addx(pos->tilt_val, tilt);
+	pos->zoom_val = fx_addx(pos->zoom_val, zoom);
+}
+
+/*
+ * Shift a stop of a circular path and the <npt> waypoints on either side,
+ * each by its share of the way to the stop, like get_circular_path put them
+ */
+static void shift_path_stop(GList *path, GList *stop, gint npt, fixed_t pan, fixed_t tilt, fixed_t zoom)
+{
+	GList *next = stop;
+	GList *prev = stop;
+	gint i;
+
+	shift_position((PTZ_POS*)stop->data, pan, tilt, zoom);
+	for(i = npt ; i > 0 ; i --)
+	{
+		next = (g_list_next(next) != NULL) ? g_list_next(next) : g_list_first(path);
+		prev = (g_list_previous(prev) != NULL) ? g_list_previous(prev) : g_list_last(path);
+		shift_position((PTZ_POS*)next->data, motion_math_scale(pan, i, npt + 1), motion_math_scale(tilt, i, npt + 1), motion_math_scale(zoom, i, npt + 1));
+		shift_position((PTZ_POS*)prev->data, motion_math_scale(pan, i, npt + 1), motion_math_scale(tilt, i, npt + 1), motion_math_scale(zoom, i, npt + 1));
+	}
+}
+
+/*
+ * Move a calibrated preset in the cache and in every stop of the preset
+ * path of the profiles that visit it
+ */
+static void correct_preset_position(gint preset_index, fixed_t pan, fixed_t tilt, fixed_t zoom)
+{
+	PTZ_POS old;
+	GList *it;
+	gint i;
+
+	for(i = 0 ; i < calibrated_count && calibrated_indices[i] != preset_index ; i ++)
+		;
+	if(i == calibrated_count)
+		return;
+	old = calibrated_positions[i];
+	shift_position(&calibrated_positions[i], pan, tilt, zoom);
+
+	for(i = 0 ; i < tour_profile_count ; i ++)
+	{
+		if(tour_profiles[i].scan)
+			continue;
+		for(it = tour_profiles[i].stops ; it != NULL ; it = g_list_next(it))
+		{
+			PTZ_POS *pos = (PTZ_POS*)it->data;
+			if(pos->pan_val == old.pan_val && pos->tilt_val == old.tilt_val && pos->zoom_val == old.zoom_val)
+				shift_position(pos, pan, tilt, zoom);
+		}
+		for(it = tour_profiles[i].path ; it != NULL ; it = g_list_next(it))
+		{
+			PTZ_POS *pos = (PTZ_POS*)it->data;
+			if(!pos->pass_through && pos->pan_val == old.pan_val && pos->tilt_val == old.tilt_val && pos->zoom_val == old.zoom_val)
+				shift_path_stop(tour_profiles[i].path, it, tour_profiles[i].npt, pan, tilt, zoom);
+		}
+	}
+}
+
+static fixed_t drift_step(fixed_t error)
+{
+	if(ABS(error) <= drift_tolerance_units)
+		return 0;
+	return CLAMP(error, -drift_max_step_units, drift_max_step_units);
+}
+
+/*
+ * Check the <stop>-th preset of the active profile if it is its turn and
+ * the dwell until <end_us> leaves the time
+ */
+static void check_preset_drift(gint stop, const PTZ_POS *planned, gint64 end_us)
+{
+	TOUR_PROFILE *profile = &tour_profiles[active_profile];
+	gint preset_index;
+	gint remaining_ticks;
+	STATUS_SAMPLE sample;
+	fixed_t pan_error;
+	fixed_t tilt_error;
+	fixed_t zoom_error;
+
+	if(profile->scan || lap_count % drift_check_laps != 0 || lap_count == drift_checked_lap
+		|| stop != drift_next_stop % profile->preset_count)
+		return;
+	drift_checked_lap = lap_count;
+	drift_next_stop = stop + 1;
+	preset_index = profile->preset_indices[stop];
+	if(end_us - g_get_monotonic_time() < (gint64)DRIFT_MIN_DWELL_MS * tick_period_us / SLEEP_TIME_MILLISECONDS)
+		return;
+
+	/* leave a tick of the dwell for the sample */
+	remaining_ticks = (gint)((end_us - g_get_monotonic_time()) / tick_period_us) - 1;
+	if(!move_to_preset(preset_index, DRIFT_PRESET_SPEED, NULL))
+		return;
+	if(wait_for_move_to_end(remaining_ticks, NULL) != WAIT_ARRIVED)
+	{
+		if(!g_atomic_int_get(&interrupt_active))
+		{
+			/* do not leave the preset move running into the next segment */
+			stop_continous_movement(TRUE , TRUE , NULL);
+			drift_timeouts ++;
+			LOGINFO("DRIFT CHECK of preset %d did not settle within the dwell", preset_index);
+		}
+		return;
+	}
+	if(!read_sample_after_stop(&sample))
+		return;
+
+	pan_error = motion_pan_delta(planned->pan_val, sample.pan_val);
+	tilt_error = fx_subx(sample.tilt_val, planned->tilt_val);
+	zoom_error = fx_subx(sample.zoom_val, planned->zoom_val);
+	drift_checks ++;
+	drift_error_max = MAX(drift_error_max, MAX(ABS(pan_error), MAX(ABS(tilt_error), ABS(zoom_error))));
+	LOGINFO("Drift of preset %d: pan %d tilt %d zoom %d units", preset_index, pan_error, tilt_error, zoom_error);
+	if(drift_step(pan_error) != 0 || drift_step(tilt_error) != 0 || drift_step(zoom_error) != 0)
+	{
+		drift_corrections ++;
+		correct_preset_position(preset_index, drift_step(pan_error), drift_step(tilt_error), drift_step(zoom_error));
+		LOGINFO("Preset %d moved by pan %d tilt %d zoom %d units", preset_index, drift_step(pan_error), drift_step(tilt_error), drift_step(zoom_error));
+	}
+}
+
+/*
+ * Dwell at a preset like dwell(), but give way to a preset interrupt.
+ * With drift checks on, the dwell at the <stop>-th preset of the profile,
+ * planned at <planned>, may check that preset. FALSE when interrupted.
+ */
+static gboolean dwell_at_preset(gint delay_ms, gint stop, const PTZ_POS *planned)
+{
+	gint64 end_us = g_get_monotonic_time() + (gint64)delay_ms * tick_period_us / SLEEP_TIME_MILLISECONDS;
+	gint64 now;
+
+	if(drift_mode && stop >= 0 && stop < tour_profiles[active_profile].preset_count)
+		check_preset_drift(stop, planned, end_us);
+
+	while((now = g_get_monotonic_time()) < end_us)
+	{
+		if(g_atomic_int_get(&interrupt_active))
+			return FALSE;
+		g_usleep(MIN(end_us - now, tick_period_us));
+	}
+	return !g_atomic_int_get(&interrupt_active);
+}
+
+/*
+ * Trigger to motion latency: the first status sample after the trigger
+ * that is off the course of the last two samples before it, so that it
+ * works from a standstill and mid-segment alike. Resolution is the status
+ * sample period.
+ */
+static gboolean interrupt_motion_started(const PRESET_INTERRUPT *request, STATUS_SAMPLE *before, gint *before_count)
+{
+	STATUS_SAMPLE samples[STATUS_HISTORY_LENGTH];
+	gint n = status_history_read(samples, STATUS_HISTORY_LENGTH);
+	gint i;
+
+	for(i = 0 ; i < n ; i ++)
+	{
+		gint64 span_us;
+		gint64 dt_us;
+		gint64 latency_us;
+		fixed_t pan;
+		fixed_t tilt;
+		fixed_t zoom;
+
+		if(samples[i].time_us <= request->trigger_us)
+		{
+			if(*before_count == 0 || samples[i].time_us > before[1].time_us)
+			{
+				before[0] = before[1];
+				before[1] = samples[i];
+				*before_count = MIN(*before_count + 1, 2);
+			}
+			continue;
+		}
+		if(*before_count < 2)
+			continue;
+		span_us = MAX(before[1].time_us - before[0].time_us, 1);
+		dt_us = samples[i].time_us - before[1].time_us;
+		pan = before[1].pan_val + (fixed_t)(motion_pan_delta(before[0].pan_val, before[1].pan_val) * dt_us / span_us);
+		tilt = before[1].tilt_val + (fixed_t)((gint64)(before[1].tilt_val - before[0].tilt_val) * dt_us / span_us);
+		zoom = before[1].zoom_val + (fixed_t)((gint64)(before[1].zoom_val - before[0].zoom_val) * dt_us / span_us);
+		if(ABS(motion_pan_delta(pan, samples[i].pan_val)) + ABS(samples[i].tilt_val - tilt) + ABS(samples[i].zoom_val - zoom) <= INTERRUPT_MOTION_UNITS)
+			continue;
+
+		latency_us = samples[i].time_us - request->trigger_us;
+		interrupt_motion_count ++;
+		interrupt_motion_latency_sum_us += latency_us;
+		interrupt_motion_latency_max_us = MAX(interrupt_motion_latency_max_us, latency_us);
+		LOGINFO("PRESET INTERRUPT moving %" G_GINT64_FORMAT " us after the trigger", latency_us);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Hold the interrupt preset: wait for the preset move to end and stay for
+ * the hold time, in control ticks like the dwell. A new trigger restarts
+ * the hold, a release ends it. The tour's commands go out again once this
+ * returns.
+ */
+static void hold_preset_interrupt(gint segment)
+{
+	g_autoptr(GError) local_error = NULL;
+	PRESET_INTERRUPT request;
+	STATUS_SAMPLE before[2];
+	gint before_count = 0;
+	gboolean motion_seen = FALSE;
+	gboolean arrived = FALSE;
+	gboolean held = FALSE;
+	gint64 start_us = g_get_monotonic_time();
+	gint64 hold_end_us = 0;
+	TICK_TIMER tick_timer;
+	gint ticks = 0;
+
+	g_mutex_lock(&ptz_command_lock);
+	request = interrupt_request;
+	g_mutex_unlock(&ptz_command_lock);
+	LOGINFO("Tour interrupted at No%d position, holding preset %d", segment, request.preset);
+	publish_status(STATUS_STATE_INTERRUPTED, segment, NULL, NULL);
+
+	tick_timer_start(&tick_timer, tick_period_us, TRUE);
+	while(!held)
+	{
+		gboolean is_moving = FALSE;
+		gint64 now;
+
+		tick_timer_wait(&tick_timer);
+		ticks ++;
+		now = g_get_monotonic_time();
+		if(!motion_seen)
+			motion_seen = interrupt_motion_started(&request, before, &before_count);
+		if(!arrived)
+		{
+			if(!ax_ptz_movement_handler_is_ptz_moving(VIDEO_CHANNEL, &is_moving, &local_error))
+			{
+				LOGINFO(local_error->message);
+				g_clear_error(&local_error);
+			}
+			if((!is_moving && ticks >= ABSOLUTE_MOVE_START_TICKS) || ticks >= INTERRUPT_MOVE_TIMEOUT_TICKS)
+			{
+				arrived = TRUE;
+				hold_end_us = now + (gint64)request.hold_ms * tick_period_us / SLEEP_TIME_MILLISECONDS;
+				LOGINFO("PRESET INTERRUPT at preset %d after %" G_GINT64_FORMAT " ms", request.preset, (now - request.command_us) / 1000);
+			}
+		}
+
+		g_mutex_lock(&ptz_command_lock);
+		if(interrupt_request.sequence != request.sequence)
+		{
+			/* triggered again, maybe to another preset */
+			request = interrupt_request;
+			motion_seen = FALSE;
+			before_count = 0;
+			arrived = FALSE;
+			ticks = 0;
+		}
+		else if(interrupt_request.release || !g_atomic_int_get(&tour_running) || (arrived && now >= hold_end_us))
+		{
+			interrupt_request.release = FALSE;
+			g_atomic_int_set(&interrupt_active, FALSE);
+			held = TRUE;
+		}
+		g_mutex_unlock(&ptz_command_lock);
+	}
+	interrupt_hold_total_us += g_get_monotonic_time() - start_us;
+	LOGINFO("PRESET INTERRUPT over after %.1f s, resuming at No%d position", (g_get_monotonic_time() - start_us) / (gdouble)G_USEC_PER_SEC, segment);
+}
+
+static gint find_tour_profile(const gchar *name)
+{
+	gint i;
+
+	for(i = 0 ; i < tour_profile_count ; i ++)
+	{
+		if(g_strcmp0(tour_profiles[i].name, name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static TOUR_PROFILE *get_tour_profile(const gchar *name)
+{
+	gint i = find_tour_profile(name);
+
+	if(i >= 0)
+		return &tour_profiles[i];
+	if(tour_profile_count >= MAX_TOUR_PROFILES)
+		return NULL;
+	i = tour_profile_count ++;
+	memset(&tour_profiles[i], 0, sizeof(TOUR_PROFILE));
+	g_strlcpy(tour_profiles[i].name, name, TOUR_PROFILE_NAME_LENGTH);
+	tour_profiles[i].npt = NPT;
+	return &tour_profiles[i];
+}
+
+/*
+ * Dwell at the <stop>-th preset of a profile, none on the way back
+ */
+static gint profile_delay(const TOUR_PROFILE *profile, gint stop)
+{
+	if(stop < 0 || stop >= profile->preset_count)
+		return 0;
+	return profile->budgeted ? profile->budget_delay[stop] : profile->preset_delay[stop];
+}
+
+/*
+ * Dwell at the <count>-th waypoint of a profile's path, and the preset it
+ * stops at in <stop> (-1 for none): every npt+1-th waypoint of a preset
+ * tour, the holds of a taught path
+ */
+static gint waypoint_delay(const TOUR_PROFILE *profile, gint count, gint *stop)
+{
+	*stop = -1;
+	if(profile->teach)
+		return profile->teach_holds[count - 1];
+	if(profile->npt == 0)
+		*stop = count - 1;
+	else if(count % (profile->npt + 1) == 1)
+		*stop = count / (profile->npt + 1);
+	return profile_delay(profile, *stop);
+}
+
+/*
+ * Max speed of the segment to the <count>-th waypoint
+ */
+static gfloat profile_max_speed(const TOUR_PROFILE *profile, gint count)
+{
+	if(profile->teach)
+		return profile->teach_speeds[count - 1];
+	return profile->budgeted ? profile->budget_speed : cont_max_speed;
+}
+
+/*
+ * Split a tour preset name, [profile_]presetposno<index>=<number>[_<delay>]
+ * ("_" works in place of "="), into its parts. FALSE for the home preset
+ * and for names that are not tour presets.
+ */
+static gboolean parse_preset_name(const gchar *preset_name, gchar *profile_name, gint *index, gint *number, gint *delay)
+{
+	gchar temp[MAX_PRESET_NAME_LENGTH + 2];
+	gchar *pch;
+	gint len = strlen(preset_name);
+
+	if(len < 17 || len > MAX_PRESET_NAME_LENGTH)
+		return FALSE;
+	strcpy(temp, "=");
+	strcat(temp, preset_name);
+	g_strlcpy(profile_name, DEFAULT_TOUR_PROFILE, TOUR_PROFILE_NAME_LENGTH);
+	pch = strtok(temp,"=_");
+	if(pch != NULL && strncmp(pch, "presetposno", 11) != 0)
+	{
+		//profile prefix, e.g. night_presetposno3_2_5
+		g_strlcpy(profile_name, pch, TOUR_PROFILE_NAME_LENGTH);
+		pch = strtok(NULL, "=_");
+	}
+	if(pch == NULL || strcmp(pch, "presetposno1") == 0)//home preset position
+		return FALSE;
+	len = strlen(pch);
+	if(len <= 11 || len >= 15 || strncmp(pch, "presetposno", 11) != 0)
+		return FALSE;
+	*index = (gint)atoi(pch + 11);
+	if((pch = strtok(NULL, "=_")) == NULL)
+		return FALSE;
+	*number = (gint)atoi(pch);
+	pch = strtok(NULL, "=_");
+	*delay = (pch != NULL) ? (gint)atoi(pch) : 0;
+	return TRUE;
+}
+
+/*
+ * Sort the named presets into tour profiles, each in preset number order
+ */
+static void build_tour_profiles(GList *preset_names)
+{
+	GList* it = NULL;
+
+	tour_profile_count = 0;
+	for(it = g_list_first(preset_names) ; it != NULL ; it = g_list_next(it))
+	{
+		gchar* preset_name = (gchar*)it->data;
+		gchar profile_name[TOUR_PROFILE_NAME_LENGTH];
+		TOUR_PROFILE *profile;
+		gint preset_count;
+		gint index;
+		gint number;
+		gint delay;
+
+		if(!parse_preset_name(preset_name, profile_name, &index, &number, &delay))
+			continue;
+		if(!(profile = get_tour_profile(profile_name)) || profile->preset_count >= MAX_PRESET_NUMBER)
+		{
+			LOGINFO("NO ROOM FOR PRESET %s", preset_name);
+			continue;
+		}
+		preset_count = profile->preset_count;
+		profile->preset_indices[preset_count] = index;
+		profile->preset_numbers[preset_count] = number;
+		profile->preset_delay[preset_count] = delay;
+
+		LOGINFO("PRESETNUMBER%d-%d-%d-%s" , preset_count , profile->preset_indices[preset_count] , (gint)(profile->preset_numbers[preset_count]), preset_name);
+
+		profile->preset_count ++;
+	}
+//home preset is the first one and we dont need it
+//i should start from 1
+  
+  //sort preset_index and preset_numbers
+	gint p;
+	for(p = 0 ; p < tour_profile_count ; p ++)
+	{
+		TOUR_PROFILE *profile = &tour_profiles[p];
+		gint i = 0;
+		for(i = 0 ; i < (profile->preset_count - 1) ; i++)
+		{
+			gint j = i + 1;
+			for(j = i + 1 ; j < (profile->preset_count) ; j++)
+			{
+				if(profile->preset_numbers[i] > profile->preset_numbers[j])
+				{
+					gint char_temp;
+					char_temp = profile->preset_numbers[i];
+					profile->preset_numbers[i] = profile->preset_numbers[j];
+					profile->preset_numbers[j] = char_temp;
+					
+					gint int_temp;
+					int_temp = profile->preset_indices[i];
+					profile->preset_indices[i] = profile->preset_indices[j];
+					profile->preset_indices[j] = int_temp;
+					
+					gint int_temp1;
+					int_temp1 = profile->preset_delay[i];
+					profile->preset_delay[i] = profile->preset_delay[j];
+					profile->preset_delay[j] = int_temp1;
+				}
+			}
+		}
+	}
+
+	//a tour needs two presets at least
+	for(p = 0 ; p < tour_profile_count ; )
+	{
+		if(tour_profiles[p].preset_count > 1)
+		{
+			LOGINFO("Tour profile %s - %d presets", tour_profiles[p].name, tour_profiles[p].preset_count);
+			p ++;
+			continue;
+		}
+		LOGINFO("Tour profile %s has fewer than 2 presets, ignored", tour_profiles[p].name);
+		memmove(&tour_profiles[p], &tour_profiles[p + 1], (tour_profile_count - p - 1) * sizeof(TOUR_PROFILE));
+		tour_profile_count --;
+	}
+  
+}
+
+static void get_path()
+{
+	GError *local_error = NULL;
+	GList *temp = NULL;
+	temp = ax_ptz_preset_handler_query_presets(ax_ptz_control_queue_group, VIDEO_CHANNEL, FALSE, &local_error);//preset names
+
+	build_tour_profiles(temp);
+	g_list_free_full(temp, g_free);
+	g_clear_error(&local_error);
+	return;
+}
+
+
+/*
+ * The calibrated <stops> with <npt> interpolated waypoints after each one,
+ * closing the circle back to the first stop
+ */
+static GList *get_circular_path(GList *stops, gint npt)
+{
+	GList* realPath = NULL;
+	GList* it = NULL;
+	gint pathCount = 0;
+
+	for(it = g_list_first(stops) ; it != NULL ; it = g_list_next(it))
+	{
+		pathCount ++;
+		PTZ_POS* temp = g_malloc(sizeof(PTZ_POS));
+		temp->pan_val = ((PTZ_POS*)(it->data))->pan_val;
+		temp->tilt_val = ((PTZ_POS*)(it->data))->tilt_val;
+		temp->zoom_val = ((PTZ_POS*)(it->data))->zoom_val;
+		temp->pass_through = FALSE;
+		realPath = g_list_prepend(realPath , temp);
+		LOGINFO("Path Number:%d" , pathCount);
+		LOGINFO("Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , pathCount , ((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(it->data))->tilt_val , ((PTZ_POS*)(it->data))->zoom_val);
+		if(g_list_next(it) != NULL)//This means <it> is not the last node
+		{
+			gint i;
+			for(i = 0 ; i < npt ; i ++)
+			{
+				PTZ_POS* temp = g_malloc(sizeof(PTZ_POS));
+				temp->pan_val = motion_pan_wrap(fx_addx(((PTZ_POS*)(it->data))->pan_val , motion_math_scale(motion_pan_delta(((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(g_list_next(it)->data))->pan_val) , i + 1 , npt + 1)));
+				temp->tilt_val = fx_addx(((PTZ_POS*)(it->data))->tilt_val , motion_math_scale(fx_subx(((PTZ_POS*)(g_list_next(it)->data))->tilt_val , ((PTZ_POS*)(it->data))->tilt_val) , i + 1 , npt + 1));
+				temp->zoom_val = fx_addx(((PTZ_POS*)(it->data))->zoom_val , motion_math_scale(fx_subx(((PTZ_POS*)(g_list_next(it)->data))->zoom_val , ((PTZ_POS*)(it->data))->zoom_val) , i + 1 , npt + 1));
+				temp->pass_through = TRUE;
+				realPath = g_list_prepend(realPath , temp);
+				pathCount ++;
+				LOGINFO("Path Number:%d" , pathCount);
+				LOGINFO("Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , pathCount , temp->pan_val , temp->tilt_val , temp->zoom_val);
+			}
+		}
+		else//This means <it> is the last node
+		{
+			gint i;
+			for(i = 0 ; i < npt ; i ++)
+			{
+				PTZ_POS* temp = g_malloc(sizeof(PTZ_POS));
+				temp->pan_val = motion_pan_wrap(fx_addx(((PTZ_POS*)(it->data))->pan_val , motion_math_scale(motion_pan_delta(((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(g_list_first(stops)->data))->pan_val) , i + 1 , npt + 1)));
+				temp->tilt_val = fx_addx(((PTZ_POS*)(it->data))->tilt_val , motion_math_scale(fx_subx(((PTZ_POS*)(g_list_first(stops)->data))->tilt_val , ((PTZ_POS*)(it->data))->tilt_val) , i + 1 , npt + 1));
+				temp->zoom_val = fx_addx(((PTZ_POS*)(it->data))->zoom_val , motion_math_scale(fx_subx(((PTZ_POS*)(g_list_first(stops)->data))->zoom_val , ((PTZ_POS*)(it->data))->zoom_val) , i + 1 , npt + 1));
+				temp->pass_through = TRUE;
+				realPath = g_list_prepend(realPath , temp);
+				pathCount ++;
+				LOGINFO("Path Number:%d" , pathCount);
+				LOGINFO("Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , pathCount , temp->pan_val , temp->tilt_val , temp->zoom_val);
+			}
+		}
+	}
+	/* built back to front, appending would walk the whole list per waypoint */
+	return g_list_reverse(realPath);
+}
+
+/*
+ * Log the current position and the unitless limits, and build the zoom to
+ * field of view table from the zoom range
+ */
+static gboolean get_ptz_status_and_limits(void)
+{
+	g_autoptr(AXPTZStatus) unitless_status = NULL;
+	g_autoptr(AXPTZLimits) unitless_limits = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_status, &local_error))) 
+	{
+		LOGINFO(local_error->message);
+		return FALSE;
+	}
+	LOGINFO("Current Camera PTZ unitless pos - PAN:%d , TILT:%d , ZOOM:%d" , unitless_status->pan_value , unitless_status->tilt_value , unitless_status->zoom_value);
+
+	/* Get the pan, tilt and zoom limits for the unitless space */
+	if (!(ax_ptz_movement_handler_get_ptz_limits(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS , AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_limits, &local_error))) 
+	{
+		LOGINFO(local_error->message);
+		return FALSE;
+	}
+	LOGINFO("Limits pan max: %d, pan min: %d, tilt max: %d, tilt min: %d, zoom max: %d, zoom min: %d", unitless_limits->max_pan_value, unitless_limits->min_pan_value, unitless_limits->max_tilt_value, unitless_limits->min_tilt_value, unitless_limits->max_zoom_value, unitless_limits->min_zoom_value);
+	//Limits pan max: 32768, pan min: -32768, tilt max: 3641, tilt min: -16384, zoom max: 35748, zoom min: 3
+	// 32768 => 180
+	//-32768 => -180
+	//  3641 => 20
+	//-16384 => -90
+	// 35748 => 24 32768 => 12 32768 ~ 35748 => 12 ~ 24
+	//     3 => 1
+
+	build_zoom_fov_table(unitless_limits->min_zoom_value, unitless_limits->max_zoom_value);
+	pan_limit_min = unitless_limits->min_pan_value;
+	pan_limit_max = unitless_limits->max_pan_value;
+	tilt_limit_min = unitless_limits->min_tilt_value;
+	tilt_limit_max = unitless_limits->max_tilt_value;
+	motion_set_pan_wrap(endless_pan, pan_limit_min, pan_limit_max);
+	LOGINFO("Pan %s", motion_pan_wraps() ? "wraps at the seam, taking the short way round" : "does not wrap");
+	return TRUE;
+}
+
+/*
+ * Camera time to wall time, scaled with the tick like dwell()
+ */
+static gint64 settle_us(gdouble ms)
+{
+	return (gint64)(ms * tick_period_us / SLEEP_TIME_MILLISECONDS);
+}
+
+/*
+ * Milliseconds a preset move needs for <distance> units per axis, pan and
+ * tilt at <speed> and zoom at the camera's own speed, with the dry run's
+ * model
+ */
+static gdouble settle_predict_ms(const gdouble distance[3], gfloat speed)
+{
+	gdouble rate[3] = { PAN_UNITS_PER_SECOND, TILT_UNITS_PER_SECOND, (zoom_fov_max_zoom - zoom_fov_min_zoom) / PREDICT_ZOOM_FULL_RANGE_SECONDS };
+	gdouble axis_speed[3] = { speed, speed, 1.0 };
+	gdouble seconds = 0;
+	gint axis;
+
+	for(axis = 0 ; axis < 3 ; axis ++)
+		seconds = MAX(seconds, motion_predict_axis_time(distance[axis], axis_speed[axis] * rate[axis], predict_accel[axis] * rate[axis], 0, 0));
+	return seconds * 1000 + predict_latency_ms;
+}
+
+static fixed_t settle_distance(const PTZ_POS *a, const PTZ_POS *b)
+{
+	return MAX(ABS(motion_pan_delta(a->pan_val, b->pan_val)), MAX(ABS(fx_subx(b->tilt_val, a->tilt_val)), ABS(fx_subx(b->zoom_val, a->zoom_val))));
+}
+
+static const PTZ_POS *settle_hint(gint preset_index)
+{
+	gint i;
+
+	for(i = 0 ; i < settle_hint_count ; i ++)
+	{
+		if(settle_hint_indices[i] == preset_index)
+			return &settle_hint_positions[i];
+	}
+	return NULL;
+}
+
+/*
+ * Wait for a preset move from <from> at <speed> to settle and return where
+ * it did in <settled>. The moving flag alone is not trusted: the camera has
+ * settled once it reports no motion on SETTLE_STABLE_POLLS polls in a row
+ * whose positions are within SETTLE_TOLERANCE_UNITS of the poll before.
+ * With the preset's position from the last run (<hint>) the polls back off
+ * until shortly before the predicted end of the move and are dense from
+ * there on; without one they back off while the camera keeps its speed and
+ * are dense once it slows down. The timeout is the predicted move with a
+ * margin over the distance to <hint>; a move that outlasts it, to a preset
+ * moved since, and a move without a hint get the timeout over the whole
+ * travel range.
+ */
+static gboolean wait_for_camera_movement_to_finish(const PTZ_POS *from, const PTZ_POS *hint, gfloat speed, PTZ_POS *settled)
+{
+	g_autoptr(GError) local_error = NULL;
+	gdouble range[3] = { (motion_pan_wraps() ? 0.5 : 1.0) * (pan_limit_max - pan_limit_min), tilt_limit_max - tilt_limit_min, zoom_fov_max_zoom - zoom_fov_min_zoom };
+	gint64 start_us = g_get_monotonic_time();
+	gdouble move_ms = settle_predict_ms(range, speed);
+	gint64 timeout_us;
+	gint64 dense_us = 0;
+	gint64 poll_us = settle_us(SETTLE_POLL_MIN_MS);
+	gint64 last_us = start_us;
+	gdouble last_rate = 0;
+	gboolean motion_seen = FALSE;
+	gint stable = 0;
+	gint polls = 0;
+	PTZ_POS last = *from;
+
+	if(hint != NULL)
+	{
+		gdouble distance[3] = { ABS(motion_pan_delta(from->pan_val, hint->pan_val)), ABS(fx_subx(hint->tilt_val, from->tilt_val)), ABS(fx_subx(hint->zoom_val, from->zoom_val)) };
+
+		move_ms = settle_predict_ms(distance, speed);
+		dense_us = start_us + settle_us(move_ms - SETTLE_DENSE_LEAD_MS);
+	}
+	timeout_us = settle_us(move_ms * SETTLE_TIMEOUT_FACTOR + SETTLE_TIMEOUT_MARGIN_MS);
+
+	for(;;)
+	{
+		g_autoptr(AXPTZStatus) unitless_status = NULL;
+		gboolean is_moving = TRUE;
+		PTZ_POS pos;
+		gint64 now;
+		fixed_t step;
+		gdouble rate;
+
+		g_usleep(poll_us);
+		polls ++;
+		if(!ax_ptz_movement_handler_is_ptz_moving(VIDEO_CHANNEL, &is_moving, &local_error)
+			|| !ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_status, &local_error))
+		{
+			LOGINFO(local_error->message);
+			return FALSE;
+		}
+		now = g_get_monotonic_time();
+		pos.pan_val = unitless_status->pan_value;
+		pos.tilt_val = unitless_status->tilt_value;
+		pos.zoom_val = unitless_status->zoom_value;
+		pos.pass_through = FALSE;
+		step = settle_distance(&last, &pos);
+		rate = (gdouble)step / MAX(now - last_us, 1);
+		last = pos;
+		last_us = now;
+
+		/* the move is asynchronous, a camera that has not started yet has not settled */
+		motion_seen = motion_seen || is_moving || settle_distance(from, &pos) > SETTLE_TOLERANCE_UNITS
+			|| (hint != NULL && settle_distance(hint, &pos) <= SETTLE_TOLERANCE_UNITS);
+		if(!is_moving && step <= SETTLE_TOLERANCE_UNITS && (motion_seen || now - start_us >= settle_us(SETTLE_START_MS)))
+			stable ++;
+		else
+			stable = 0;
+		if(stable >= SETTLE_STABLE_POLLS)
+		{
+			*settled = pos;
+			LOGINFO("Settled after %" G_GINT64_FORMAT " ms, %d polls", (now - start_us) / 1000, polls);
+			return TRUE;
+		}
+		if(now - start_us >= timeout_us && hint != NULL)
+		{
+			LOGINFO("No settle within %" G_GINT64_FORMAT " ms of the hint, the preset has moved", timeout_us / 1000);
+			hint = NULL;
+			timeout_us = settle_us(settle_predict_ms(range, speed) * SETTLE_TIMEOUT_FACTOR + SETTLE_TIMEOUT_MARGIN_MS);
+		}
+		if(now - start_us >= timeout_us)
+		{
+			LOGINFO("WAITING FOR CAMERA MOVEMENT TO FINISH TIME OUT");
+			return FALSE;
+		}
+
+		/* dense while starting and stopping, toward the predicted end or when slowing down */
+		if(stable > 0 || !is_moving || !motion_seen)
+			poll_us = settle_us(SETTLE_POLL_MIN_MS);
+		else if(hint != NULL)
+			poll_us = CLAMP(dense_us - now, settle_us(SETTLE_POLL_MIN_MS), settle_us(SETTLE_POLL_MAX_MS));
+		else if(rate < last_rate * SETTLE_SLOWDOWN)
+			poll_us = settle_us(SETTLE_POLL_MIN_MS);
+		else
+			poll_us = MIN(poll_us * 2, settle_us(SETTLE_POLL_MAX_MS));
+		last_rate = rate;
+	}
+}
+
+/*
+ * Drive to a preset, wait until the camera stands still and append the
+ * position it settled at to <stops>. A preset is only driven to once,
+ * later profiles and visits reuse the position.
+ */
+static gboolean capture_preset_position(gint preset_index, GList **stops)
+{
+	g_autoptr(AXPTZStatus) unitless_status = NULL;
+	g_autoptr(GError) local_error = NULL;
+	PTZ_POS* pos = NULL;
+	PTZ_POS from;
+	gint i;
+
+	for(i = 0 ; i < calibrated_count ; i ++)
+	{
+		if(calibrated_indices[i] == preset_index)
+		{
+			pos = g_new(PTZ_POS, 1);
+			*pos = calibrated_positions[i];
+			*stops = g_list_append(*stops , pos);
+			LOGINFO("PRESETNO:%d already calibrated" , preset_index);
+			return TRUE;
+		}
+	}
+	if(dry_run)
+	{
+		LOGINFO("PRESETNO:%d has no saved position" , preset_index);
+		return FALSE;
+	}
+
+	/* Get the current status (e.g. the current pan/tilt/zoom value/position) */
+	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_status, &local_error))) 
+	{
+		LOGINFO(local_error->message);
+		return FALSE;
+	}
+	from.pan_val = unitless_status->pan_value;
+	from.tilt_val = unitless_status->tilt_value;
+	from.zoom_val = unitless_status->zoom_value;
+	from.pass_through = FALSE;
+
+	trace_write(TRACE_COMMAND, TRACE_CMD_PRESET, preset_index, fx_ftox(CALIBRATION_PRESET_SPEED, FIXMATH_FRAC_BITS), 0, 0, 0, 0);
+	if(!ax_ptz_preset_handler_goto_preset_number(ax_ptz_control_queue_group ,VIDEO_CHANNEL , preset_index , fx_ftox(CALIBRATION_PRESET_SPEED, FIXMATH_FRAC_BITS) , AX_PTZ_PRESET_MOVEMENT_UNITLESS , AX_PTZ_INVOKE_ASYNC , NULL , NULL , &local_error))
+	{
+		LOGINFO(local_error->message);
+		return FALSE;
+	}
+	LOGINFO("Move to preset%d position started" , preset_index);
+
+	//the settled position is the preset position
+	pos = g_new(PTZ_POS, 1);
+	if(!wait_for_camera_movement_to_finish(&from, settle_hint(preset_index), CALIBRATION_PRESET_SPEED, pos))
+	{
+		g_free(pos);
+		return FALSE;
+	}
+	LOGINFO("Move to preset%d position Ended" , preset_index);
+	*stops = g_list_append(*stops , pos);
+	if(calibrated_count < (gint)G_N_ELEMENTS(calibrated_indices))
+	{
+		calibrated_indices[calibrated_count] = preset_index;
+		calibrated_positions[calibrated_count] = *pos;
+		calibrated_count ++;
+	}
+	LOGINFO("PRESETNO:%d , PAN:%d , TILT:%d , ZOOM:%d" , preset_index , pos->pan_val , pos->tilt_val , pos->zoom_val);
+	return TRUE;
+}
+
+/*
+ * Calibrate the presets of a profile and compile its path: out along the
+ * presets in their order and back
+ */
+static gboolean calibrate_profile(TOUR_PROFILE *profile)
+{
+	gint i;
+
+	LOGINFO("Calibrating tour profile %s BEGIN", profile->name);
+	for(i = 0 ; i < profile->preset_count ; i ++)
+	{
+		LOGINFO("number%d" , profile->preset_numbers[i]);
+		LOGINFO("index%d" , profile->preset_indices[i]);
+		if(!capture_preset_position(profile->preset_indices[i], &profile->stops))
+			return FALSE;
+	}
+	for(i = profile->preset_count - 2 ; i > 0 ; i --)
+	{
+		if(!capture_preset_position(profile->preset_indices[i], &profile->stops))
+			return FALSE;
+	}
+	profile->path = get_circular_path(profile->stops, profile->npt);
+	LOGINFO("Calibrating tour profile %s END, %d waypoints", profile->name, g_list_length(profile->path));
+	return TRUE;
+}
+
+/*
+ * Coverage scan. The two corner presets span a pan/tilt zone. At the scan
+ * zoom the field of view from the zoom table sets the row spacing, so that
+ * neighbouring rows overlap by scan_overlap of the vertical field of view.
+ * The path sweeps the rows back and forth along pan, stops at each row end
+ * and blends through the tilt step into the next row; the tour loop runs
+ * it like any other profile, one cycle per lap.
+ */
+static fixed_t scan_zoom_value(const PTZ_POS *corner)
+{
+	if(scan_zoom_ratio < 1.0f)
+		return corner->zoom_val;
+	return zoom_fov_min_zoom + (fixed_t)((zoom_fov_max_zoom - zoom_fov_min_zoom) * (MIN(scan_zoom_ratio, max_zoom_ratio) - 1.0f) / MAX(max_zoom_ratio - 1.0f, 0.001f));
+}
+
+/*
+ * The boustrophedon path from corner <from> to corner <to> (pan the short
+ * way round), and the area it images in square degrees
+ */
+static GList *get_scan_path(const PTZ_POS *from, const PTZ_POS *to, gdouble *area)
+{
+	fixed_t zoom = scan_zoom_value(from);
+	gfloat hfov = zoom_to_fov(zoom);
+	gfloat vfov = hfov_to_vfov(hfov);
+	fixed_t pan_extent = motion_pan_delta(from->pan_val, to->pan_val);
+	fixed_t tilt_extent = fx_subx(to->tilt_val, from->tilt_val);
+	fixed_t row_step = MAX((fixed_t)(vfov * (1.0f - scan_overlap) * UNITS_PER_DEGREE), 1);
+	gint rows = (tilt_extent == 0) ? 1 : (ABS(tilt_extent) + row_step - 1) / row_step + 1;
+	gint ends = (pan_extent == 0) ? 1 : 2;
+	gdouble pan_degrees = ABS(pan_extent) / UNITS_PER_DEGREE;
+	gdouble tilt_degrees = ABS(tilt_extent) / UNITS_PER_DEGREE;
+	gdouble pan_rate = cont_max_speed * PAN_MAX_DEGREES_PER_SECOND;
+	gdouble tilt_rate = cont_max_speed * TILT_MAX_DEGREES_PER_SECOND;
+	gdouble cycle_s;
+	GList *path = NULL;
+	gint row;
+	gint end;
+
+	if(rows > SCAN_MAX_ROWS)
+	{
+		LOGINFO("Scan needs %d rows, limited to %d: the rows will not overlap", rows, SCAN_MAX_ROWS);
+		rows = SCAN_MAX_ROWS;
+	}
+	for(row = 0 ; row < rows ; row ++)
+	{
+		fixed_t tilt = fx_addx(from->tilt_val, (rows > 1) ? motion_math_scale(tilt_extent, row, rows - 1) : 0);
+
+		for(end = 0 ; end < ends ; end ++)
+		{
+			PTZ_POS *pos = g_new(PTZ_POS, 1);
+			/* even rows sweep towards <to>, odd rows back */
+			gboolean far_end = (ends == 2) && ((row % 2 == 0) ? end == 1 : end == 0);
+
+			pos->pan_val = motion_pan_wrap(fx_addx(from->pan_val, far_end ? pan_extent : 0));
+			pos->tilt_val = tilt;
+			pos->zoom_val = zoom;
+			pos->pass_through = (end == 0 && row > 0);
+			path = g_list_append(path, pos);
+		}
+	}
+
+	/* the sweeps, the tilt steps and the way back to the start */
+	*area = (pan_degrees + hfov) * (tilt_degrees + vfov);
+	cycle_s = rows * pan_degrees / pan_rate + tilt_degrees / tilt_rate + MAX((rows % 2) ? pan_degrees / pan_rate : 0.0, tilt_degrees / tilt_rate);
+	LOGINFO("Scan plan: %d rows of %.1f degrees, %.1f degrees apart, field of view %.1f x %.1f degrees at zoom %d", rows, pan_degrees, (rows > 1) ? tilt_degrees / (rows - 1) : 0.0, hfov, vfov, zoom);
+	LOGINFO("Scan plan: %.0f square degrees, cycle about %.1f s, %.1f square degrees/s", *area, cycle_s, *area / MAX(cycle_s, 0.001));
+	return path;
+}
+
+/*
+ * Add the scan profile when ScanEnabled, unless a preset prefix took the name
+ */
+static void add_scan_profile(void)
+{
+	TOUR_PROFILE *profile;
+
+	if(find_tour_profile(SCAN_PROFILE_NAME) >= 0 || !(profile = get_tour_profile(SCAN_PROFILE_NAME)))
+	{
+		LOGINFO("No room for the %s profile, coverage scan disabled", SCAN_PROFILE_NAME);
+		return;
+	}
+	profile->scan = TRUE;
+	LOGINFO("Coverage scan between presets %d and %d, overlap %.2f", scan_corners[0], scan_corners[1], scan_overlap);
+}
+
+static gboolean calibrate_scan_profile(TOUR_PROFILE *profile)
+{
+	LOGINFO("Calibrating scan profile %s BEGIN", profile->name);
+	if(!capture_preset_position(scan_corners[0], &profile->stops) || !capture_preset_position(scan_corners[1], &profile->stops))
+		return FALSE;
+	profile->path = get_scan_path((PTZ_POS*)g_list_first(profile->stops)->data, (PTZ_POS*)g_list_last(profile->stops)->data, &profile->scan_area);
+	LOGINFO("Calibrating scan profile %s END, %d waypoints", profile->name, g_list_length(profile->path));
+	return TRUE;
+}
+
+/*
+ * Teach mode. "--teach" records the status at the full sample rate while
+ * an operator steers, compresses the path to the waypoints within
+ * TeachTolerance units of it (see motion_teach_compress) and saves them
+ * as a plan of "move_ms pan tilt zoom hold_ms" lines, the raw samples
+ * next to it for panoramatv_mathbench. TeachEnabled replays the plan as
+ * the "teach" profile through the same executor as the preset tours; each
+ * segment gets the speed that takes as long as the operator took, holds
+ * become dwells.
+ */
+static gboolean write_teach_plan(const gchar *path, const STATUS_SAMPLE *samples, gint count, const MOTION_TEACH_POINT *points, gint n, GError **error)
+{
+	g_autofree gchar *samples_path = g_strconcat(path, ".samples", NULL);
+	GString *contents = g_string_new(NULL);
+	gboolean ok;
+	gint i;
+
+	g_string_append_printf(contents, "# teach plan, tolerance %d units: move_ms pan tilt zoom hold_ms\n", teach_tolerance_units);
+	for(i = 0 ; i < n ; i ++)
+		g_string_append_printf(contents, "%" G_GINT64_FORMAT " %d %d %d %" G_GINT64_FORMAT "\n", points[i].move_us / 1000,
+			points[i].pos.pan_val, points[i].pos.tilt_val, points[i].pos.zoom_val, points[i].hold_us / 1000);
+	ok = g_file_set_contents(path, contents->str, contents->len, error);
+
+	g_string_assign(contents, "# time_us pan tilt zoom\n");
+	for(i = 0 ; i < count && ok ; i ++)
+		g_string_append_printf(contents, "%" G_GINT64_FORMAT " %d %d %d\n", samples[i].time_us - samples[0].time_us, samples[i].pan_val, samples[i].tilt_val, samples[i].zoom_val);
+	ok = ok && g_file_set_contents(samples_path, contents->str, contents->len, error);
+	g_string_free(contents, TRUE);
+	return ok;
+}
+
+static gboolean record_teach_plan(gint seconds, const gchar *path, GError **error)
+{
+	GArray *recording = g_array_new(FALSE, FALSE, sizeof(STATUS_SAMPLE));
+	STATUS_SAMPLE batch[STATUS_HISTORY_LENGTH];
+	MOTION_TEACH_POINT *points;
+	TICK_TIMER timer;
+	gint64 end_us = g_get_monotonic_time() + (gint64)seconds * G_USEC_PER_SEC;
+	gint64 last_us = 0;
+	gint64 start_us;
+	gint holds = 0;
+	gboolean ok;
+	gint n;
+	gint i;
+
+	printf("teach: recording %d s at %d Hz, steer the camera now\n", seconds, status_sample_rate);
+	tick_timer_start(&timer, tick_period_us, FALSE);
+	while(g_get_monotonic_time() < end_us)
+	{
+		tick_timer_wait(&timer);
+		n = status_history_read(batch, STATUS_HISTORY_LENGTH);
+		for(i = 0 ; i < n ; i ++)
+		{
+			if(batch[i].time_us <= last_us)
+				continue;
+			g_array_append_val(recording, batch[i]);
+			last_us = batch[i].time_us;
+		}
+	}
+	if(recording->len < 2)
+	{
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "no status samples recorded");
+		g_array_free(recording, TRUE);
+		return FALSE;
+	}
+
+	start_us = g_get_monotonic_time();
+	points = g_new(MOTION_TEACH_POINT, recording->len);
+	n = motion_teach_compress((STATUS_SAMPLE *)recording->data, recording->len, teach_tolerance_units, (gint64)TEACH_MIN_HOLD_MS * 1000, points);
+	for(i = 0 ; i < n ; i ++)
+		holds += (points[i].hold_us > 0);
+	printf("teach: %u samples compressed to %d waypoints (%.1fx, %d holds) in %.2f ms\n", recording->len, n, recording->len / (gdouble)n, holds,
+		(g_get_monotonic_time() - start_us) / 1000.0);
+	if((ok = write_teach_plan(path, (STATUS_SAMPLE *)recording->data, recording->len, points, n, error)))
+		printf("teach: plan saved to %s, the samples to %s.samples\n", path, path);
+	g_free(points);
+	g_array_free(recording, TRUE);
+	return ok;
+}
+
+/*
+ * Speed that takes the continuous executor from <from> to <to> in
+ * <move_us>, at the per-axis rates of the dry run model
+ */
+static gfloat teach_segment_speed(const PTZ_POS *from, const PTZ_POS *to, gint64 move_us)
+{
+	gdouble rate[3] = { PAN_UNITS_PER_SECOND, TILT_UNITS_PER_SECOND, (zoom_fov_max_zoom - zoom_fov_min_zoom) / PREDICT_ZOOM_FULL_RANGE_SECONDS };
+	gdouble distance[3] = { ABS(motion_pan_delta(from->pan_val, to->pan_val)), ABS(fx_subx(to->tilt_val, from->tilt_val)), ABS(fx_subx(to->zoom_val, from->zoom_val)) };
+	fixed_t speed[3];
+	gdouble full_speed_s = 0;
+	gint axis;
+
+	motion_segment_speeds(from, to, 1.0f, &speed[0], &speed[1], &speed[2]);
+	for(axis = 0 ; axis < 3 ; axis ++)
+	{
+		if(speed[axis] != 0)
+			full_speed_s = MAX(full_speed_s, distance[axis] / (ABS(fx_xtof(speed[axis], FIXMATH_FRAC_BITS)) * rate[axis]));
+	}
+	if(move_us <= 0)
+		return cont_max_speed;
+	return CLAMP(full_speed_s * G_USEC_PER_SEC / move_us, TEACH_MIN_SPEED, scurve_mode ? SCURVE_MAX_PAN_TILT_SPEED : MAX_PAN_TILT_SPEED);
+}
+
+/*
+ * Build the teach profile from the plan. The camera stops at the ends and
+ * the holds and passes through the rest; the way back to the start is
+ * run at the max speed.
+ */
+static gboolean load_teach_plan(TOUR_PROFILE *profile, const gchar *path, GError **error)
+{
+	gchar *contents = NULL;
+	gchar **lines;
+	GArray *moves = g_array_new(FALSE, FALSE, sizeof(gint64));
+	GList *it;
+	gint count;
+	gint i;
+
+	if(!g_file_get_contents(path, &contents, NULL, error))
+	{
+		g_array_free(moves, TRUE);
+		return FALSE;
+	}
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL ; i ++)
+	{
+		gint64 move_ms;
+		gint pan, tilt, zoom, hold_ms;
+		PTZ_POS *pos;
+
+		if(lines[i][0] == '#' || sscanf(lines[i], "%" G_GINT64_FORMAT " %d %d %d %d", &move_ms, &pan, &tilt, &zoom, &hold_ms) != 5)
+			continue;
+		pos = g_new(PTZ_POS, 1);
+		pos->pan_val = pan;
+		pos->tilt_val = tilt;
+		pos->zoom_val = zoom;
+		pos->pass_through = (hold_ms <= 0);
+		profile->path = g_list_prepend(profile->path, pos);
+		move_ms = MAX(move_ms, 0);
+		g_array_append_val(moves, move_ms);
+		move_ms = MAX(hold_ms, 0);
+		g_array_append_val(moves, move_ms);
+	}
+	profile->path = g_list_reverse(profile->path);
+	g_strfreev(lines);
+	g_free(contents);
+
+	if((count = g_list_length(profile->path)) < 2)
+	{
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s has fewer than two waypoints", path);
+		g_array_free(moves, TRUE);
+		return FALSE;
+	}
+	((PTZ_POS*)g_list_first(profile->path)->data)->pass_through = FALSE;
+	((PTZ_POS*)g_list_last(profile->path)->data)->pass_through = FALSE;
+	profile->teach_speeds = g_new(gfloat, count);
+	profile->teach_holds = g_new(gint, count);
+	for(it = profile->path, i = 0 ; it != NULL ; it = g_list_next(it), i ++)
+	{
+		const PTZ_POS *from = (PTZ_POS*)(i > 0 ? g_list_previous(it) : g_list_last(profile->path))->data;
+
+		profile->teach_speeds[i] = (i > 0) ? teach_segment_speed(from, (PTZ_POS*)it->data, g_array_index(moves, gint64, 2 * i) * 1000) : cont_max_speed;
+		profile->teach_holds[i] = (gint)g_array_index(moves, gint64, 2 * i + 1);
+	}
+	g_array_free(moves, TRUE);
+	return TRUE;
+}
+
+/*
+ * Add the teach profile when TeachEnabled and its plan reads, unless a
+ * preset prefix took the name
+ */
+static void add_teach_profile(void)
+{
+	GError *local_error = NULL;
+	TOUR_PROFILE *profile;
+
+	if(find_tour_profile(TEACH_PROFILE_NAME) >= 0 || !(profile = get_tour_profile(TEACH_PROFILE_NAME)))
+	{
+		LOGINFO("No room for the %s profile, taught path disabled", TEACH_PROFILE_NAME);
+		return;
+	}
+	profile->teach = TRUE;
+	if(!load_teach_plan(profile, teach_plan_file, &local_error))
+	{
+		LOGINFO("CAN NOT LOAD THE TEACH PLAN: %s", local_error->message);
+		g_clear_error(&local_error);
+		g_list_free_full(profile->path, g_free);
+		profile->path = NULL;
+		tour_profile_count --;
+		return;
+	}
+	LOGINFO("Taught path from %s, %d waypoints", teach_plan_file, g_list_length(profile->path));
+}
+
+/*
+ * Calibrate a profile the way its kind needs; a taught path is absolute
+ */
+static gboolean calibrate_tour_profile(TOUR_PROFILE *profile)
+{
+	if(profile->teach)
+		return TRUE;
+	return profile->scan ? calibrate_scan_profile(profile) : calibrate_profile(profile);
+}
+
+/*
+ * Save the calibrated presets for --dry-run, in the simulator's preset file
+ * format ("index name pan tilt zoom" per line) after a line with the pan
+ * and zoom limits. Presets without a tour name (scan corners) get a plain
+ * "preset<index>" name.
+ */
+static void write_preset_file(const gchar *path)
+{
+	GError *local_error = NULL;
+	GList *names = ax_ptz_preset_handler_query_presets(ax_ptz_control_queue_group, VIDEO_CHANNEL, FALSE, &local_error);
+	GString *contents = g_string_new(NULL);
+	GList *it;
+	gint i;
+
+	g_clear_error(&local_error);
+	g_string_append_printf(contents, "# limits %d %d %d %d\n", pan_limit_min, pan_limit_max, zoom_fov_min_zoom, zoom_fov_max_zoom);
+	for(i = 0 ; i < calibrated_count ; i ++)
+	{
+		const gchar *name = NULL;
+
+		for(it = names ; it != NULL && name == NULL ; it = g_list_next(it))
+		{
+			gchar profile_name[TOUR_PROFILE_NAME_LENGTH];
+			gint index;
+			gint number;
+			gint delay;
+
+			if(parse_preset_name((gchar*)it->data, profile_name, &index, &number, &delay) && index == calibrated_indices[i])
+				name = (gchar*)it->data;
+		}
+		if(name != NULL)
+			g_string_append_printf(contents, "%d %s %d %d %d\n", calibrated_indices[i], name, calibrated_positions[i].pan_val, calibrated_positions[i].tilt_val, calibrated_positions[i].zoom_val);
+		else
+			g_string_append_printf(contents, "%d preset%d %d %d %d\n", calibrated_indices[i], calibrated_indices[i], calibrated_positions[i].pan_val, calibrated_positions[i].tilt_val, calibrated_positions[i].zoom_val);
+	}
+	if(!g_file_set_contents(path, contents->str, contents->len, &local_error))
+	{
+		LOGINFO("CAN NOT SAVE THE PRESETS: %s", local_error->message);
+		g_clear_error(&local_error);
+	}
+	else
+	{
+		LOGINFO("Presets saved to %s", path);
+	}
+	g_string_free(contents, TRUE);
+	g_list_free_full(names, g_free);
+}
+
+/*
+ * Read a preset file into the preset names and the calibrated positions,
+ * and take the limits from it (the camera's defaults when it has none)
+ */
+static gboolean load_preset_file(const gchar *path, GList **names, GError **error)
+{
+	gchar *contents = NULL;
+	gchar **lines;
+	gint limits[4] = { -32768, 32768, PREDICT_DEFAULT_ZOOM_MIN, PREDICT_DEFAULT_ZOOM_MAX };
+	gint i;
+
+	if(!g_file_get_contents(path, &contents, NULL, error))
+		return FALSE;
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL ; i ++)
+	{
+		gint index;
+		gchar name[64];
+		gdouble pan, tilt, zoom;
+
+		if(sscanf(lines[i], "# limits %d %d %d %d", &limits[0], &limits[1], &limits[2], &limits[3]) == 4 || lines[i][0] == '#')
+			continue;
+		if(sscanf(lines[i], "%d %63s %lf %lf %lf", &index, name, &pan, &tilt, &zoom) != 5)
+			continue;
+		*names = g_list_prepend(*names, g_strdup(name));
+		if(calibrated_count < (gint)G_N_ELEMENTS(calibrated_indices))
+		{
+			calibrated_indices[calibrated_count] = index;
+			calibrated_positions[calibrated_count].pan_val = (fixed_t)pan;
+			calibrated_positions[calibrated_count].tilt_val = (fixed_t)tilt;
+			calibrated_positions[calibrated_count].zoom_val = (fixed_t)zoom;
+			calibrated_positions[calibrated_count].pass_through = FALSE;
+			calibrated_count ++;
+		}
+	}
+	*names = g_list_reverse(*names);
+	g_strfreev(lines);
+	g_free(contents);
+
+	pan_limit_min = limits[0];
+	pan_limit_max = limits[1];
+	motion_set_pan_wrap(endless_pan, pan_limit_min, pan_limit_max);
+	build_zoom_fov_table(limits[2], limits[3]);
+	return TRUE;
+}
+
+/*
+ * Take the presets saved by the last run as settle hints for the
+ * calibration; without the file, or with presets moved since, the settle
+ * polls only lose their timing
+ */
+static void load_settle_hints(const gchar *path)
+{
+	gchar *contents = NULL;
+	gchar **lines;
+	gint i;
+
+	if(!g_file_get_contents(path, &contents, NULL, NULL))
+		return;
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL && settle_hint_count < (gint)G_N_ELEMENTS(settle_hint_indices) ; i ++)
+	{
+		gint index;
+		gchar name[64];
+		gdouble pan, tilt, zoom;
+
+		if(lines[i][0] == '#' || sscanf(lines[i], "%d %63s %lf %lf %lf", &index, name, &pan, &tilt, &zoom) != 5)
+			continue;
+		settle_hint_indices[settle_hint_count] = index;
+		settle_hint_positions[settle_hint_count].pan_val = (fixed_t)pan;
+		settle_hint_positions[settle_hint_count].tilt_val = (fixed_t)tilt;
+		settle_hint_positions[settle_hint_count].zoom_val = (fixed_t)zoom;
+		settle_hint_positions[settle_hint_count].pass_through = FALSE;
+		settle_hint_count ++;
+	}
+	g_strfreev(lines);
+	g_free(contents);
+	LOGINFO("%d settle hints from %s", settle_hint_count, path);
+}
+
+/*
+ * TourProfile parameter callback, runs in the main loop. The tour thread
+ * picks the request up at the next segment boundary.
+ */
+static void tour_profile_changed(const gchar *name, const gchar *value, gpointer data)
+{
+	gint index = find_tour_profile(value);
+
+	if(index < 0)
+	{
+		LOGINFO("Unknown tour profile %s, keeping %s", value, tour_profiles[g_atomic_int_get(&requested_profile)].name);
+		return;
+	}
+	LOGINFO("Tour profile %s requested", value);
+	g_atomic_int_set(&requested_profile, index);
+}
+
+/*
+ * Make <index> the active profile and return the preset of its path
+ * closest to the camera to continue from
+ */
+static GList *switch_tour_profile(gint index)
+{
+	STATUS_SAMPLE sample;
+	GList *it;
+	GList *nearest;
+	fixed_t best = G_MAXINT32;
+
+	active_profile = index;
+	budget_prepare(index);
+	realPath = tour_profiles[index].path;
+	nearest = g_list_first(realPath);
+	if(status_slot_read(&sample))
+	{
+		PTZ_POS here = { sample.pan_val, sample.tilt_val, sample.zoom_val, FALSE };
+
+		for(it = g_list_first(realPath) ; it != NULL ; it = g_list_next(it))
+		{
+			fixed_t distance;
+
+			if(((PTZ_POS*)(it->data))->pass_through)
+				continue;
+			distance = motion_travel(&here, (PTZ_POS*)(it->data));
+			if(distance < best)
+			{
+				best = distance;
+				nearest = it;
+			}
+		}
+	}
+	LOGINFO("Switched to tour profile %s at No%d position", tour_profiles[index].name, g_list_position(realPath, nearest) + 1);
+	return nearest;
+}
+
+/*
+ * Recovery from axptz errors. A failed call in the tour loop is transient
+ * unless the error is one of our own (G_FILE_ERROR): the loop backs off for
+ * a jittered, doubling time and runs the segment again from where the
+ * camera is. The SDK header documents no error domain or codes, so axptz
+ * errors are not told apart; the simulator's missing preset is the one
+ * exception. From the ErrorReinitAfter-th error in a row the axptz library is
+ * destroyed and created again first; the calibrated tour is kept. After
+ * ErrorRetries errors in a row the error is fatal and the tour stops.
+ */
+static gboolean ptz_error_is_transient(const GError *error)
+{
+	if(error == NULL)
+		return TRUE;
+	if(error->domain == G_FILE_ERROR)
+		return FALSE;
+#ifdef PANORAMATV_SIM
+	if(error->domain == g_quark_from_static_string(SIM_ERROR_DOMAIN) && error->code == SIM_ERROR_NO_PRESET)
+		return FALSE;
+#endif
+	return TRUE;
+}
+
+/*
+ * Destroy and create the axptz library with the sampler stopped and the
+ * preset interrupt locked out
+ */
+static gboolean reinit_ptz(GError **error)
+{
+	gboolean ok;
+
+	LOGINFO("Creating the axptz library again");
+	stop_status_sampler();
+	g_mutex_lock(&ptz_command_lock);
+	if(!ax_ptz_destroy(error))
+	{
+		LOGINFO("AXPTZ DESTROY: %s", (*error)->message);
+		g_clear_error(error);
+	}
+	ok = ax_ptz_create(error) && (ax_ptz_control_queue_group = ax_ptz_control_queue_get_app_group_instance(error)) != NULL;
+	g_mutex_unlock(&ptz_command_lock);
+	ptz_reinit_count ++;
+	/* the history still holds the last sample, so this does not wait */
+	return start_status_sampler() && ok;
+}
+
+/*
+ * Called with the <error> of a failed call in the tour loop (NULL when the
+ * call gave none). TRUE after the backoff, when the segment is to be run
+ * again; FALSE with <error> set when the error is fatal.
+ */
+static gboolean recover_from_error(gint segment, GError **error)
+{
+	gint64 backoff_ms;
+
+	if(ptz_error_streak == 0)
+		ptz_outage_start_us = g_get_monotonic_time();
+	ptz_error_count ++;
+	ptz_error_streak ++;
+	if(!ptz_error_is_transient(*error) || ptz_error_streak > error_retries)
+	{
+		if(*error != NULL && !ptz_error_is_transient(*error))
+			LOGINFO("AXPTZ ERROR at No%d position is not transient: %s", segment, (*error)->message);
+		if(*error == NULL)
+			g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%d axptz errors in a row", ptz_error_streak);
+		return FALSE;
+	}
+	LOGINFO("AXPTZ ERROR %d in a row at No%d position: %s", ptz_error_streak, segment, *error ? (*error)->message : "no details");
+	g_clear_error(error);
+
+	/* half jitter, so cameras failing together do not retry together */
+	backoff_ms = MIN((gint64)ERROR_BACKOFF_MIN_MS << MIN(ptz_error_streak - 1, 16), ERROR_BACKOFF_MAX_MS);
+	backoff_ms = (gint64)(backoff_ms * g_random_double_range(0.5, 1.0));
+	publish_status(STATUS_STATE_RECOVERING, segment, NULL, NULL);
+	dwell((gint)backoff_ms);
+
+	if(error_reinit_after > 0 && ptz_error_streak >= error_reinit_after && !reinit_ptz(error))
+	{
+		/* the next call fails and counts as the next error */
+		LOGINFO("AXPTZ REINIT FAILED: %s", *error ? (*error)->message : "no status sample");
+		g_clear_error(error);
+	}
+	return TRUE;
+}
+
+/*
+ * A segment arrived, the outage, if any, is over
+ */
+static void recover_done(gint segment)
+{
+	gint64 outage_us;
+
+	if(ptz_error_streak == 0)
+		return;
+	outage_us = g_get_monotonic_time() - ptz_outage_start_us;
+	ptz_outage_max_us = MAX(ptz_outage_max_us, outage_us);
+	LOGINFO("Recovered at No%d position after %d errors in %.1f s", segment, ptz_error_streak, outage_us / (gdouble)G_USEC_PER_SEC);
+	ptz_error_streak = 0;
+}
+
+/*
+ * The tour control loop. Runs on its own thread so that it can be given
+ * real-time priority while logging and metrics stay at normal priority.
+ */
+static gpointer tour_thread_func(gpointer data)
+{
+	GError *local_error = NULL;
+	GList *it = NULL;
+
+	if(rt_mode)
+	{
+		if(apply_realtime_settings(rt_priority, rt_cpu))
+			LOGINFO("Control thread running SCHED_FIFO priority %d cpu %d", rt_priority, rt_cpu);
+	}
+
+	LOGINFO("Endless tour along the presets BEGIN");
+
+	while(g_atomic_int_get(&tour_running))
+	{
+		gint count = 0;
+		gint64 lap_start_us = g_get_monotonic_time();
+	
+		budget_start_lap(g_list_first(realPath));
+		LOGINFO("number of paths: %d", g_list_length(realPath));	
+		sync_start_lap(g_list_first(realPath));
+	
+		for(it = g_list_first(realPath) ; it != NULL && g_atomic_int_get(&tour_running) ; )
+		{	
+			RESUME_PLAN plan;
+			gboolean resumed = FALSE;
+			gboolean dwelled = TRUE;
+			gint64 regained_us = 0;
+			WAIT_RESULT result;
+
+			if(g_atomic_int_get(&requested_profile) != active_profile)
+			{
+				//switch at the segment boundary, the new lap starts here
+				it = switch_tour_profile(g_atomic_int_get(&requested_profile));
+				lap_start_us = g_get_monotonic_time();
+				budget_start_lap(it);
+				sync_start_lap(it);
+			}
+
+			if(g_atomic_int_get(&interrupt_active))
+			{
+				//hold the interrupt preset, then run this segment again from there
+				hold_preset_interrupt(g_list_position(realPath, it) + 1);
+				continue;
+			}
+	
+			/*NECESSARY PART*/
+			/* Request for dropping the PTZ control */
+			if (!(ax_ptz_control_queue_request(ax_ptz_control_queue_group, VIDEO_CHANNEL, AX_PTZ_CONTROL_QUEUE_DROP, &queue_pos, &time_to_pos_one, &poll_time, &local_error))) 
+			{
+				if(!recover_from_error(g_list_position(realPath, it) + 1, &local_error))
+					goto failure;
+				continue;
+			}
+
+			trace_write(TRACE_QUEUE, AX_PTZ_CONTROL_QUEUE_DROP, queue_pos, time_to_pos_one, poll_time, 0, 0, 0);
+			LOGINFO("Request AX_PTZ_CONTROL_QUEUE_DROP:\n");
+			LOGINFO("queue_pos = %d\n", queue_pos);
+			LOGINFO("time_to_pos_one = %d\n", time_to_pos_one);
+			LOGINFO("poll_time = %d\n", poll_time);
+
+			/* Get the PTZ control queue status for the application */
+			if (!(ax_ptz_control_queue_request(ax_ptz_control_queue_group, VIDEO_CHANNEL, AX_PTZ_CONTROL_QUEUE_GET, &queue_pos, &time_to_pos_one, &poll_time, &local_error))) 
+			{	
+				if(!recover_from_error(g_list_position(realPath, it) + 1, &local_error))
+					goto failure;
+				continue;
+			}
+
+			trace_write(TRACE_QUEUE, AX_PTZ_CONTROL_QUEUE_GET, queue_pos, time_to_pos_one, poll_time, 0, 0, 0);
+			LOGINFO("Request AX_PTZ_CONTROL_QUEUE_GET:\n");
+			LOGINFO("queue_pos = %d\n", queue_pos);
+			LOGINFO("time_to_pos_one = %d\n", time_to_pos_one);
+			LOGINFO("poll_time = %d\n", poll_time);	
+	
+			/* Get the application group from the PTZ control queue */
+			if (!(ax_ptz_control_queue_group = ax_ptz_control_queue_get_app_group_instance(&local_error))) 
+			{	
+				if(!recover_from_error(g_list_position(realPath, it) + 1, &local_error))
+					goto failure;
+				continue;
+			}
+			/*NECESSARY PART*/
+
+			if(queue_pos != 1)
+			{
+				if(!pause_until_control(it, &plan, &local_error))
+				{
+					if(!recover_from_error(g_list_position(realPath, it) + 1, &local_error))
+						goto failure;
+					continue;
+				}
+				if(!g_atomic_int_get(&tour_running))
+					break;
+				regained_us = g_get_monotonic_time();
+				resumed = plan.ready;
+				it = plan.waypoint;
+			}
+	
+			count = g_list_position(realPath, it) + 1;
+			trace_set_segment(count);
+			LOGINFO("Go to Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , count , ((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(it->data))->tilt_val , ((PTZ_POS*)(it->data))->zoom_val);
+			PTZ_POS posFrom;
+			STATUS_SAMPLE sample;
+			fixed_t pan_speed1;
+			fixed_t tilt_speed1;
+			fixed_t zoom_speed1;
+			gfloat segment_max_speed;
+			if (!status_slot_read(&sample)) 
+			{
+				LOGINFO("NO PTZ STATUS SAMPLE");
+				if(!recover_from_error(count, &local_error))
+					goto failure;
+				continue;
+			}
+	
+			if(resumed)
+			{
+				/* planned while paused, no need to wait for it now; the trace gets the sample it was planned from, for the replay */
+				sample = plan.sample;
+				posFrom = plan.from;
+				pan_speed1 = plan.pan_speed;
+				tilt_speed1 = plan.tilt_speed;
+				zoom_speed1 = plan.zoom_speed;
+				segment_max_speed = profile_max_speed(&tour_profiles[active_profile], count);
+			}
+			else
+			{
+				posFrom.pan_val = sample.pan_val;
+				posFrom.tilt_val = sample.tilt_val;
+				posFrom.zoom_val = sample.zoom_val;
+				posFrom.pass_through = FALSE;
+				segment_max_speed = sync_max_speed(count, profile_max_speed(&tour_profiles[active_profile], count));
+				motion_segment_speeds(&posFrom , (PTZ_POS*)(it->data) , segment_max_speed , &pan_speed1 , &tilt_speed1 , &zoom_speed1);
+			}
+			LOGINFO("Position From PAN:%d , TILT:%d , ZOOM:%d" , posFrom.pan_val , posFrom.tilt_val , posFrom.zoom_val);
+	
+			LOGINFO("arrival_accuracy : %d" , arrival_accuracy);
+	
+			LOGINFO("Setting speeds BEGIN");
+			trace_status(&sample);
+			publish_status(STATUS_STATE_TOURING, count, &posFrom, (PTZ_POS*)(it->data));
+			trace_max_speed(segment_max_speed);
+			trace_write(TRACE_SEGMENT, ((PTZ_POS*)(it->data))->pass_through, ((PTZ_POS*)(it->data))->pan_val, ((PTZ_POS*)(it->data))->tilt_val, ((PTZ_POS*)(it->data))->zoom_val, pan_speed1, tilt_speed1, zoom_speed1);
+	
+			LOGINFO("PAN SPEED: %f , TILT_SPEED: %f , ZOOM_SPEED: %f" , fx_xtof(pan_speed1, FIXMATH_FRAC_BITS) , fx_xtof(tilt_speed1, FIXMATH_FRAC_BITS) , fx_xtof(zoom_speed1, FIXMATH_FRAC_BITS));
+			LOGINFO("PAN SPEED: %d , TILT_SPEED: %d , ZOOM_SPEED: %d" , pan_speed1, tilt_speed1, zoom_speed1);
+			LOGINFO("MAX SPEED: %f", segment_max_speed);
+			LOGINFO("MAX SPEED %d", fx_ftox(segment_max_speed, FIXMATH_FRAC_BITS));
+	
+			LOGINFO("Setting speeds END");
+	
+			LOGINFO("Move to No%d position started" , count);
+			if(resumed)
+			{
+				gint64 latency_us = g_get_monotonic_time() - regained_us;
+
+				resume_count ++;
+				resume_latency_sum_us += latency_us;
+				resume_latency_max_us = MAX(resume_latency_max_us, latency_us);
+				LOGINFO("Resumed at No%d position, %" G_GINT64_FORMAT " us after regaining control" , count , latency_us);
+			}
+			result = execute_segment(&posFrom , (PTZ_POS*)(it->data) , pan_speed1 , tilt_speed1 , zoom_speed1 , segment_max_speed , &local_error);
+			if(result == WAIT_ERROR)
+			{
+				if(!recover_from_error(count, &local_error))
+					goto failure;
+				continue;
+			}
+			if(result == WAIT_PREEMPTED)
+			{
+				LOGINFO("Move to No%d position preempted" , count);
+				continue;//the next queue request pauses the tour
+			}
+			if(result == WAIT_INTERRUPTED)
+			{
+				LOGINFO("Move to No%d position interrupted" , count);
+				continue;
+			}
+			LOGINFO("Move to No%d position Ended" , count);
+			recover_done(count);
+	
+			LOGINFO("STOPPING IN PRESET BEGIN");
+			gint stop;
+			gint delay_ms = waypoint_delay(&tour_profiles[active_profile], count, &stop);
+			if(stop >= 0 || delay_ms > 0)
+				dwelled = dwell_at_preset(sync_dwell_ms(count, budget_dwell_ms(count, delay_ms)), stop, (PTZ_POS*)(it->data));//stop in preset for stop_in_preset sec
+			if(!dwelled)
+			{
+				LOGINFO("Stop in No%d position interrupted" , count);
+				continue;//back to this preset for a full stop after the hold
+			}
+			LOGINFO("STOPPING IN PRESET ENDED");
+			it = g_list_next(it);
+		}
+
+		if(it == NULL)
+		{
+			gint64 lap_us = g_get_monotonic_time() - lap_start_us;
+
+			lap_count ++;
+			lap_time_sum_us += lap_us;
+			lap_time_max_us = MAX(lap_time_max_us, lap_us);
+			lap_time_last_us = lap_us;
+			budget_end_lap(lap_us);
+			publish_status(STATUS_STATE_TOURING, count, NULL, NULL);
+			LOGINFO("Lap of %d waypoints took %.1f s", count, lap_us / (gdouble)G_USEC_PER_SEC);
+			if(tour_profiles[active_profile].scan)
+			{
+				scan_cycle_count ++;
+				scan_cycle_sum_us += lap_us;
+				scan_cycle_last_us = lap_us;
+				scan_area_sum += tour_profiles[active_profile].scan_area;
+				LOGINFO("Scan cycle %.1f s, %.1f square degrees/s", lap_us / (gdouble)G_USEC_PER_SEC, tour_profiles[active_profile].scan_area * G_USEC_PER_SEC / lap_us);
+			}
+			if(tour_lap_limit > 0 && lap_count >= tour_lap_limit)
+				g_atomic_int_set(&tour_running, FALSE);
+		}
+	}
+
+	LOGINFO("Endless tour along the presets END");
+	publish_status(STATUS_STATE_STOPPED, 0, NULL, NULL);
+	g_idle_add(quit_main_loop, NULL);
+	return GINT_TO_POINTER(TRUE);
+
+/* We will end up here if something went wrong */
+failure:
+
+	if (local_error) 
+	{
+		LOGINFO("ERROR: tour stopped: %s", local_error->message);
+		g_error_free(local_error);
+		local_error = NULL;
+	}
+	g_idle_add(quit_main_loop, NULL);
+	return GINT_TO_POINTER(FALSE);
+}
+
+#ifdef PANORAMATV_SIM
+/*
+ * Soak benchmark for the simulator build. Runs the normal calibration and
+ * tour against the simulated axptz with short ticks and a faster model clock,
+ * and checks that the resident set and the malloc heap stay flat once the
+ * tour is warmed up.
+ */
+static gint soak_ticks = 0;
+static gint64 soak_base_rss_kb = -1;
+static gint64 soak_base_heap_kb = -1;
+static gint64 soak_last_rss_kb = 0;
+static gint64 soak_last_heap_kb = 0;
+
+static gint64 read_rss_kb(void)
+{
+	glong size = 0;
+	glong resident = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+
+	if(statm == NULL)
+		return 0;
+	if(fscanf(statm, "%ld %ld", &size, &resident) != 2)
+		resident = 0;
+	fclose(statm);
+	return (gint64)resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static gint64 read_heap_kb(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+	return (gint64)info.uordblks / 1024;
+#else
+	struct mallinfo info = mallinfo();
+	return (gint64)info.uordblks / 1024;
+#endif
+}
+
+static gboolean soak_check(gpointer data)
+{
+	gint ticks = g_atomic_int_get(&tick_count);
+
+	soak_last_rss_kb = read_rss_kb();
+	soak_last_heap_kb = read_heap_kb();
+	if(soak_base_rss_kb < 0 && ticks >= soak_ticks / 10)
+	{
+		soak_base_rss_kb = soak_last_rss_kb;
+		soak_base_heap_kb = soak_last_heap_kb;
+	}
+	printf("soak ticks:%d rss:%" G_GINT64_FORMAT "kB heap:%" G_GINT64_FORMAT "kB\n", ticks, soak_last_rss_kb, soak_last_heap_kb);
+	if(ticks >= soak_ticks)
+	{
+		g_atomic_int_set(&tour_running, FALSE);
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Compare the last measurement with the warmed-up baseline
+ */
+static gboolean soak_passed(void)
+{
+	gint64 rss_growth = soak_last_rss_kb - soak_base_rss_kb;
+	gint64 heap_growth = soak_last_heap_kb - soak_base_heap_kb;
+
+	if(soak_base_rss_kb < 0)
+	{
+		printf("soak FAILED: tour ended before the warm-up\n");
+		return FALSE;
+	}
+#ifdef __SANITIZE_ADDRESS__
+	printf("soak: AddressSanitizer build, rss/heap growth %" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "kB not checked, see the leak report at exit\n", rss_growth, heap_growth);
+	return TRUE;
+#else
+	printf("soak ticks:%d rss growth:%" G_GINT64_FORMAT "kB heap growth:%" G_GINT64_FORMAT "kB limit:%dkB\n",
+		g_atomic_int_get(&tick_count), rss_growth, heap_growth, SOAK_MAX_GROWTH_KB);
+	if(rss_growth > SOAK_MAX_GROWTH_KB || heap_growth > SOAK_MAX_GROWTH_KB)
+	{
+		printf("soak FAILED\n");
+		return FALSE;
+	}
+	printf("soak PASSED\n");
+	return TRUE;
+#endif
+}
+#endif
+
+/*
+ * Run the tour thread with the main loop (metrics) until it ends
+ */
+static gboolean run_tour(void)
+{
+	gboolean tour_ok;
+
+	main_loop = g_main_loop_new(NULL, FALSE);
+	guint metrics_source = g_timeout_add_seconds(METRICS_INTERVAL_SECONDS, report_metrics, NULL);
+#ifdef PANORAMATV_SIM
+	if(soak_ticks > 0)
+		g_timeout_add_seconds(1, soak_check, NULL);
+#endif
+	g_atomic_int_set(&tour_running, TRUE);
+	GThread *tour_thread = g_thread_new("tour", tour_thread_func, NULL);
+
+	g_main_loop_run(main_loop);
+
+	tour_ok = GPOINTER_TO_INT(g_thread_join(tour_thread));
+	g_source_remove(metrics_source);
+	g_main_loop_unref(main_loop);
+	main_loop = NULL;
+	return tour_ok;
+}
+
+#ifdef PANORAMATV_SIM
+/*
+ * Lap benchmark for the simulator build. Runs the same number of laps in
+ * each segment mode against a faster model clock and prints lap time (in
+ * camera seconds) and preset arrival error.
+ */
+static gint lap_bench_laps = 0;
+
+static gboolean run_lap_bench(void)
+{
+	gint mode;
+	gint i;
+
+	for(mode = SEGMENT_CONTINUOUS ; mode <= SEGMENT_HYBRID ; mode ++)
+	{
+		segment_mode = mode;
+		memset(arrival_error, 0, sizeof(arrival_error));
+		memset(&corrected_error, 0, sizeof(corrected_error));
+		correction_moves = 0;
+		correction_budget_hits = 0;
+		stall_count = 0;
+		stall_skips = 0;
+		pause_count = 0;
+		pause_polls = 0;
+		pause_total_us = 0;
+		resume_count = 0;
+		resume_latency_sum_us = 0;
+		resume_latency_max_us = 0;
+		interrupt_count = 0;
+		interrupt_command_latency_sum_us = 0;
+		interrupt_command_latency_max_us = 0;
+		interrupt_motion_count = 0;
+		interrupt_motion_latency_sum_us = 0;
+		interrupt_motion_latency_max_us = 0;
+		interrupt_hold_total_us = 0;
+		scan_cycle_count = 0;
+		scan_cycle_sum_us = 0;
+		scan_area_sum = 0;
+		drift_checks = 0;
+		drift_corrections = 0;
+		drift_timeouts = 0;
+		drift_error_max = 0;
+		sync_laps = 0;
+		sync_error_sum_ms = 0;
+		sync_error_max_ms = 0;
+		sync_speedups = 0;
+		sync_short_dwells = 0;
+		budget_laps = 0;
+		budget_misses = 0;
+		budget_replans = 0;
+		budget_error_sum_ms = 0;
+		budget_error_max_ms = 0;
+		ptz_error_count = 0;
+		ptz_reinit_count = 0;
+		ptz_outage_max_us = 0;
+		preset_arrivals = 0;
+		lap_count = 0;
+		lap_time_sum_us = 0;
+		lap_time_max_us = 0;
+		tour_lap_limit = lap_bench_laps;
+		if(!run_tour())
+			return FALSE;
+
+		printf("%-10s laps:%d lap mean:%.1fs max:%.1fs\n", segment_mode_names[mode], lap_count,
+			lap_time_sum_us * LAP_BENCH_TIMESCALE / (gdouble)MAX(lap_count, 1) / G_USEC_PER_SEC,
+			lap_time_max_us * LAP_BENCH_TIMESCALE / (gdouble)G_USEC_PER_SEC);
+		for(i = 0 ; i < EXEC_KINDS ; i ++)
+		{
+			if(arrival_error[i].count > 0)
+				printf("%-10s   %-10s presets:%d error mean:%.0f max:%d units\n", "", exec_kind_names[i], arrival_error[i].count,
+					accuracy_stat_mean(&arrival_error[i]), arrival_error[i].max);
+		}
+		if(corrected_error.count > 0)
+			printf("%-10s   %-10s presets:%d moves:%d error mean:%.0f max:%d units\n", "", "corrected", corrected_error.count, correction_moves,
+				accuracy_stat_mean(&corrected_error), corrected_error.max);
+		if(stall_count > 0)
+			printf("%-10s   stalls:%d skipped:%d\n", "", stall_count, stall_skips);
+		if(pause_count > 0)
+			printf("%-10s   pauses:%d polls:%d resume latency mean:%" G_GINT64_FORMAT "us max:%" G_GINT64_FORMAT "us\n", "", pause_count, pause_polls,
+				resume_latency_sum_us / MAX(resume_count, 1), resume_latency_max_us);
+		if(scan_cycle_count > 0)
+			printf("%-10s   scan cycles:%d mean:%.1fs coverage:%.1f deg2/s\n", "", scan_cycle_count,
+				scan_cycle_sum_us * LAP_BENCH_TIMESCALE / (gdouble)scan_cycle_count / G_USEC_PER_SEC,
+				scan_area_sum * G_USEC_PER_SEC / (scan_cycle_sum_us * LAP_BENCH_TIMESCALE));
+		if(drift_checks > 0 || drift_timeouts > 0)
+			printf("%-10s   drift checks:%d corrections:%d not settled:%d max drift:%d units\n", "", drift_checks, drift_corrections, drift_timeouts, drift_error_max);
+		if(sync_laps > 0)
+			printf("%-10s   synchronized laps:%d phase error mean:%" G_GINT64_FORMAT "ms max:%" G_GINT64_FORMAT "ms sped up:%d short dwells:%d\n", "", sync_laps,
+				sync_error_sum_ms / sync_laps, sync_error_max_ms, sync_speedups, sync_short_dwells);
+		if(ptz_error_count > 0)
+			printf("%-10s   axptz errors:%d restarts:%d longest outage:%.1fs\n", "", ptz_error_count, ptz_reinit_count,
+				ptz_outage_max_us * LAP_BENCH_TIMESCALE / (gdouble)G_USEC_PER_SEC);
+		if(budget_laps > 0)
+			printf("%-10s   budget laps:%d off target:%d error mean:%" G_GINT64_FORMAT "ms max:%" G_GINT64_FORMAT "ms plans:%d\n", "", budget_laps, budget_misses,
+				budget_error_sum_ms / budget_laps, budget_error_max_ms, budget_replans);
+		if(interrupt_count > 0)
+			printf("%-10s   interrupts:%d trigger to command mean:%" G_GINT64_FORMAT "us max:%" G_GINT64_FORMAT "us to motion mean:%" G_GINT64_FORMAT "us max:%" G_GINT64_FORMAT "us\n", "", interrupt_count,
+				interrupt_command_latency_sum_us / interrupt_count, interrupt_command_latency_max_us,
+				interrupt_motion_latency_sum_us / MAX(interrupt_motion_count, 1), interrupt_motion_latency_max_us);
+	}
+	return TRUE;
+}
+#endif
+
+/*
+ * Dry run. The tour is planned from a preset file with the same profile,
+ * path and execution choices as on the camera, then each segment is timed
+ * with a kinematic model instead of being driven: the command latency and
+ * the slowest axis of a trapezoidal speed profile, with the per-axis rate
+ * at full speed and the PredictPanAccel/TiltAccel/ZoomAccel limits.
+ * Continuous segments keep their speed through pass-through waypoints;
+ * the wait loop sees a stop on the tick after the arrival.
+ */
+static gdouble predict_segment(const PTZ_POS *from, const PTZ_POS *target, EXEC_KIND kind, gfloat max_speed, gdouble speed[3])
+{
+	gdouble rate[3] = { PAN_UNITS_PER_SECOND, TILT_UNITS_PER_SECOND, (zoom_fov_max_zoom - zoom_fov_min_zoom) / PREDICT_ZOOM_FULL_RANGE_SECONDS };
+	gdouble distance[3] = { ABS(motion_pan_delta(from->pan_val, target->pan_val)), ABS(fx_subx(target->tilt_val, from->tilt_val)), ABS(fx_subx(target->zoom_val, from->zoom_val)) };
+	gdouble seconds = 0;
+	gint axis;
+
+	if(kind == EXEC_ABSOLUTE)
+	{
+		/* zoom at the camera's own speed, AX_PTZ_MOVEMENT_NO_VALUE */
+		speed[0] = max_speed;
+		speed[1] = max_speed;
+		speed[2] = 1.0;
+	}
+	else
+	{
+		fixed_t pan_speed;
+		fixed_t tilt_speed;
+		fixed_t zoom_speed;
+		gdouble scale;
+
+		motion_segment_speeds(from, target, max_speed, &pan_speed, &tilt_speed, &zoom_speed);
+		scale = screen_speed_mode ? screen_speed_scale(pan_speed, tilt_speed, from->zoom_val) : 1.0;
+		speed[0] = fabs(fx_xtof(pan_speed, FIXMATH_FRAC_BITS)) * scale;
+		speed[1] = fabs(fx_xtof(tilt_speed, FIXMATH_FRAC_BITS)) * scale;
+		speed[2] = fabs(fx_xtof(zoom_speed, FIXMATH_FRAC_BITS));
+	}
+	for(axis = 0 ; axis < 3 ; axis ++)
+	{
+		gdouble axis_speed = speed[axis] * rate[axis];
+		gdouble carried = (kind == EXEC_ABSOLUTE) ? 0 : axis_speed;
+		gdouble accel = predict_accel[axis];
+
+		if(scurve_mode && axis < 2 && kind != EXEC_ABSOLUTE)
+			accel = MIN(accel, scurve_accel);
+		seconds = MAX(seconds, motion_predict_axis_time(distance[axis], axis_speed, accel * rate[axis],
+			from->pass_through ? carried : 0, target->pass_through ? carried : 0));
+	}
+	seconds += predict_latency_ms / 1000.0;
+	if(!target->pass_through)
+		seconds = ceil(seconds * 1000 / SLEEP_TIME_MILLISECONDS) * SLEEP_TIME_MILLISECONDS / 1000.0;
+	return seconds;
+}
+
+/*
+ * Print the predicted lap of a profile segment by segment, dwell in
+ * seconds at the stops the tour loop dwells at
+ */
+static void predict_lap(const TOUR_PROFILE *profile)
+{
+	const PTZ_POS *from = (PTZ_POS*)g_list_last(profile->path)->data;
+	gdouble transit = 0;
+	gdouble dwell = 0;
+	gint count = 0;
+	GList *it;
+
+	printf("profile %s: %d presets, %d waypoints\n", profile->name, profile->preset_count, g_list_length(profile->path));
+	if(profile->budgeted)
+		printf("  lap budget %.1f s: max speed %.2f, %d waypoints between presets\n", lap_target_ms / 1000.0, profile->budget_speed, profile->npt);
+	printf("  %5s %-10s %-4s %6s %6s %6s  %-17s %8s %7s\n", "seg", "execution", "stop", "pan", "tilt", "zoom", "speed p/t/z", "transit", "dwell");
+	for(it = profile->path ; it != NULL ; it = g_list_next(it))
+	{
+		const PTZ_POS *target = (PTZ_POS*)it->data;
+		EXEC_KIND kind = choose_execution(from, target);
+		gdouble speed[3];
+		gdouble seconds;
+		gint delay_ms;
+		gint stop;
+
+		count ++;
+		seconds = predict_segment(from, target, kind, profile_max_speed(profile, count), speed);
+		delay_ms = waypoint_delay(profile, count, &stop);
+		transit += seconds;
+		dwell += delay_ms / 1000.0;
+		printf("  %5d %-10s %-4s %6d %6d %6d  %.3f/%.3f/%.3f %7.3fs %6.1fs\n", count, exec_kind_names[kind], target->pass_through ? "" : "yes",
+			target->pan_val, target->tilt_val, target->zoom_val, speed[0], speed[1], speed[2], seconds, delay_ms / 1000.0);
+		from = target;
+	}
+	printf("  lap: transit %.1f s + dwell %.1f s = %.1f s\n", transit, dwell, transit + dwell);
+}
+
+static gboolean run_dry_run(const gchar *path, GError **error)
+{
+	gint64 start_us = g_get_monotonic_time();
+	GList *names = NULL;
+	gint i;
+
+	if(!load_preset_file(path, &names, error))
+		return FALSE;
+	build_tour_profiles(names);
+	g_list_free_full(names, g_free);
+	if(scan_mode)
+		add_scan_profile();
+	if(teach_mode)
+		add_teach_profile();
+	if(tour_profile_count == 0)
+	{
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "no tour presets in %s", path);
+		return FALSE;
+	}
+
+	printf("dry run of %s: max speed %.2f, %d waypoints between presets, segment mode %s%s\n", path, cont_max_speed, NPT,
+		segment_mode_names[segment_mode], scurve_mode ? ", S-curves" : "");
+	printf("model: accel pan %.2f tilt %.2f zoom %.2f speed/s, command latency %d ms\n", predict_accel[0], predict_accel[1], predict_accel[2], predict_latency_ms);
+	for(i = 0 ; i < tour_profile_count ; i ++)
+	{
+		if(!calibrate_tour_profile(&tour_profiles[i]))
+		{
+			printf("profile %s: presets missing from %s, not predicted\n", tour_profiles[i].name, path);
+			continue;
+		}
+		if(lap_target_ms > 0)
+			budget_plan_profile(i);
+		predict_lap(&tour_profiles[i]);
+	}
+	printf("predicted in %.2f ms\n", (g_get_monotonic_time() - start_us) / 1000.0);
+	return TRUE;
+}
+
+/*
+ * Synchronized tours. The leader publishes a lap schedule (see tour_sync.h)
+ * and each instance starts its laps on the slots of the period, shifted
+ * by its SyncPhase. Within a lap the plan (see lap_plan.h) is stretched
+ * from the predicted lap to the period: a dwell lasts until the planned
+ * departure, at most a period longer than its own delay, and a segment
+ * that starts more than SyncTolerance behind the plan runs faster, up to
+ * SYNC_MAX_SPEED_SCALE times the max speed.
+ */
+static LAP_PLAN sync_plan = LAP_PLAN_INIT;
+static gint64 sync_period_us = 0;
+static gboolean sync_schedule_missing = FALSE;
+
+static gint64 sync_real_us(gdouble camera_ms)
+{
+	return (gint64)(camera_ms * tick_period_us / SLEEP_TIME_MILLISECONDS);
+}
+
+static gint64 sync_camera_ms(gint64 real_us)
+{
+	return real_us * SLEEP_TIME_MILLISECONDS / tick_period_us;
+}
+
+/*
+ * Plan the departures of the <index>-th profile, as predict_lap() does,
+ * with the predicted transits scaled by <model>
+ */
+static void plan_departures(gint index, gdouble model, LAP_PLAN *plan)
+{
+	const TOUR_PROFILE *profile = &tour_profiles[index];
+	const PTZ_POS *from = (PTZ_POS*)g_list_last(profile->path)->data;
+	gint count = 0;
+	GList *it;
+
+	lap_plan_reset(plan, index, g_list_length(profile->path), tick_period_us / (gdouble)SLEEP_TIME_MILLISECONDS);
+	for(it = profile->path ; it != NULL ; it = g_list_next(it))
+	{
+		const PTZ_POS *target = (PTZ_POS*)it->data;
+		gdouble speed[3];
+		gint stop;
+
+		count ++;
+		lap_plan_add(plan, predict_segment(from, target, choose_execution(from, target), profile_max_speed(profile, count), speed) * model,
+			waypoint_delay(profile, count, &stop) / 1000.0);
+		from = target;
+	}
+}
+
+/*
+ * Put the lap that starts at <first> on the nearest slot of the schedule.
+ * A lap that starts mid-path, after a profile switch, runs on its own.
+ */
+static void sync_start_lap(GList *first)
+{
+	TOUR_SYNC_SCHEDULE schedule;
+	gint64 error_ms;
+
+	sync_plan.start_us = 0;
+	if(sync_mode == SYNC_OFF)
+		return;
+	if(sync_plan.profile != active_profile)
+	{
+		plan_departures(active_profile, 1.0, &sync_plan);
+		LOGINFO("Predicted lap of tour profile %s for the schedule: %.1f s", tour_profiles[active_profile].name, sync_plan.lap);
+	}
+	if(first != g_list_first(realPath))
+	{
+		LOGINFO("Lap starts at No%d position, synchronized from the next lap", g_list_position(realPath, first) + 1);
+		return;
+	}
+	if(sync_mode == SYNC_LEADER && !tour_sync_get_schedule(&schedule, 0))
+	{
+		gint64 period_us = sync_real_us(sync_period_ms > 0 ? sync_period_ms : sync_plan.lap * 1000 * SYNC_PERIOD_MARGIN);
+
+		/* this lap starts on the leader's own slot */
+		tour_sync_set_schedule(g_get_monotonic_time() - (gint64)(sync_phase * period_us), period_us);
+		LOGINFO("Leading the tour schedule, lap period %" G_GINT64_FORMAT " ms", sync_camera_ms(period_us));
+	}
+	if(!tour_sync_get_schedule(&schedule, SYNC_SCHEDULE_TIMEOUT_US))
+	{
+		if(!sync_schedule_missing)
+			LOGINFO("No tour schedule from %s:%d, touring on our own", sync_group, sync_port);
+		sync_schedule_missing = TRUE;
+		return;
+	}
+	if(sync_schedule_missing || schedule.period_us != sync_period_us)
+		LOGINFO("Tour schedule: lap period %" G_GINT64_FORMAT " ms, clock offset %" G_GINT64_FORMAT " us", sync_camera_ms(schedule.period_us), schedule.offset_us);
+	sync_schedule_missing = FALSE;
+	sync_period_us = schedule.period_us;
+
+	error_ms = sync_camera_ms(lap_plan_sync(&sync_plan, &schedule, sync_phase, g_get_monotonic_time()));
+	sync_laps ++;
+	sync_error_sum_ms += ABS(error_ms);
+	sync_error_max_ms = MAX(sync_error_max_ms, ABS(error_ms));
+	LOGINFO("Lap starts %+" G_GINT64_FORMAT " ms off the schedule", error_ms);
+}
+
+/*
+ * <max_speed> of the segment to the <count>-th waypoint, raised while the
+ * tour is behind the schedule
+ */
+static gfloat sync_max_speed(gint count, gfloat max_speed)
+{
+	gint64 late_us = lap_plan_late_us(&sync_plan, count, g_get_monotonic_time());
+	gdouble scale;
+
+	if(late_us <= sync_real_us(sync_tolerance_ms))
+		return max_speed;
+	scale = MIN(1.0 + SYNC_SPEED_GAIN * late_us / sync_period_us, SYNC_MAX_SPEED_SCALE);
+	sync_speedups ++;
+	LOGINFO("%" G_GINT64_FORMAT " ms behind the schedule, speed x%.2f", sync_camera_ms(late_us), scale);
+	return MIN(max_speed * scale, scurve_mode ? SCURVE_MAX_PAN_TILT_SPEED : MAX_PAN_TILT_SPEED);
+}
+
+/*
+ * Dwell at the <count>-th waypoint until its planned departure
+ */
+static gint sync_dwell_ms(gint count, gint delay_ms)
+{
+	gint64 dwell_us = lap_plan_dwell_us(&sync_plan, count, g_get_monotonic_time(), sync_real_us(delay_ms) + sync_period_us);
+
+	if(dwell_us < 0)
+		return delay_ms;
+	if(dwell_us < sync_real_us(delay_ms) - sync_real_us(sync_tolerance_ms))
+		sync_short_dwells ++;
+	return (gint)sync_camera_ms(dwell_us);
+}
+
+/*
+ * Lap-time budget. With LapTarget set, a preset tour is planned to lap in
+ * that time. The predicted lap (see predict_segment) at MaxPanTiltSpeed
+ * leaves either slack, shared out over the preset dwells in proportion to
+ * their delays, or a deficit, made up by raising the max speed up to the
+ * axis limit, then by dropping the interpolated waypoints and last by
+ * cutting the dwells. Predictions are scaled by the measured over the
+ * predicted transit of the last laps; a lap more than LapTolerance off
+ * the target or the plan is planned again, and within a lap each dwell
+ * lasts until the planned departure. Scan and taught profiles keep their
+ * own timing, and a synchronized lap follows the schedule instead.
+ */
+static LAP_PLAN budget_plan = LAP_PLAN_INIT;
+static gdouble budget_model = 1.0;//measured over predicted transit
+static gboolean budget_replan = FALSE;
+static gint budget_lap_holds = 0;//pauses, interrupts and axptz errors before the lap
+
+/*
+ * Predicted transit of a lap along the path <data> at <max_speed>, camera
+ * seconds
+ */
+static gdouble budget_transit(gfloat max_speed, gpointer data)
+{
+	GList *path = data;
+	const PTZ_POS *from = (PTZ_POS*)g_list_last(path)->data;
+	gdouble seconds = 0;
+	GList *it;
+
+	for(it = path ; it != NULL ; it = g_list_next(it))
+	{
+		const PTZ_POS *target = (PTZ_POS*)it->data;
+		gdouble speed[3];
+
+		seconds += predict_segment(from, target, choose_execution(from, target), max_speed, speed);
+		from = target;
+	}
+	return seconds * budget_model;
+}
+
+static void budget_plan_profile(gint index)
+{
+	TOUR_PROFILE *profile = &tour_profiles[index];
+	gdouble target = lap_target_ms / 1000.0;
+	gfloat top = MAX(scurve_mode ? SCURVE_MAX_PAN_TILT_SPEED : MAX_PAN_TILT_SPEED, cont_max_speed);
+	gfloat speed = cont_max_speed;
+	gdouble dwell = 0;
+	gdouble transit;
+	GList *path;
+	gint npt = NPT;
+	gint i;
+
+	if(profile->scan || profile->teach || profile->stops == NULL)
+		return;
+	for(i = 0 ; i < profile->preset_count ; i ++)
+		dwell += profile->preset_delay[i] / 1000.0;
+
+	path = get_circular_path(profile->stops, npt);
+	if((transit = budget_transit(speed, path)) + dwell > target)
+	{
+		speed = lap_budget_solve_speed(budget_transit, path, target - dwell, speed, top);
+		transit = budget_transit(speed, path);
+	}
+	if(transit + dwell > target && npt > 0)
+	{
+		/* one command per preset instead of NPT + 1 */
+		GList *direct = get_circular_path(profile->stops, 0);
+		gfloat direct_speed = lap_budget_solve_speed(budget_transit, direct, target - dwell, cont_max_speed, top);
+		gdouble direct_transit = budget_transit(direct_speed, direct);
+
+		if(direct_transit < transit)
+		{
+			g_list_free_full(path, g_free);
+			path = direct;
+			npt = 0;
+			speed = direct_speed;
+			transit = direct_transit;
+		}
+		else
+			g_list_free_full(direct, g_free);
+	}
+	lap_budget_share_dwells(profile->preset_delay, profile->budget_delay, profile->preset_count, transit, target);
+
+	if(npt != profile->npt)
+	{
+		if(realPath == profile->path)
+			realPath = path;
+		g_list_free_full(profile->path, g_free);
+		profile->path = path;
+		profile->npt = npt;
+	}
+	else
+		g_list_free_full(path, g_free);
+	profile->budget_speed = speed;
+	profile->budgeted = TRUE;
+	if(sync_plan.profile == index)
+		sync_plan.profile = -1;
+	budget_replans ++;
+	LOGINFO("Lap budget of tour profile %s: %d ms, max speed %.2f, %d waypoints between presets, transit %.1f s, dwell %.1f s of %.1f s (model x%.2f)",
+		profile->name, lap_target_ms, speed, npt, transit, MAX(target - transit, 0), dwell, budget_model);
+	if(transit > target)
+		LOGINFO("Tour profile %s can not lap in %d ms, %.1f s at the axis limit without dwells", profile->name, lap_target_ms, transit);
+}
+
+/*
+ * Plan the <index>-th profile for the budget when it is not, or when the
+ * last lap asked for it, and predict its departures
+ */
+static void budget_prepare(gint index)
+{
+	if(lap_target_ms <= 0 || (index == budget_plan.profile && !budget_replan))
+		return;
+	budget_plan_profile(index);
+	budget_replan = FALSE;
+	lap_plan_clear(&budget_plan);
+	budget_plan.profile = index;
+	if(tour_profiles[index].budgeted)
+		plan_departures(index, budget_model, &budget_plan);
+}
 
-static  gint preset_numbers[MAX_PRESET_NUMBER + 1];
-static  gint preset_indices[MAX_PRESET_NUMBER + 1];
-static  gint preset_delay[MAX_PRESET_NUMBER + 1];
-static  gint preset_count = 0;
-static void get_path()
+/*
+ * Plan the lap that starts at <first>. A lap that starts mid-path, after a
+ * profile switch, runs on its own.
+ */
+static void budget_start_lap(GList *first)
 {
-	preset_count = 0;
-	GError *local_error = NULL;
-	GList *temp = NULL;
-	temp = ax_ptz_preset_handler_query_presets(ax_ptz_control_queue_group, VIDEO_CHANNEL, FALSE, &local_error);//preset names
-	GList* it = NULL;
+	budget_plan.start_us = 0;
+	if(lap_target_ms <= 0 || first != g_list_first(realPath))
+		return;
+	budget_prepare(active_profile);
+	if(!tour_profiles[active_profile].budgeted)
+		return;
+	lap_plan_start(&budget_plan, g_get_monotonic_time());
+	budget_lap_holds = pause_count + interrupt_count + ptz_error_count;
+}
+
+/*
+ * Score a lap that took <lap_us> against the budget and learn from its
+ * transit, unless a pause, an interrupt or an axptz error held it
+ */
+static void budget_end_lap(gint64 lap_us)
+{
+	gint64 lap_ms;
+	gint64 error_ms;
+	gdouble transit;
+
+	if(budget_plan.start_us == 0)
+		return;
+	budget_plan.start_us = 0;
+	lap_ms = sync_camera_ms(lap_us);
+	error_ms = lap_ms - lap_target_ms;
+	budget_laps ++;
+	budget_error_sum_ms += ABS(error_ms);
+	budget_error_max_ms = MAX(budget_error_max_ms, ABS(error_ms));
+	if(ABS(error_ms) > lap_tolerance_ms)
+		budget_misses ++;
+	if(pause_count + interrupt_count + ptz_error_count != budget_lap_holds || budget_plan.transit <= 0)
+		return;
 
-	for(it = g_list_first(temp) ; it != NULL ; it = g_list_next(it))
+	transit = (lap_ms - budget_plan.dwell_ms) / 1000.0;
+	budget_model = lap_budget_learn(budget_model, transit, budget_plan.transit);
+	if(ABS(error_ms) > lap_tolerance_ms || fabs(transit - budget_plan.transit) * 1000 > lap_tolerance_ms)
 	{
+		budget_replan = TRUE;
+		LOGINFO("Lap took %" G_GINT64_FORMAT " ms, transit %.1f s of %.1f s planned, planning again", lap_ms, transit, budget_plan.transit);
+	}
+}
 
-		if(preset_count < MAX_PRESET_NUMBER)
-		{
-			gchar* preset_name = (gchar*)it->data;
+/*
+ * Dwell at the <count>-th waypoint until its planned departure, to make up
+ * within the lap for segments that took longer or shorter than planned
+ */
+static gint budget_dwell_ms(gint count, gint delay_ms)
+{
+	gint64 dwell_us;
 
-			gint len = strlen(preset_name);
-			gint k;
-			if(len < 17 || len > 30)
-			{
-				continue;
-			}
-			else
-			{
-				gchar temp[30];
-				strcpy(temp, "=");
-				strcat(temp, preset_name);
-				gchar *pch;
-				pch = strtok(temp,"=_");
-				if(pch != NULL)
-				{
-					if(strcmp(pch, "presetposno1") == 0)//home preset position
-						continue;
-				}
-				else
-				{
-					continue;
-				}
-				gint len = strlen(pch);
-				gchar preset_index[5];
-				if (len > 11 && len < 15)
-				{
-				
-					gint ii = 11;
-					for (ii = 11; ii < len; ii++)
-					{
-						preset_index[ii - 11] = pch[ii];
-					}
-					preset_index[len - 11] = '\0';
-				  
-				}
-				else
-				{
-					continue;
-				}
-				preset_indices[preset_count] = (gint)atoi(preset_index);
-				pch = strtok(NULL, "=_");
-				if(pch != NULL)
-				{
-					preset_numbers[preset_count] = (gint)atoi(pch);
-				}
-				else
-				{
-					continue;
-				}
-				pch = strtok(NULL, "=_");
-				if(pch != NULL)
-				{
-					preset_delay[preset_count] = (gint)atoi(pch);
-				}
-			}
+	/* a held lap is off the plan anyway */
+	if(sync_plan.start_us != 0 || pause_count + interrupt_count + ptz_error_count != budget_lap_holds)
+		return delay_ms;
+	if((dwell_us = lap_plan_dwell_us(&budget_plan, count, g_get_monotonic_time(), sync_real_us(delay_ms + lap_tolerance_ms))) < 0)
+		return delay_ms;
+	return (gint)sync_camera_ms(dwell_us);
+}
 
-			LOGINFO("PRESETNUMBER%d-%d-%d-%s" , preset_count , preset_indices[preset_count] , (gint)(preset_numbers[preset_count]), preset_name);
+/*
+ * SyncMode parameter, off when unset or unknown
+ */
+static gint get_sync_mode_parameter(AXParameter *param)
+{
+	g_autofree gchar *value = get_string_parameter(param, "SyncMode", sync_mode_names[SYNC_OFF]);
+	gint mode;
 
-			preset_count ++;
-		}
-	}
-//home preset is the first one and we dont need it
-//i should start from 1
-  
-  //sort preset_index and preset_numbers
-	gint i = 0;
-	for(i = 0 ; i < (preset_count - 1) ; i++)
+	for(mode = SYNC_OFF ; mode <= SYNC_FOLLOWER ; mode ++)
 	{
-		gint j = i + 1;
-		for(j = i + 1 ; j < (preset_count) ; j++)
-		{
-			if(preset_numbers[i] > preset_numbers[j])
-			{
-				gint char_temp;
-				char_temp = preset_numbers[i];
-				preset_numbers[i] = preset_numbers[j];
-				preset_numbers[j] = char_temp;
-				
-				gint int_temp;
-				int_temp = preset_indices[i];
-				preset_indices[i] = preset_indices[j];
-				preset_indices[j] = int_temp;
-				
-				gint int_temp1;
-				int_temp1 = preset_delay[i];
-				preset_delay[i] = preset_delay[j];
-				preset_delay[j] = int_temp1;
-			}
-		}
+		if(g_ascii_strcasecmp(value, sync_mode_names[mode]) == 0)
+			return mode;
 	}
-  
-	if(temp != NULL)
+	LOGINFO("Unknown SyncMode \"%s\", synchronization off", value);
+	return SYNC_OFF;
+}
+
+/*
+ * SegmentMode parameter, continuous when unset or unknown
+ */
+static gint get_segment_mode_parameter(AXParameter *param)
+{
+	g_autofree gchar *value = get_string_parameter(param, "SegmentMode", segment_mode_names[SEGMENT_CONTINUOUS]);
+	gint mode;
+
+	for(mode = SEGMENT_CONTINUOUS ; mode <= SEGMENT_HYBRID ; mode ++)
 	{
-		it = NULL;
-		for(it = g_list_first(temp) ; it != NULL ; it = g_list_next(it))
-		{
-			g_free((char*)it->data);
-		}
-		g_list_free(temp);
+		if(g_ascii_strcasecmp(value, segment_mode_names[mode]) == 0)
+			return mode;
 	}
-	if( local_error != NULL ) g_error_free(local_error);
-	return;
+	LOGINFO("Unknown SegmentMode \"%s\", using continuous", value);
+	return SEGMENT_CONTINUOUS;
 }
 
-
-static void get_circular_path()
+/*
+ * Free the capability list and both paths, used on every exit path
+ */
+static void free_resources(void)
 {
-	GList* it = NULL;
-	gint pathCount = 0;
+	g_list_free_full(capabilities, g_free);
+	capabilities = NULL;
+	gint i;
 
-	for(it = g_list_first(tempPath) ; it != NULL ; it = g_list_next(it))
+	for(i = 0 ; i < tour_profile_count ; i ++)
 	{
-		pathCount ++;
-		PTZ_POS* temp = g_malloc(sizeof(PTZ_POS));
-		temp->pan_val = ((PTZ_POS*)(it->data))->pan_val;
-		temp->tilt_val = ((PTZ_POS*)(it->data))->tilt_val;
-		temp->zoom_val = ((PTZ_POS*)(it->data))->zoom_val;
-		realPath = g_list_append(realPath , temp);
-		LOGINFO("Path Number:%d" , pathCount);
-		LOGINFO("Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , pathCount , ((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(it->data))->tilt_val , ((PTZ_POS*)(it->data))->zoom_val);
-		if(g_list_next(it) != NULL)//This means <it> is not the last node
-		{
-			gint i;
-			for(i = 0 ; i < NPT ; i ++)
-			{
-				PTZ_POS* temp = g_malloc(sizeof(PTZ_POS));
-				temp->pan_val = fx_addx(((PTZ_POS*)(it->data))->pan_val , fx_mulx(fx_divx(fx_subx(((PTZ_POS*)(g_list_next(it)->data))->pan_val , ((PTZ_POS*)(it->data))->pan_val) , fx_itox(NPT + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS) , fx_itox(i + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS));
-				temp->tilt_val = fx_addx(((PTZ_POS*)(it->data))->tilt_val , fx_mulx(fx_divx(fx_subx(((PTZ_POS*)(g_list_next(it)->data))->tilt_val , ((PTZ_POS*)(it->data))->tilt_val) , fx_itox(NPT + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS) , fx_itox(i + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS));
-				temp->zoom_val = fx_addx(((PTZ_POS*)(it->data))->zoom_val , fx_mulx(fx_divx(fx_subx(((PTZ_POS*)(g_list_next(it)->data))->zoom_val , ((PTZ_POS*)(it->data))->zoom_val) , fx_itox(NPT + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS) , fx_itox(i + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS));
-				realPath = g_list_append(realPath , temp);
-				pathCount ++;
-				LOGINFO("Path Number:%d" , g_list_length(realPath));
-				LOGINFO("Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , pathCount , temp->pan_val , temp->tilt_val , temp->zoom_val);
-			}
-		}
-		else//This means <it> is the last node
-		{
-			gint i;
-			for(i = 0 ; i < NPT ; i ++)
-			{
-				PTZ_POS* temp = g_malloc(sizeof(PTZ_POS));
-				temp->pan_val = fx_addx(((PTZ_POS*)(it->data))->pan_val , fx_mulx(fx_divx(fx_subx(((PTZ_POS*)(g_list_first(tempPath)->data))->pan_val , ((PTZ_POS*)(it->data))->pan_val) , fx_itox(NPT + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS) , fx_itox(i + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS));
-				temp->tilt_val = fx_addx(((PTZ_POS*)(it->data))->tilt_val , fx_mulx(fx_divx(fx_subx(((PTZ_POS*)(g_list_first(tempPath)->data))->tilt_val , ((PTZ_POS*)(it->data))->tilt_val) , fx_itox(NPT + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS) , fx_itox(i + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS));
-				temp->zoom_val = fx_addx(((PTZ_POS*)(it->data))->zoom_val , fx_mulx(fx_divx(fx_subx(((PTZ_POS*)(g_list_first(tempPath)->data))->zoom_val , ((PTZ_POS*)(it->data))->zoom_val) , fx_itox(NPT + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS) , fx_itox(i + 1 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS));
-				realPath = g_list_append(realPath , temp);
-				pathCount ++;
-				LOGINFO("Path Number:%d" , g_list_length(realPath));
-				LOGINFO("Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , pathCount , temp->pan_val , temp->tilt_val , temp->zoom_val);
-			}
-		}
+		g_list_free_full(tour_profiles[i].stops, g_free);
+		tour_profiles[i].stops = NULL;
+		g_list_free_full(tour_profiles[i].path, g_free);
+		tour_profiles[i].path = NULL;
+		g_free(tour_profiles[i].teach_speeds);
+		tour_profiles[i].teach_speeds = NULL;
+		g_free(tour_profiles[i].teach_holds);
+		tour_profiles[i].teach_holds = NULL;
 	}
+	tour_profile_count = 0;
+	realPath = NULL;
+	trace_close();
+	status_snapshot_close();
+	g_free(trace_file);
+	trace_file = NULL;
+	g_free(tour_profile_name);
+	tour_profile_name = NULL;
+	g_free(interrupt_socket);
+	interrupt_socket = NULL;
+	g_free(sync_group);
+	sync_group = NULL;
+	g_free(teach_plan_file);
+	teach_plan_file = NULL;
+	lap_plan_clear(&sync_plan);
+	lap_plan_clear(&budget_plan);
 }
 
 /*
@@ -782,7 +4939,7 @@ static void get_circular_path()
 int main(int argc, char **argv)
 {
 	GError *local_error = NULL;
-	GList *it = NULL;
+	AXParameter* param = NULL;
   
 #ifdef WRITE_TO_SYS_LOG
 	openlog(APP_NAME, LOG_PID | LOG_CONS, LOG_USER);
@@ -808,7 +4965,6 @@ int main(int argc, char **argv)
 	LOGINFO("panoramatv started...\n");
 	
 	/* Get the value of the parameter "MaxPanTiltSpeed", "MaxZoomSpeed" */
-	AXParameter* param = NULL;
 	gchar *value = NULL;
 	param = ax_parameter_new(APP_NAME , &local_error);
 	if(param == NULL)
@@ -822,10 +4978,20 @@ int main(int argc, char **argv)
 	}
 	syslog(LOG_INFO, "The value of \"MaxPanTiltSpeed\" is \"%s\"", value);
 	cont_max_speed = (gfloat)(atof(value));
-	if(cont_max_speed > MAX_PAN_TILT_SPEED)
+
+	/* the S-curve ramps are what makes speeds above MAX_PAN_TILT_SPEED safe */
+	scurve_mode = get_bool_parameter(param, "SCurveEnabled", FALSE);
+	scurve_accel = MAX(get_float_parameter(param, "SCurveMaxAccel", SCURVE_DEFAULT_ACCEL), 0.01f);
+	scurve_jerk = MAX(get_float_parameter(param, "SCurveMaxJerk", SCURVE_DEFAULT_JERK), 0.01f);
+	if(scurve_mode && !motion_scurve_plan(&scurve, CLAMP(cont_max_speed, MIN_PAN_TILT_SPEED, SCURVE_MAX_PAN_TILT_SPEED), scurve_accel, scurve_jerk, SLEEP_TIME_MILLISECONDS / 1000.0))
+	{
+		LOGINFO("S-curve ramp longer than %d ticks, raise SCurveMaxAccel or SCurveMaxJerk; S-curves off", MOTION_SCURVE_MAX_STEPS);
+		scurve_mode = FALSE;
+	}
+	if(cont_max_speed > (scurve_mode ? SCURVE_MAX_PAN_TILT_SPEED : MAX_PAN_TILT_SPEED))
 	{
-		LOGINFO("max pan tilt speed is bigger than %f", MAX_PAN_TILT_SPEED);
-		cont_max_speed = MAX_PAN_TILT_SPEED;
+		LOGINFO("max pan tilt speed is bigger than %f", scurve_mode ? SCURVE_MAX_PAN_TILT_SPEED : MAX_PAN_TILT_SPEED);
+		cont_max_speed = scurve_mode ? SCURVE_MAX_PAN_TILT_SPEED : MAX_PAN_TILT_SPEED;
 	}
 	if(cont_max_speed < MIN_PAN_TILT_SPEED)
 	{
@@ -836,6 +5002,158 @@ int main(int argc, char **argv)
 	value = NULL;
   
 	LOGINFO("Max Pan Tilt Speed %f" , cont_max_speed);
+	if(scurve_mode)
+		LOGINFO("S-curve speed ramps: %d ticks to full speed, accel %.2f/s, jerk %.2f/s2", scurve.steps, scurve_accel, scurve_jerk);
+
+	rt_mode = get_bool_parameter(param, "RealTimeMode", FALSE);
+	rt_priority = CLAMP(get_int_parameter(param, "RealTimePriority", RT_DEFAULT_PRIORITY), RT_MIN_PRIORITY, RT_MAX_PRIORITY);
+	rt_cpu = get_int_parameter(param, "RealTimeCpu", -1);
+	rt_lock_memory = get_bool_parameter(param, "RealTimeLockMemory", TRUE);
+	screen_speed_mode = get_bool_parameter(param, "ConstantScreenSpeed", FALSE);
+	screen_speed_limit = get_float_parameter(param, "MaxScreenSpeed", SCREEN_SPEED_DEFAULT_LIMIT);
+	wide_field_of_view = get_float_parameter(param, "WideFieldOfView", WIDE_FIELD_OF_VIEW_DEFAULT);
+	max_zoom_ratio = MAX(get_float_parameter(param, "MaxZoomRatio", MAX_ZOOM_RATIO_DEFAULT), 1.0f);
+	LOGINFO("Constant screen speed %s, limit %.2f widths/s", screen_speed_mode ? "on" : "off", screen_speed_limit);
+	status_sample_rate = CLAMP(get_int_parameter(param, "StatusSampleRate", STATUS_SAMPLE_DEFAULT_HZ), 1, STATUS_SAMPLE_MAX_HZ);
+	LOGINFO("Real-time mode %s, priority %d, cpu %d, lock memory %s", rt_mode ? "on" : "off", rt_priority, rt_cpu, rt_lock_memory ? "yes" : "no");
+	endless_pan = get_bool_parameter(param, "EndlessPan", TRUE);
+	blend_tolerance = fx_ftox(CLAMP(get_float_parameter(param, "BlendTolerance", BLEND_TOLERANCE_DEFAULT), 0.0f, BLEND_TOLERANCE_MAX), FIXMATH_FRAC_BITS);
+	LOGINFO("Blend tolerance %.2f", fx_xtof(blend_tolerance, FIXMATH_FRAC_BITS));
+	segment_mode = get_segment_mode_parameter(param);
+	absolute_hop_units = MAX(get_int_parameter(param, "AbsoluteHopUnits", ABSOLUTE_HOP_DEFAULT_UNITS), 0);
+	final_approach_units = MAX(get_int_parameter(param, "FinalApproachUnits", FINAL_APPROACH_DEFAULT_UNITS), MOTION_PAN_TILT_ARRIVAL_UNITS);
+	arrival_tolerance_units = MAX(get_int_parameter(param, "ArrivalTolerance", ARRIVAL_TOLERANCE_DEFAULT_UNITS), 0);
+	LOGINFO("Motion math backend %s", MOTION_MATH_BACKEND);
+	LOGINFO("Segment mode %s, absolute hops up to %d, final approach from %d, arrival tolerance %d units", segment_mode_names[segment_mode], absolute_hop_units, final_approach_units, arrival_tolerance_units);
+	stall_window_ticks = CLAMP(get_int_parameter(param, "StallWindow", STALL_DEFAULT_WINDOW_MS) / SLEEP_TIME_MILLISECONDS, 2, STALL_RING_LENGTH - 1);
+	stall_min_progress = MAX(get_int_parameter(param, "StallMinProgress", STALL_DEFAULT_MIN_PROGRESS_UNITS), 1);
+	LOGINFO("Stall after less than %d units of progress in %d ticks", stall_min_progress, stall_window_ticks);
+	drift_mode = get_bool_parameter(param, "DriftCheckEnabled", FALSE);
+	drift_check_laps = MAX(get_int_parameter(param, "DriftCheckLaps", DRIFT_DEFAULT_LAPS), 1);
+	drift_tolerance_units = MAX(get_int_parameter(param, "DriftTolerance", DRIFT_DEFAULT_TOLERANCE_UNITS), 0);
+	drift_max_step_units = MAX(get_int_parameter(param, "DriftMaxStep", DRIFT_DEFAULT_MAX_STEP_UNITS), 1);
+	LOGINFO("Drift checks %s, every %d laps, tolerance %d units, steps up to %d units", drift_mode ? "on" : "off", drift_check_laps, drift_tolerance_units, drift_max_step_units);
+	residual_correction = get_bool_parameter(param, "ResidualCorrection", FALSE);
+	correction_tolerance_units = MAX(get_int_parameter(param, "CorrectionTolerance", CORRECTION_TOLERANCE_DEFAULT_UNITS), 1);
+	correction_max_moves = CLAMP(get_int_parameter(param, "CorrectionMaxMoves", CORRECTION_DEFAULT_MAX_MOVES), 1, 10);
+	correction_budget_ms = MAX(get_int_parameter(param, "CorrectionBudget", CORRECTION_DEFAULT_BUDGET_MS), 0);
+	LOGINFO("Residual correction %s, tolerance %d units, up to %d moves in %d ms", residual_correction ? "on" : "off", correction_tolerance_units, correction_max_moves, correction_budget_ms);
+	trace_mode = get_bool_parameter(param, "TraceEnabled", FALSE);
+	trace_file = get_string_parameter(param, "TraceFile", TRACE_DEFAULT_FILE);
+	trace_capacity = CLAMP(get_int_parameter(param, "TraceRecords", TRACE_DEFAULT_RECORDS), 64, 1 << 24);
+	status_snapshot_mode = get_bool_parameter(param, "StatusSnapshot", TRUE);
+	tour_profile_name = get_string_parameter(param, "TourProfile", DEFAULT_TOUR_PROFILE);
+	scan_mode = get_bool_parameter(param, "ScanEnabled", FALSE);
+	scan_corners[0] = get_int_parameter(param, "ScanCorner1", 0);
+	scan_corners[1] = get_int_parameter(param, "ScanCorner2", 0);
+	scan_zoom_ratio = MAX(get_float_parameter(param, "ScanZoom", 0.0f), 0.0f);
+	scan_overlap = CLAMP(get_float_parameter(param, "ScanOverlap", SCAN_OVERLAP_DEFAULT), 0.0f, SCAN_OVERLAP_MAX);
+	teach_mode = get_bool_parameter(param, "TeachEnabled", FALSE);
+	teach_plan_file = get_string_parameter(param, "TeachPlan", TEACH_PLAN_DEFAULT_FILE);
+	teach_tolerance_units = MAX(get_int_parameter(param, "TeachTolerance", TEACH_DEFAULT_TOLERANCE_UNITS), 1);
+	interrupt_mode = get_bool_parameter(param, "InterruptEnabled", FALSE);
+	interrupt_socket = get_string_parameter(param, "InterruptSocket", PRESET_INTERRUPT_DEFAULT_SOCKET);
+	interrupt_hold_ms = CLAMP(get_int_parameter(param, "InterruptHold", INTERRUPT_DEFAULT_HOLD_MS), 0, INTERRUPT_MAX_HOLD_MS);
+	predict_accel[0] = MAX(get_float_parameter(param, "PredictPanAccel", PREDICT_DEFAULT_ACCEL), 0.0f);
+	predict_accel[1] = MAX(get_float_parameter(param, "PredictTiltAccel", PREDICT_DEFAULT_ACCEL), 0.0f);
+	predict_accel[2] = MAX(get_float_parameter(param, "PredictZoomAccel", PREDICT_DEFAULT_ACCEL), 0.0f);
+	predict_latency_ms = MAX(get_int_parameter(param, "PredictLatency", PREDICT_DEFAULT_LATENCY_MS), 0);
+	sync_mode = get_sync_mode_parameter(param);
+	sync_group = get_string_parameter(param, "SyncGroup", TOUR_SYNC_DEFAULT_GROUP);
+	sync_port = CLAMP(get_int_parameter(param, "SyncPort", TOUR_SYNC_DEFAULT_PORT), 1, 65535);
+	sync_period_ms = MAX(get_int_parameter(param, "SyncPeriod", 0), 0);
+	sync_phase = get_float_parameter(param, "SyncPhase", 0.0f);
+	sync_phase -= floorf(sync_phase);
+	sync_tolerance_ms = MAX(get_int_parameter(param, "SyncTolerance", SYNC_DEFAULT_TOLERANCE_MS), 0);
+	LOGINFO("Synchronized tour %s, group %s:%d, period %d ms, phase %.2f, tolerance %d ms", sync_mode_names[sync_mode], sync_group, sync_port, sync_period_ms, sync_phase, sync_tolerance_ms);
+	lap_target_ms = MAX(get_int_parameter(param, "LapTarget", 0), 0);
+	lap_tolerance_ms = MAX(get_int_parameter(param, "LapTolerance", BUDGET_DEFAULT_TOLERANCE_MS), 0);
+	if(lap_target_ms > 0)
+		LOGINFO("Lap budget %d ms, tolerance %d ms", lap_target_ms, lap_tolerance_ms);
+	error_retries = MAX(get_int_parameter(param, "ErrorRetries", ERROR_DEFAULT_RETRIES), 0);
+	error_reinit_after = MAX(get_int_parameter(param, "ErrorReinitAfter", ERROR_DEFAULT_REINIT_AFTER), 0);
+	LOGINFO("AXPTZ errors retried %d times in a row, library created again from the %d-th", error_retries, error_reinit_after);
+
+	if(argc > 1 && g_strcmp0(argv[1], "--dry-run") == 0)
+	{
+		gboolean dry_ok;
+
+		/* the planning logs would cost more than the prediction */
+		log_discard = TRUE;
+		dry_run = TRUE;
+		if(!(dry_ok = run_dry_run((argc > 2) ? argv[2] : PRESET_FILE_DEFAULT, &local_error)))
+		{
+			fprintf(stderr, "dry run: %s\n", local_error->message);
+			g_clear_error(&local_error);
+		}
+		free_resources();
+		ax_parameter_free(param);
+		exit(dry_ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if(argc > 1 && g_strcmp0(argv[1], "--teach") == 0)
+	{
+		teach_seconds = (argc > 2) ? CLAMP(atoi(argv[2]), 1, TEACH_MAX_SECONDS) : TEACH_DEFAULT_SECONDS;
+		if(argc > 3)
+		{
+			g_free(teach_plan_file);
+			teach_plan_file = g_strdup(argv[3]);
+		}
+		status_sample_rate = STATUS_SAMPLE_MAX_HZ;
+	}
+
+	if(argc > 1 && g_strcmp0(argv[1], "--jitter-bench") == 0)
+	{
+		if(argc > 2)
+			jitter_bench_seconds = MAX(atoi(argv[2]), 1);
+		run_jitter_bench();
+		ax_parameter_free(param);
+		exit(EXIT_SUCCESS);
+	}
+
+#ifdef PANORAMATV_SIM
+	if(argc > 1 && g_strcmp0(argv[1], "--soak") == 0)
+	{
+		soak_ticks = (argc > 2) ? MAX(atoi(argv[2]), 100) : SOAK_DEFAULT_TICKS;
+		tick_period_us = SOAK_TICK_PERIOD_US;
+		status_sample_rate = G_USEC_PER_SEC / (SOAK_TICK_PERIOD_US / 2);
+		g_setenv("AXPTZ_SIM_TIMESCALE", SOAK_TIMESCALE, FALSE);
+		log_discard = TRUE;
+		printf("soak: %d ticks of %d us\n", soak_ticks, SOAK_TICK_PERIOD_US);
+	}
+	if(argc > 1 && g_strcmp0(argv[1], "--lap-bench") == 0)
+	{
+		lap_bench_laps = (argc > 2) ? MAX(atoi(argv[2]), 1) : LAP_BENCH_DEFAULT_LAPS;
+		tick_period_us = SLEEP_TIME_MILLISECONDS * 1000 / LAP_BENCH_TIMESCALE;
+		status_sample_rate = G_USEC_PER_SEC / (tick_period_us / 2);
+		g_setenv("AXPTZ_SIM_TIMESCALE", G_STRINGIFY(LAP_BENCH_TIMESCALE), FALSE);
+		log_discard = TRUE;
+		printf("lap bench: %d laps per segment mode\n", lap_bench_laps);
+	}
+#endif
+
+	start_log_thread();
+
+	if(trace_mode)
+	{
+		if(!trace_open(trace_file, trace_capacity, &local_error))
+		{
+			goto failure;
+		}
+		LOGINFO("Tracing %d records to %s", trace_capacity, trace_file);
+	}
+
+	if(status_snapshot_mode)
+	{
+		if(!status_snapshot_open(&local_error))
+		{
+			goto failure;
+		}
+		status_snapshot.start_us = g_get_monotonic_time();
+		status_snapshot.pid = getpid();
+		publish_status(STATUS_STATE_STARTING, 0, NULL, NULL);
+		LOGINFO("Status snapshot in shared memory %s", STATUS_SNAPSHOT_NAME);
+	}
   
 	/* Create the axptz library */
 	if (!(ax_ptz_create(&local_error))) 
@@ -855,276 +5173,102 @@ int main(int argc, char **argv)
 	}
   
 	/* Get the current status (e.g. the current pan/tilt/zoom value/position) */
-	if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_status, &local_error))) 
+	if (!(get_ptz_status_and_limits())) 
 	{
 		goto failure;
 	}
+	trace_write(TRACE_CONFIG, (motion_pan_wraps() ? TRACE_CONFIG_PAN_WRAPS : 0) | (g_strcmp0(MOTION_MATH_BACKEND, "float") == 0 ? TRACE_CONFIG_FLOAT_MATH : 0), fx_ftox(cont_max_speed, FIXMATH_FRAC_BITS), MOTION_PAN_TILT_ARRIVAL_UNITS, (gint32)tick_period_us, blend_tolerance, pan_limit_min, pan_limit_max);
+	traced_max_speed = fx_ftox(cont_max_speed, FIXMATH_FRAC_BITS);
 	
-	LOGINFO("Current Camera PTZ unitless pos - PAN:%d , TILT:%d , ZOOM:%d" , unitless_status->pan_value , unitless_status->tilt_value , unitless_status->zoom_value);
+	LOGINFO("Now we got the current PTZ limits.\n");
 	
-	AXPTZLimits *unitless_limits = NULL;
-	/* Get the pan, tilt and zoom limits for the unitless space */
-	if ((ax_ptz_movement_handler_get_ptz_limits(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS , AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_limits, &local_error))) 
-	{
-		LOGINFO("Limits pan max: %d, pan min: %d, tilt max: %d, tilt min: %d, zoom max: %d, zoom min: %d", unitless_limits->max_pan_value, unitless_limits->min_pan_value, unitless_limits->max_tilt_value, unitless_limits->min_tilt_value, unitless_limits->max_zoom_value, unitless_limits->min_zoom_value);
-		//Limits pan max: 32768, pan min: -32768, tilt max: 3641, tilt min: -16384, zoom max: 35748, zoom min: 3
-		// 32768 => 180
-		//-32768 => -180
-		//  3641 => 20
-		//-16384 => -90
-		// 35748 => 24 32768 => 12 32768 ~ 35748 => 12 ~ 24
-		//     3 => 1
-		
-	} 
-	else 
+	if(teach_seconds > 0)
 	{
-		goto failure;
+		/* the operator has the camera, nothing is sent to it */
+		gboolean teach_ok;
+
+		if(!start_status_sampler())
+		{
+			goto failure;
+		}
+		teach_ok = record_teach_plan(teach_seconds, teach_plan_file, &local_error);
+		stop_status_sampler();
+		if(!teach_ok)
+		{
+			goto failure;
+		}
 	}
-	g_free(unitless_limits);
-	unitless_limits = NULL;
-	
-	LOGINFO("Now we got the current PTZ limits.\n");
-	
 	/* Get the supported capabilities */
-	if (is_capability_supported("AX_PTZ_MOVE_ABS_PAN") && is_capability_supported("AX_PTZ_MOVE_ABS_TILT") && is_capability_supported("AX_PTZ_MOVE_ABS_ZOOM") && is_capability_supported("AX_PTZ_MOVE_CONT_PAN") && is_capability_supported("AX_PTZ_MOVE_CONT_TILT") && is_capability_supported("AX_PTZ_MOVE_CONT_ZOOM")) 
+	else if (is_capability_supported("AX_PTZ_MOVE_ABS_PAN") && is_capability_supported("AX_PTZ_MOVE_ABS_TILT") && is_capability_supported("AX_PTZ_MOVE_ABS_ZOOM") && is_capability_supported("AX_PTZ_MOVE_CONT_PAN") && is_capability_supported("AX_PTZ_MOVE_CONT_TILT") && is_capability_supported("AX_PTZ_MOVE_CONT_ZOOM")) 
 	{    
 		/*Get the position info from presets*/
+		publish_status(STATUS_STATE_CALIBRATING, 0, NULL, NULL);
+		load_settle_hints(PRESET_FILE_DEFAULT);
 		get_path();
-		LOGINFO("Preset Count - %d", preset_count);
-		if(preset_count > 1)
+		if(scan_mode)
+			add_scan_profile();
+		if(teach_mode)
+			add_teach_profile();
+		LOGINFO("Tour profiles - %d", tour_profile_count);
+		if(tour_profile_count > 0)
 		{
 			gint i = 0;
 			LOGINFO("Getting preset position info BEGIN");
-			for(i = 0 ; i < preset_count ; i ++)
+			for(i = 0 ; i < tour_profile_count ; i ++)
 			{
-				LOGINFO("i%d", i);
-				LOGINFO("number%d" , preset_numbers[i]);
-				LOGINFO("index%d" , preset_indices[i]);
-				if(!ax_ptz_preset_handler_goto_preset_number(ax_ptz_control_queue_group ,VIDEO_CHANNEL , preset_indices[i] , fx_ftox(0.4f, FIXMATH_FRAC_BITS) , AX_PTZ_PRESET_MOVEMENT_UNITLESS , AX_PTZ_INVOKE_ASYNC , NULL , NULL , &local_error))
+				if(!calibrate_tour_profile(&tour_profiles[i]))
 				{
-					LOGINFO(local_error->message);
 					goto failure;
 				}
-				LOGINFO("Move to preset%d position started" , preset_indices[i]);
-				usleep(SLEEP_TIME_MILLISECONDS * 1000); 
-	  
-				if(!wait_for_camera_movement_to_finish())
-				{
-					goto failure;
-				}
-				LOGINFO("Move to preset%d position Ended - user defined order%d" , preset_indices[i], preset_numbers[i]);
-				//get preset position info
-				/* Get the current status (e.g. the current pan/tilt/zoom value/position) */
-				unitless_status = NULL;
-				if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_status, &local_error))) 
-				{
-					goto failure;
-				}	
-				PTZ_POS* pos = g_malloc(sizeof(PTZ_POS));
-				pos->pan_val = unitless_status->pan_value;
-				pos->tilt_val = unitless_status->tilt_value;
-				pos->zoom_val = unitless_status->zoom_value;
-				tempPath = g_list_append(tempPath , pos);
-				LOGINFO("PRESETNO:%d , PAN:%d , TILT:%d , ZOOM:%d" , preset_indices[i] , unitless_status->pan_value , unitless_status->tilt_value , unitless_status->zoom_value);
-	
-			}
-			if(preset_count > 1)
-			{
-				for(i = preset_count - 2 ; i > 0 ; i --)
-				{
-					LOGINFO("number%d" , preset_numbers[i]);
-					LOGINFO("index%d" , preset_indices[i]);
-					if(!ax_ptz_preset_handler_goto_preset_number(ax_ptz_control_queue_group ,VIDEO_CHANNEL , preset_indices[i] , fx_ftox(0.4f, FIXMATH_FRAC_BITS) , AX_PTZ_PRESET_MOVEMENT_UNITLESS , AX_PTZ_INVOKE_ASYNC , NULL , NULL , &local_error))
-					{
-						LOGINFO(local_error->message);
-						goto failure;
-					}
-					LOGINFO("Move to preset%d position Ended - user defined order%d" , preset_indices[i], preset_numbers[i]);
-					usleep(SLEEP_TIME_MILLISECONDS * 1000); 
-				
-					if(!wait_for_camera_movement_to_finish())
-					{
-						goto failure;
-					}
-					LOGINFO("Move to preset%d position Ended" , preset_indices[i]);
-					//get preset position info
-					/* Get the current status (e.g. the current pan/tilt/zoom value/position) */
-					unitless_status = NULL;
-					if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &unitless_status, &local_error))) 
-					{
-						goto failure;
-					}
-					PTZ_POS* pos = g_malloc(sizeof(PTZ_POS));
-					pos->pan_val = unitless_status->pan_value;
-					pos->tilt_val = unitless_status->tilt_value;
-					pos->zoom_val = unitless_status->zoom_value;
-					tempPath = g_list_append(tempPath , pos);
-					LOGINFO("PRESETNO:%d , PAN:%d , TILT:%d , ZOOM:%d" , preset_count * 2 - preset_indices[i] , unitless_status->pan_value , unitless_status->tilt_value , unitless_status->zoom_value);
-				}
 			}
 			LOGINFO("Getting preset position info END");
-			LOGINFO("Completing circular path BEGIN");
-			
-			get_circular_path();
+			write_preset_file(PRESET_FILE_DEFAULT);
 
-			LOGINFO("number of paths: %d", g_list_length(realPath));	
-      
-			LOGINFO("Completing circular path END");
+			active_profile = MAX(find_tour_profile(tour_profile_name), 0);
+			g_atomic_int_set(&requested_profile, active_profile);
+			realPath = tour_profiles[active_profile].path;
+			LOGINFO("Active tour profile %s, %d waypoints", tour_profiles[active_profile].name, g_list_length(realPath));
+			if(!ax_parameter_register_callback(param, "TourProfile", tour_profile_changed, NULL, &local_error))
+			{
+				LOGINFO("CAN NOT WATCH TourProfile: %s", local_error->message);
+				g_clear_error(&local_error);
+			}
     
-			LOGINFO("Endless tour along the presets BEGIN");
-      
-			gboolean isRunning = TRUE;
-      
-			while(isRunning)
+			if(rt_mode && rt_lock_memory)
 			{
-				gint count = 0;
-	
-				LOGINFO("number of paths: %d", g_list_length(realPath));	
-	
-				for(it = g_list_first(realPath) ; it != NULL ; it = g_list_next(it))
-				{	
-	  
-					/*NECESSARY PART*/
-					/* Request for dropping the PTZ control */
-					if (!(ax_ptz_control_queue_request(ax_ptz_control_queue_group, VIDEO_CHANNEL, AX_PTZ_CONTROL_QUEUE_DROP, &queue_pos, &time_to_pos_one, &poll_time, &local_error))) 
-					{
-						goto failure;
-					}
-
-					LOGINFO("Request AX_PTZ_CONTROL_QUEUE_DROP:\n");
-					LOGINFO("queue_pos = %d\n", queue_pos);
-					LOGINFO("time_to_pos_one = %d\n", time_to_pos_one);
-					LOGINFO("poll_time = %d\n", poll_time);
+				if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+					LOGINFO("CAN NOT LOCK MEMORY: %s", strerror(errno));
+			}
 
-					/* Get the PTZ control queue status for the application */
-					if (!(ax_ptz_control_queue_request(ax_ptz_control_queue_group, VIDEO_CHANNEL, AX_PTZ_CONTROL_QUEUE_GET, &queue_pos, &time_to_pos_one, &poll_time, &local_error))) 
-					{	
-						goto failure;
-					}
-
-					LOGINFO("Request AX_PTZ_CONTROL_QUEUE_GET:\n");
-					LOGINFO("queue_pos = %d\n", queue_pos);
-					LOGINFO("time_to_pos_one = %d\n", time_to_pos_one);
-					LOGINFO("poll_time = %d\n", poll_time);	
-	  
-					/* Get the application group from the PTZ control queue */
-					if (!(ax_ptz_control_queue_group = ax_ptz_control_queue_get_app_group_instance(&local_error))) 
-					{	
-						goto failure;
-					}
-					/*NECESSARY PART*/
-	  
-					count ++;
-					LOGINFO("Go to Path Number:%d , PAN:%d , TILT:%d , ZOOM:%d" , count , ((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(it->data))->tilt_val , ((PTZ_POS*)(it->data))->zoom_val);
-					PTZ_POS posFrom;
-					AXPTZStatus* ptz_status = NULL;
-					if (!(ax_ptz_movement_handler_get_ptz_status(VIDEO_CHANNEL, AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS, AX_PTZ_MOVEMENT_ZOOM_UNITLESS, &ptz_status, &local_error))) 
-					{
-						g_free(ptz_status);
-						LOGINFO(local_error->message);
-						g_error_free(local_error);
-						return FALSE;
-					}
-	  
-					posFrom.pan_val = ptz_status->pan_value;
-					posFrom.tilt_val = ptz_status->tilt_value;
-					posFrom.zoom_val = ptz_status->zoom_value;
-					LOGINFO("Position From PAN:%d , TILT:%d , ZOOM:%d" , posFrom.pan_val , posFrom.tilt_val , posFrom.zoom_val);
-	  
-					LOGINFO("arrival_accuracy : %d" , arrival_accuracy);
-	  
-					LOGINFO("Setting speeds BEGIN");
-					fixed_t pan_speed = fx_subx(((PTZ_POS*)(it->data))->pan_val , posFrom.pan_val);
-					fixed_t pan_speed1 = pan_speed;
-					if(pan_speed1 < 0)
-						pan_speed1 = -pan_speed1;
-
-					fixed_t tilt_speed = fx_subx(((PTZ_POS*)(it->data))->tilt_val , posFrom.tilt_val);
-					fixed_t tilt_speed1 = tilt_speed;
-					if(tilt_speed1 < 0)
-						tilt_speed1 = -tilt_speed1;
-	
-					fixed_t zoom_speed = /*fx_divx(*/fx_subx(((PTZ_POS*)(it->data))->zoom_val , posFrom.zoom_val);/* , fx_itox(3 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);*/
-					fixed_t zoom_speed1 = zoom_speed;
-					if(zoom_speed < 0)
-						zoom_speed1 = -zoom_speed1;
-	
-					if(pan_speed1 >= tilt_speed1 && pan_speed1 >= zoom_speed1)
-					{
-						if(pan_speed1 > 0)
-						{
-							pan_speed1 = fx_ftox(cont_max_speed , FIXMATH_FRAC_BITS);
-							if(pan_speed < 0)
-								pan_speed1 = -pan_speed1;
-								
-							tilt_speed1 = fx_mulx(fx_divx(fx_mulx(tilt_speed , pan_speed1 , FIXMATH_FRAC_BITS) , pan_speed , FIXMATH_FRAC_BITS) , fx_ftox(1.4f , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);
-							zoom_speed1 = fx_mulx(fx_divx(fx_mulx(zoom_speed , pan_speed1 , FIXMATH_FRAC_BITS) , pan_speed , FIXMATH_FRAC_BITS) , fx_ftox(1.4f , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);
-						}
-					}
-					else if(tilt_speed1 >= pan_speed1 && tilt_speed1 >= zoom_speed1)
-					{
-						if(tilt_speed1 > 0)
-						{
-							tilt_speed1 = fx_ftox(cont_max_speed , FIXMATH_FRAC_BITS);
-							if(tilt_speed < 0)
-								tilt_speed1 = -tilt_speed1;
-							pan_speed1 = fx_divx(fx_mulx(pan_speed , tilt_speed1 , FIXMATH_FRAC_BITS) , tilt_speed , FIXMATH_FRAC_BITS);
-
-							zoom_speed1 = fx_mulx(fx_divx(fx_mulx(zoom_speed , tilt_speed1 , FIXMATH_FRAC_BITS) , tilt_speed , FIXMATH_FRAC_BITS) , fx_ftox(1.4f , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);
-						  
-							tilt_speed1 = fx_mulx(tilt_speed1 , fx_ftox(1.4f , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);
-						}
-					}
-					else if(zoom_speed1 >= pan_speed1 && zoom_speed1 >= tilt_speed1)
-					{
-						if(zoom_speed1 > 0)
-						{
-							zoom_speed1 = fx_ftox(cont_max_speed , FIXMATH_FRAC_BITS);
-							if(zoom_speed < 0)
-								zoom_speed1 = -zoom_speed1;
-							tilt_speed1 = fx_mulx(fx_divx(fx_mulx(tilt_speed , zoom_speed1 , FIXMATH_FRAC_BITS) , zoom_speed , FIXMATH_FRAC_BITS) , fx_ftox(1.4f , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);
-
-							pan_speed1 = fx_divx(fx_mulx(pan_speed , zoom_speed1 , FIXMATH_FRAC_BITS) , zoom_speed , FIXMATH_FRAC_BITS);
-							
-							zoom_speed1 = fx_mulx(zoom_speed1 , fx_ftox(1.4f , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);
-
-						}
-					}
-	
-					LOGINFO("PAN SPEED: %f , TILT_SPEED: %f , ZOOM_SPEED: %f" , fx_xtof(pan_speed1, FIXMATH_FRAC_BITS) , fx_xtof(tilt_speed1, FIXMATH_FRAC_BITS) , fx_xtof(zoom_speed1, FIXMATH_FRAC_BITS));
-					LOGINFO("PAN SPEED: %d , TILT_SPEED: %d , ZOOM_SPEED: %d" , pan_speed1, tilt_speed1, zoom_speed1);
-					LOGINFO("MAX SPEED: %f", cont_max_speed);
-					LOGINFO("MAX SPEED %d", fx_ftox(cont_max_speed, FIXMATH_FRAC_BITS));
-	
-					LOGINFO("Setting speeds END");
-	  
-					if (!(start_continous_movement(pan_speed1, tilt_speed1,  AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS, zoom_speed1, 600.0f))) 
-					{
-						LOGINFO("Error occured during starting continuouse move");
-						goto failure;
-					}
+			if(!start_status_sampler())
+			{
+				goto failure;
+			}
 
-					usleep(20 * 1000);
+			if(interrupt_mode && !start_interrupt_listener(&local_error))
+			{
+				goto failure;
+			}
 
-					LOGINFO("Move to No%d position started" , count);
-					if(!wait_for_camera_arrive_to_specific_pos(((PTZ_POS*)(it->data))->pan_val , ((PTZ_POS*)(it->data))->tilt_val , ((PTZ_POS*)(it->data))->zoom_val , pan_speed1 , tilt_speed1 , zoom_speed1))
-					{
-						LOGINFO("Error occured during waiting");
-						goto failure;
-					}
-					LOGINFO("Move to No%d position Ended" , count);
-	  
-					LOGINFO("STOPPING IN PRESET BEGIN");
-					if(NPT == 0)
-						usleep(preset_delay[count - 1] * 1000);//stop in preset for stop_in_preset sec
-					else if(count % (NPT + 1) == 1)
-						usleep(preset_delay[count / (NPT + 1)] * 1000);//stop in preset for stop_in_preset sec
-					LOGINFO("STOPPING IN PRESET ENDED");
-				}
+			if(sync_mode != SYNC_OFF && !tour_sync_open(sync_group, sync_port, sync_mode == SYNC_LEADER, SYNC_ANNOUNCE_MS, &local_error))
+			{
+				goto failure;
+			}
 
+			gboolean tour_ok;
+#ifdef PANORAMATV_SIM
+			if(lap_bench_laps > 0)
+				tour_ok = run_lap_bench();
+			else
+#endif
+			tour_ok = run_tour();
+			tour_sync_close();
+			stop_interrupt_listener();
+			stop_status_sampler();
+			if(!tour_ok)
+			{
+				goto failure;
 			}
-      
-			LOGINFO("Endless tour along the presets END");
 		}
 		else
 		{
@@ -1169,44 +5313,19 @@ int main(int argc, char **argv)
 
 	/* Perform cleanup */
 
-	if (local_error) 
-	{
-		g_error_free(local_error);
-		local_error = NULL;
-	}
-	
-	if (capabilities) 
-	{
-
-		for (it = g_list_first(capabilities); it != NULL; it = g_list_next(it)) 
-		{
-			g_free((gchar *) it->data);
-		}
-	}
-
-	if(realPath)
-	{
-		for (it = g_list_first(realPath); it != NULL; it = g_list_next(it)) 
-		{
-			g_free((gchar *) it->data);
-		}
-	}
-	if(tempPath)
-	{
-		for (it = g_list_first(tempPath); it != NULL; it = g_list_next(it)) 
-		{
-			g_free((gchar *) it->data);
-		}
-	}
-  
-	g_list_free(capabilities);
-	capabilities = NULL;
-	g_free(unitless_status);
-	unitless_status = NULL;
+	g_clear_error(&local_error);
+	free_resources();
 
 	ax_parameter_free(param);
 	param = NULL;
 
+	stop_log_thread();
+
+#ifdef PANORAMATV_SIM
+	if(soak_ticks > 0 && !soak_passed())
+		exit(EXIT_FAILURE);
+#endif
+
 	exit(EXIT_SUCCESS);
 
 /* We will end up here if something went wrong */
@@ -1218,56 +5337,25 @@ failure:
 		LOGINFO("%s\n", local_error->message);
 	}
 
-	if (local_error) 
-	{
-		g_error_free(local_error);
-		local_error = NULL;
-	}
+	g_clear_error(&local_error);
+
+	tour_sync_close();
+	stop_interrupt_listener();
+	stop_status_sampler();
 
 	/* Now we don't need the axptz library anymore, destroy it */
 	ax_ptz_destroy(&local_error);
 
 	/* Perform cleanup */
 
-	if (local_error) 
-	{
-		g_error_free(local_error);
-		local_error = NULL;
-	}
-
-	if (capabilities) 
-	{
-		for (it = g_list_first(capabilities); it != NULL; it = g_list_next(it)) 
-		{
-		g_free((gchar *) it->data);
-		}
-	}
-  
-	if(tempPath)
-	{
-		for (it = g_list_first(tempPath); it != NULL; it = g_list_next(it)) 
-		{
-			g_free((gchar *) it->data);
-		}
-	}
-	if(realPath)
-	{
-		for (it = g_list_first(realPath); it != NULL; it = g_list_next(it)) 
-		{
-			g_free((gchar *) it->data);
-		}
-	}
-	g_list_free(tempPath);
-	g_list_free(realPath);
-	g_list_free(capabilities);
-	capabilities = NULL;
-	g_free(unitless_status);
-	unitless_status = NULL;
-
+	g_clear_error(&local_error);
+	free_resources();
 
 	ax_parameter_free(param);
 	param = NULL;
 
+	stop_log_thread();
+
 #ifdef WRITE_TO_SYS_LOG
 	closelog();
 #endif
@@ -0,0 +1,172 @@
+/*
+ * Lap plans of budgeted and synchronized tours.
+ *
+ * The departures are filled in by the tour from its segment predictions;
+ * this file keeps the plan on the clock and does the budget arithmetic:
+ * the lowest max speed that fits a transit, the share of the slack or the
+ * deficit each dwell gets, and the model that scales the predictions by
+ * the transit the laps really took.
+ */
+
+#include <math.h>
+#include "lap_plan.h"
+
+#define LAP_BUDGET_SPEED_STEPS 16
+#define LAP_BUDGET_MODEL_GAIN 0.5
+#define LAP_BUDGET_MODEL_MIN 0.5
+#define LAP_BUDGET_MODEL_MAX 4.0
+
+/*
+ * Start a plan of <length> waypoints for the <profile>-th tour profile
+ */
+void lap_plan_reset(LAP_PLAN *plan, gint profile, gint length, gdouble us_per_ms)
+{
+	g_free(plan->departure);
+	plan->departure = g_new0(gdouble, length + 1);
+	plan->length = 0;
+	plan->profile = profile;
+	plan->lap = 0;
+	plan->transit = 0;
+	plan->us_per_ms = us_per_ms;
+	plan->start_us = 0;
+}
+
+/*
+ * Plan the next waypoint, reached after <transit> and left after <dwell>
+ * more camera seconds
+ */
+void lap_plan_add(LAP_PLAN *plan, gdouble transit, gdouble dwell)
+{
+	plan->transit += transit;
+	plan->lap += transit + dwell;
+	plan->departure[++ plan->length] = plan->lap;
+}
+
+void lap_plan_clear(LAP_PLAN *plan)
+{
+	g_free(plan->departure);
+	plan->departure = NULL;
+	plan->length = 0;
+	plan->profile = -1;
+	plan->lap = 0;
+	plan->transit = 0;
+	plan->start_us = 0;
+}
+
+/*
+ * Run the lap that starts at <start_us> on the plan as predicted
+ */
+void lap_plan_start(LAP_PLAN *plan, gint64 start_us)
+{
+	plan->stretch = 1.0;
+	plan->start_us = start_us;
+	plan->dwell_ms = 0;
+}
+
+/*
+ * Run the lap on the slot of <schedule> nearest to <now_us>, shifted by
+ * <phase> of the period, with the plan stretched to the period. Returns
+ * how far the lap starts off the slot.
+ */
+gint64 lap_plan_sync(LAP_PLAN *plan, const TOUR_SYNC_SCHEDULE *schedule, gfloat phase, gint64 now_us)
+{
+	gint64 slot = schedule->epoch_us + (gint64)(phase * schedule->period_us);
+
+	slot += (gint64)floor((now_us - slot) / (gdouble)schedule->period_us + 0.5) * schedule->period_us;
+	plan->stretch = schedule->period_us / MAX(plan->lap * 1000 * plan->us_per_ms, 1);
+	plan->start_us = slot;
+	plan->dwell_ms = 0;
+	return now_us - slot;
+}
+
+/*
+ * Planned departure from the <count>-th waypoint on the clock
+ */
+static gint64 lap_plan_departure_us(const LAP_PLAN *plan, gint count)
+{
+	return plan->start_us + (gint64)(plan->departure[count] * 1000 * plan->us_per_ms * plan->stretch);
+}
+
+/*
+ * How far behind its departure the segment to the <count>-th waypoint
+ * starts at <now_us>, G_MININT64 while the lap runs off the plan
+ */
+gint64 lap_plan_late_us(const LAP_PLAN *plan, gint count, gint64 now_us)
+{
+	if(plan->start_us == 0 || count > plan->length)
+		return G_MININT64;
+	return now_us - lap_plan_departure_us(plan, count - 1);
+}
+
+/*
+ * Dwell at the <count>-th waypoint from <now_us> until its departure, at
+ * most <max_us>; -1 while the lap runs off the plan
+ */
+gint64 lap_plan_dwell_us(LAP_PLAN *plan, gint count, gint64 now_us, gint64 max_us)
+{
+	gint64 dwell_us;
+
+	if(plan->start_us == 0 || count > plan->length)
+		return -1;
+	dwell_us = CLAMP(lap_plan_departure_us(plan, count) - now_us, 0, max_us);
+	plan->dwell_ms += (gint64)(dwell_us / plan->us_per_ms);
+	return dwell_us;
+}
+
+/*
+ * The lowest max speed between <low> and <high> that takes the lap in
+ * <seconds> of <transit>, <high> when none does
+ */
+gfloat lap_budget_solve_speed(LAP_TRANSIT_FUNC transit, gpointer data, gdouble seconds, gfloat low, gfloat high)
+{
+	gint i;
+
+	if(transit(high, data) > seconds)
+		return high;
+	for(i = 0 ; i < LAP_BUDGET_SPEED_STEPS ; i ++)
+	{
+		gfloat mid = (low + high) / 2;
+
+		if(transit(mid, data) > seconds)
+			low = mid;
+		else
+			high = mid;
+	}
+	return high;
+}
+
+/*
+ * Dwells for a lap of <target> camera seconds with <transit> of them
+ * moving: the slack is shared out over the <count> dwells in proportion to
+ * their <delay_ms>, evenly when all are 0, and a deficit cuts them in
+ * proportion
+ */
+void lap_budget_share_dwells(const gint *delay_ms, gint *budget_ms, gint count, gdouble transit, gdouble target)
+{
+	gdouble dwell = 0;
+	gdouble slack;
+	gint i;
+
+	for(i = 0 ; i < count ; i ++)
+		dwell += delay_ms[i] / 1000.0;
+	slack = target - transit - dwell;
+	for(i = 0 ; i < count ; i ++)
+	{
+		gdouble delay = delay_ms[i] / 1000.0;
+
+		if(slack < 0)
+			delay = (dwell > 0) ? delay * MAX(target - transit, 0) / dwell : 0;
+		else
+			delay += (dwell > 0) ? slack * delay / dwell : slack / count;
+		budget_ms[i] = (gint)(delay * 1000);
+	}
+}
+
+/*
+ * The prediction model after a lap that took <transit> of <planned>
+ * camera seconds moving
+ */
+gdouble lap_budget_learn(gdouble model, gdouble transit, gdouble planned)
+{
+	return CLAMP((1.0 - LAP_BUDGET_MODEL_GAIN) * model + LAP_BUDGET_MODEL_GAIN * model * transit / planned, LAP_BUDGET_MODEL_MIN, LAP_BUDGET_MODEL_MAX);
+}
@@ -0,0 +1,48 @@
+/*
+ * Lap plans of budgeted and synchronized tours.
+ *
+ * A plan is the predicted departure from every waypoint of a lap, in
+ * camera seconds from the lap start. A lap on the plan is anchored to a
+ * start on the monotonic clock, stretched for a synchronized lap from the
+ * predicted lap to the schedule's period, and dwells at each waypoint
+ * until its departure. Camera time runs <us_per_ms> real microseconds per
+ * millisecond, so the host build's faster model clock plans in model time.
+ */
+#ifndef __LAP_PLAN_H__
+#define __LAP_PLAN_H__
+
+#include <glib.h>
+#include "tour_sync.h"
+
+typedef struct LAP_PLAN{
+
+	gdouble *departure;	/* [n] camera seconds from the lap start to leaving the n-th waypoint */
+	gint length;		/* waypoints planned */
+	gint profile;		/* tour profile planned, -1 for none */
+	gdouble lap;		/* predicted transit and dwells, camera seconds */
+	gdouble transit;	/* predicted transit alone, camera seconds */
+	gdouble us_per_ms;	/* real microseconds per camera millisecond */
+	gdouble stretch;	/* lap on the clock over the predicted one */
+	gint64 start_us;	/* lap start, 0 while the lap runs off the plan */
+	gint64 dwell_ms;	/* dwelt so far in the lap */
+
+}LAP_PLAN;
+
+#define LAP_PLAN_INIT { NULL, 0, -1, 0, 0, 1000, 1.0, 0, 0 }
+
+/* predicted transit of a lap at <max_speed>, camera seconds */
+typedef gdouble (*LAP_TRANSIT_FUNC)(gfloat max_speed, gpointer data);
+
+void lap_plan_reset(LAP_PLAN *plan, gint profile, gint length, gdouble us_per_ms);
+void lap_plan_add(LAP_PLAN *plan, gdouble transit, gdouble dwell);
+void lap_plan_clear(LAP_PLAN *plan);
+void lap_plan_start(LAP_PLAN *plan, gint64 start_us);
+gint64 lap_plan_sync(LAP_PLAN *plan, const TOUR_SYNC_SCHEDULE *schedule, gfloat phase, gint64 now_us);
+gint64 lap_plan_late_us(const LAP_PLAN *plan, gint count, gint64 now_us);
+gint64 lap_plan_dwell_us(LAP_PLAN *plan, gint count, gint64 now_us, gint64 max_us);
+
+gfloat lap_budget_solve_speed(LAP_TRANSIT_FUNC transit, gpointer data, gdouble seconds, gfloat low, gfloat high);
+void lap_budget_share_dwells(const gint *delay_ms, gint *budget_ms, gint count, gdouble transit, gdouble target);
+gdouble lap_budget_learn(gdouble model, gdouble transit, gdouble planned);
+
+#endif
@@ -0,0 +1,495 @@
+/*
+ * Segment speed planning and arrival decisions of the tour
+ */
+
+#include "motion.h"
+#include "motion_math.h"
+
+/* endless pan: pan positions are taken modulo the full circle */
+static gboolean pan_wraps = FALSE;
+static fixed_t pan_min = 0;
+static fixed_t pan_range = 0;
+
+/*
+ * Turn on wrap-aware pan math for a camera whose pan limits <min_pan> and
+ * <max_pan> are the same direction (one full turn apart)
+ */
+void motion_set_pan_wrap(gboolean wraps, fixed_t min_pan, fixed_t max_pan)
+{
+	pan_wraps = wraps && max_pan > min_pan;
+	pan_min = min_pan;
+	pan_range = max_pan - min_pan;
+}
+
+gboolean motion_pan_wraps(void)
+{
+	return pan_wraps;
+}
+
+/*
+ * Signed pan travel from <from> to <to>, the short way round the seam
+ * when pan wraps
+ */
+fixed_t motion_pan_delta(fixed_t from, fixed_t to)
+{
+	fixed_t delta = fx_subx(to , from);
+
+	if(!pan_wraps)
+		return delta;
+	delta %= pan_range;
+	if(delta > pan_range / 2)
+		delta -= pan_range;
+	else if(delta < -pan_range / 2)
+		delta += pan_range;
+	return delta;
+}
+
+/*
+ * Pan position folded back into the limits when pan wraps
+ */
+fixed_t motion_pan_wrap(fixed_t pan)
+{
+	if(!pan_wraps)
+		return pan;
+	pan = (pan - pan_min) % pan_range;
+	if(pan < 0)
+		pan += pan_range;
+	return pan_min + pan;
+}
+
+/*
+ * Continuous speeds that take all three axes from <from> to <to> at the
+ * same time. The axis with the longest way gets max_speed, the others are
+ * scaled by their share of the way; tilt and zoom get 1.4 times that since
+ * their full speed is slower than pan's.
+ */
+void motion_segment_speeds(const PTZ_POS *from, const PTZ_POS *to, gfloat max_speed, fixed_t *pan_speed_out, fixed_t *tilt_speed_out, fixed_t *zoom_speed_out)
+{
+	fixed_t pan_speed = motion_pan_delta(from->pan_val , to->pan_val);
+	fixed_t pan_speed1 = pan_speed;
+	if(pan_speed1 < 0)
+		pan_speed1 = -pan_speed1;
+
+	fixed_t tilt_speed = fx_subx(to->tilt_val , from->tilt_val);
+	fixed_t tilt_speed1 = tilt_speed;
+	if(tilt_speed1 < 0)
+		tilt_speed1 = -tilt_speed1;
+
+	fixed_t zoom_speed = /*fx_divx(*/fx_subx(to->zoom_val , from->zoom_val);/* , fx_itox(3 , FIXMATH_FRAC_BITS) , FIXMATH_FRAC_BITS);*/
+	fixed_t zoom_speed1 = zoom_speed;
+	if(zoom_speed < 0)
+		zoom_speed1 = -zoom_speed1;
+
+	if(pan_speed1 >= tilt_speed1 && pan_speed1 >= zoom_speed1)
+	{
+		if(pan_speed1 > 0)
+		{
+			pan_speed1 = fx_ftox(max_speed , FIXMATH_FRAC_BITS);
+			if(pan_speed < 0)
+				pan_speed1 = -pan_speed1;
+				
+			tilt_speed1 = motion_math_mul(motion_math_scale(tilt_speed , pan_speed1 , pan_speed) , fx_ftox(1.4f , FIXMATH_FRAC_BITS));
+			zoom_speed1 = motion_math_mul(motion_math_scale(zoom_speed , pan_speed1 , pan_speed) , fx_ftox(1.4f , FIXMATH_FRAC_BITS));
+		}
+	}
+	else if(tilt_speed1 >= pan_speed1 && tilt_speed1 >= zoom_speed1)
+	{
+		if(tilt_speed1 > 0)
+		{
+			tilt_speed1 = fx_ftox(max_speed , FIXMATH_FRAC_BITS);
+			if(tilt_speed < 0)
+				tilt_speed1 = -tilt_speed1;
+			pan_speed1 = motion_math_scale(pan_speed , tilt_speed1 , tilt_speed);
+
+			zoom_speed1 = motion_math_mul(motion_math_scale(zoom_speed , tilt_speed1 , tilt_speed) , fx_ftox(1.4f , FIXMATH_FRAC_BITS));
+		  
+			tilt_speed1 = motion_math_mul(tilt_speed1 , fx_ftox(1.4f , FIXMATH_FRAC_BITS));
+		}
+	}
+	else if(zoom_speed1 >= pan_speed1 && zoom_speed1 >= tilt_speed1)
+	{
+		if(zoom_speed1 > 0)
+		{
+			zoom_speed1 = fx_ftox(max_speed , FIXMATH_FRAC_BITS);
+			if(zoom_speed < 0)
+				zoom_speed1 = -zoom_speed1;
+			tilt_speed1 = motion_math_mul(motion_math_scale(tilt_speed , zoom_speed1 , zoom_speed) , fx_ftox(1.4f , FIXMATH_FRAC_BITS));
+
+			pan_speed1 = motion_math_scale(pan_speed , zoom_speed1 , zoom_speed);
+			
+			zoom_speed1 = motion_math_mul(zoom_speed1 , fx_ftox(1.4f , FIXMATH_FRAC_BITS));
+
+		}
+	}
+
+	*pan_speed_out = pan_speed1;
+	*tilt_speed_out = tilt_speed1;
+	*zoom_speed_out = zoom_speed1;
+}
+
+gboolean motion_pan_arrived(fixed_t pan_pos, fixed_t pan_val, fixed_t pan_speed)
+{
+	/* pan left to go, measured across the seam when pan wraps */
+	fixed_t remaining = motion_pan_delta(pan_pos , pan_val);
+
+	if(pan_speed > 0)
+	{
+		//arrival accuracy = pan_speed / 10(time interval 100ms)
+
+		if(remaining <= MOTION_PAN_TILT_ARRIVAL_UNITS/*fx_mulx(pan_speed, fx_ftox(0.0514f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/)// 360 / 700 * 0.1
+			return TRUE;
+	}
+	else
+	{
+		if(remaining >= -MOTION_PAN_TILT_ARRIVAL_UNITS/*fx_mulx(pan_speed, fx_ftox(-0.0514f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+gboolean motion_tilt_arrived(fixed_t tilt_pos, fixed_t tilt_val, fixed_t tilt_speed)
+{
+	if(tilt_speed > 0)
+	{
+
+		if(tilt_pos >= fx_subx(tilt_val , MOTION_PAN_TILT_ARRIVAL_UNITS/*fx_mulx(tilt_speed, fx_ftox(0.072f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/))// 360 / 500 * 0.1
+			return TRUE;
+	}
+	else
+	{
+		if(tilt_pos <= fx_addx(tilt_val , MOTION_PAN_TILT_ARRIVAL_UNITS/*fx_mulx(tilt_speed, fx_ftox(-0.072f, FIXMATH_FRAC_BITS), FIXMATH_FRAC_BITS)*/))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+gboolean motion_zoom_arrived(fixed_t zoom_pos, fixed_t zoom_val, fixed_t zoom_speed)
+{
+	if(zoom_speed > 0)
+	{
+		if(zoom_pos >= fx_subx(zoom_val , motion_math_mul(zoom_speed, fx_ftox(0.05f, FIXMATH_FRAC_BITS))))
+			return TRUE;
+	}
+	else
+	{
+
+		if(zoom_pos <= fx_addx(zoom_val , motion_math_mul(zoom_speed, fx_ftox(-0.05f, FIXMATH_FRAC_BITS))))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Longest single axis travel of a segment
+ */
+fixed_t motion_travel(const PTZ_POS *from, const PTZ_POS *to)
+{
+	fixed_t pan = ABS(motion_pan_delta(from->pan_val , to->pan_val));
+	fixed_t tilt = ABS(fx_subx(to->tilt_val , from->tilt_val));
+	fixed_t zoom = ABS(fx_subx(to->zoom_val , from->zoom_val));
+
+	return MAX(pan , MAX(tilt , zoom));
+}
+
+/*
+ * Pan/tilt distance left to <to>, the larger of the two axes
+ */
+fixed_t motion_residual(const PTZ_POS *to, const STATUS_SAMPLE *sample)
+{
+	fixed_t pan = ABS(motion_pan_delta(sample->pan_val , to->pan_val));
+	fixed_t tilt = ABS(fx_subx(to->tilt_val , sample->tilt_val));
+
+	return MAX(pan , tilt);
+}
+
+/*
+ * One axis of motion_blend_reached: within tolerance of its travel from
+ * the waypoint, or already past it
+ */
+static gboolean blend_axis_reached(fixed_t travel, fixed_t remaining, fixed_t tolerance)
+{
+	if(travel == 0)
+		return TRUE;
+	if((travel > 0 && remaining <= 0) || (travel < 0 && remaining >= 0))
+		return TRUE;
+	if(travel < 0)
+	{
+		travel = -travel;
+		remaining = -remaining;
+	}
+	return remaining <= motion_math_mul(travel , tolerance);
+}
+
+/*
+ * Corner blending at a pass-through waypoint. TRUE once every moving axis
+ * is within <tolerance> (a fraction of the segment travel) of <to>, so the
+ * next segment's speeds can be applied without stopping first.
+ */
+gboolean motion_blend_reached(const PTZ_POS *from, const PTZ_POS *to, const STATUS_SAMPLE *sample, fixed_t tolerance)
+{
+	return blend_axis_reached(motion_pan_delta(from->pan_val , to->pan_val) , motion_pan_delta(sample->pan_val , to->pan_val) , tolerance)
+		&& blend_axis_reached(fx_subx(to->tilt_val , from->tilt_val) , fx_subx(to->tilt_val , sample->tilt_val) , tolerance)
+		&& blend_axis_reached(fx_subx(to->zoom_val , from->zoom_val) , fx_subx(to->zoom_val , sample->zoom_val) , tolerance);
+}
+
+/*
+ * Speed after <t> seconds of a jerk-limited ramp to <peak>: jerk up to the
+ * acceleration limit (or less when the ramp is short), hold it, jerk down
+ */
+static gdouble scurve_speed(gdouble t, gdouble peak, gdouble accel, gdouble jerk)
+{
+	gdouble tj = accel / jerk;
+	gdouble ta = peak / accel - tj;
+	gdouble total = ta + 2 * tj;
+
+	if(t < tj)
+		return jerk * t * t / 2;
+	if(t < tj + ta)
+		return jerk * tj * tj / 2 + accel * (t - tj);
+	if(t < total)
+		return peak - jerk * (total - t) * (total - t) / 2;
+	return peak;
+}
+
+/*
+ * Sample the ramp to <peak_speed> per tick of <tick_s> seconds, with the
+ * limits in unitless speed per second and per second squared. FALSE when
+ * the ramp is longer than MOTION_SCURVE_MAX_STEPS ticks.
+ */
+gboolean motion_scurve_plan(MOTION_SCURVE *curve, gfloat peak_speed, gfloat max_accel, gfloat max_jerk, gdouble tick_s)
+{
+	gdouble accel = MIN(max_accel, sqrt((gdouble)peak_speed * max_jerk));
+	gdouble total = peak_speed / accel + accel / max_jerk;
+	gdouble way = 0;
+	gint steps = MAX((gint)ceil(total / tick_s - 1e-9), 1);
+	gint i;
+
+	if(steps > MOTION_SCURVE_MAX_STEPS)
+		return FALSE;
+	curve->steps = steps;
+	for(i = 0 ; i < steps ; i ++)
+	{
+		curve->factor[i] = (i == steps - 1) ? 1.0f : (gfloat)(scurve_speed((i + 1) * tick_s, peak_speed, accel, max_jerk) / peak_speed);
+		/* the ticks down the ramp, plus one at this speed before the command takes */
+		curve->stop_ticks[i] = (gfloat)(way + curve->factor[i]);
+		way += curve->factor[i];
+	}
+	return TRUE;
+}
+
+/*
+ * Ramp step to continue from when the axes already move at <factor> of
+ * the peak speed
+ */
+gint motion_scurve_entry(const MOTION_SCURVE *curve, gfloat factor)
+{
+	gint i;
+
+	for(i = 0 ; i < curve->steps - 1 && curve->factor[i] < factor ; i ++)
+		;
+	return i;
+}
+
+/*
+ * Share of the peak speed to command at ramp <step>: up the ramp, but
+ * never faster than what still brakes down the ramp within
+ * <remaining_ticks> (at peak speed) of the target. Never below the first
+ * step, so the axes creep into the arrival window instead of stopping short.
+ */
+gfloat motion_scurve_factor(const MOTION_SCURVE *curve, gint step, gfloat remaining_ticks)
+{
+	gfloat accel = curve->factor[CLAMP(step, 0, curve->steps - 1)];
+	gint i;
+
+	for(i = curve->steps - 1 ; i > 0 && curve->stop_ticks[i] > remaining_ticks ; i --)
+		;
+	return MIN(accel, curve->factor[i]);
+}
+
+/*
+ * Seconds an axis needs for <distance> units with a trapezoidal profile:
+ * up to <speed> at <accel> (units per second, per second squared), from
+ * <speed_in> and down to <speed_out>. Without an acceleration limit the
+ * axis moves at <speed> all the way.
+ */
+gdouble motion_predict_axis_time(gdouble distance, gdouble speed, gdouble accel, gdouble speed_in, gdouble speed_out)
+{
+	gdouble ramp;
+	gdouble peak;
+
+	if(distance <= 0 || speed <= 0)
+		return 0;
+	if(accel <= 0)
+		return distance / speed;
+	speed_in = MIN(speed_in, speed);
+	speed_out = MIN(speed_out, speed);
+	ramp = (2 * speed * speed - speed_in * speed_in - speed_out * speed_out) / (2 * accel);
+	if(ramp <= distance)
+		return (2 * speed - speed_in - speed_out) / accel + (distance - ramp) / speed;
+
+	/* too short for the full speed */
+	peak = sqrt(accel * distance + (speed_in * speed_in + speed_out * speed_out) / 2);
+	if(peak < MAX(speed_in, speed_out))
+		return 2 * distance / (speed_in + speed_out);
+	return (2 * peak - speed_in - speed_out) / accel;
+}
+
+/*
+ * Distance of <point> from the straight segment <from>-<to> in
+ * pan/tilt/zoom units, pan measured the short way round from <from>
+ */
+gdouble motion_segment_distance(const PTZ_POS *from, const PTZ_POS *to, const PTZ_POS *point)
+{
+	gdouble dx = motion_pan_delta(from->pan_val, to->pan_val);
+	gdouble dy = (gdouble)to->tilt_val - from->tilt_val;
+	gdouble dz = (gdouble)to->zoom_val - from->zoom_val;
+	gdouble px = motion_pan_delta(from->pan_val, point->pan_val);
+	gdouble py = (gdouble)point->tilt_val - from->tilt_val;
+	gdouble pz = (gdouble)point->zoom_val - from->zoom_val;
+	gdouble length2 = dx * dx + dy * dy + dz * dz;
+	gdouble u = (length2 > 0) ? CLAMP((px * dx + py * dy + pz * dz) / length2, 0.0, 1.0) : 0.0;
+
+	px -= u * dx;
+	py -= u * dy;
+	pz -= u * dz;
+	return sqrt(px * px + py * py + pz * pz);
+}
+
+static void sample_position(const STATUS_SAMPLE *sample, PTZ_POS *pos)
+{
+	pos->pan_val = sample->pan_val;
+	pos->tilt_val = sample->tilt_val;
+	pos->zoom_val = sample->zoom_val;
+	pos->pass_through = TRUE;
+}
+
+/*
+ * Ramer-Douglas-Peucker over the samples between <first> and <last>, kept
+ * ones flagged in <keep>. Iterative, a long recording would run a
+ * recursive one out of stack.
+ */
+static void simplify_span(const STATUS_SAMPLE *samples, gint first, gint last, gdouble tolerance, gboolean *keep, gint *stack)
+{
+	gint top = 0;
+
+	stack[top ++] = first;
+	stack[top ++] = last;
+	while(top > 0)
+	{
+		gint b = stack[-- top];
+		gint a = stack[-- top];
+		PTZ_POS from;
+		PTZ_POS to;
+		gdouble worst = 0;
+		gint worst_index = -1;
+		gint i;
+
+		sample_position(&samples[a], &from);
+		sample_position(&samples[b], &to);
+		for(i = a + 1 ; i < b ; i ++)
+		{
+			PTZ_POS point;
+			gdouble distance;
+
+			sample_position(&samples[i], &point);
+			distance = motion_segment_distance(&from, &to, &point);
+			if(distance > worst)
+			{
+				worst = distance;
+				worst_index = i;
+			}
+		}
+		if(worst_index < 0 || worst <= tolerance)
+			continue;
+		keep[worst_index] = TRUE;
+		stack[top ++] = a;
+		stack[top ++] = worst_index;
+		stack[top ++] = worst_index;
+		stack[top ++] = b;
+	}
+}
+
+/*
+ * Compress a recorded path into waypoints no sample is more than
+ * <tolerance> units away from. Where the camera stays within the tolerance
+ * of one position for <min_hold_us> or longer that position is kept as a
+ * hold, so a pause on a straight line survives the simplification and the
+ * time spent there is not taken for a slow move. <points> has room for
+ * <count> entries; returns the number of waypoints.
+ */
+gint motion_teach_compress(const STATUS_SAMPLE *samples, gint count, fixed_t tolerance, gint64 min_hold_us, MOTION_TEACH_POINT *points)
+{
+	gboolean *keep;
+	gint *stack;
+	gint64 departed_us;
+	gint first;
+	gint n = 0;
+	gint i;
+
+	if(count <= 0)
+		return 0;
+	keep = g_new0(gboolean, count);
+	stack = g_new(gint, 2 * count + 2);
+	keep[0] = TRUE;
+	keep[count - 1] = TRUE;
+
+	/* the start of every long enough hold */
+	for(i = 0 ; i < count ; )
+	{
+		PTZ_POS here;
+		gint j = i;
+
+		sample_position(&samples[i], &here);
+		while(j + 1 < count)
+		{
+			PTZ_POS next;
+
+			sample_position(&samples[j + 1], &next);
+			if(motion_segment_distance(&here, &here, &next) > tolerance)
+				break;
+			j ++;
+		}
+		if(samples[j].time_us - samples[i].time_us >= min_hold_us)
+			keep[i] = TRUE;
+		i = j + 1;
+	}
+
+	for(first = 0, i = 1 ; i < count ; i ++)
+	{
+		if(!keep[i])
+			continue;
+		simplify_span(samples, first, i, tolerance, keep, stack);
+		first = i;
+	}
+
+	departed_us = samples[0].time_us;
+	for(i = 0 ; i < count ; i ++)
+	{
+		MOTION_TEACH_POINT *point = &points[n];
+		gint j = i;
+
+		if(!keep[i])
+			continue;
+		sample_position(&samples[i], &point->pos);
+		point->sample = i;
+		point->move_us = samples[i].time_us - departed_us;
+		while(j + 1 < count)
+		{
+			PTZ_POS next;
+
+			sample_position(&samples[j + 1], &next);
+			if(keep[j + 1] || motion_segment_distance(&point->pos, &point->pos, &next) > tolerance)
+				break;
+			j ++;
+		}
+		point->hold_us = samples[j].time_us - samples[i].time_us;
+		if(point->hold_us < min_hold_us)
+			point->hold_us = 0;
+		departed_us = samples[i].time_us + point->hold_us;
+		n ++;
+	}
+	g_free(stack);
+	g_free(keep);
+	return n;
+}
+
@@ -0,0 +1,90 @@
+/*
+ * Segment speed planning and arrival decisions of the tour.
+ *
+ * Kept free of axptz calls so that the same logic runs in panoramatv and in
+ * the off-device trace replay tool.
+ */
+#ifndef __MOTION_H__
+#define __MOTION_H__
+
+#include <glib.h>
+#include <fixmath.h>
+
+/* The number of fractional bits used in fix-point variables */
+#define FIXMATH_FRAC_BITS 16
+
+/* pan/tilt arrival window in unitless position units */
+#define MOTION_PAN_TILT_ARRIVAL_UNITS 200
+
+/* longest S-curve ramp, in control ticks */
+#define MOTION_SCURVE_MAX_STEPS 64
+
+typedef struct PTZ_POS{
+  
+	fixed_t pan_val;
+	fixed_t tilt_val;
+	fixed_t zoom_val;
+	gboolean pass_through;	/* interpolated waypoint, no stop and no dwell */
+  
+}PTZ_POS;
+
+typedef struct STATUS_SAMPLE{
+
+	gint64 time_us;
+	fixed_t pan_val;
+	fixed_t tilt_val;
+	fixed_t zoom_val;
+
+}STATUS_SAMPLE;
+
+/*
+ * Jerk-limited ramp from standstill to the peak speed, sampled at the end
+ * of each control tick. Braking runs the same ramp backwards.
+ */
+typedef struct MOTION_SCURVE{
+
+	gint steps;
+	gfloat factor[MOTION_SCURVE_MAX_STEPS];		/* share of the peak speed after each tick */
+	gfloat stop_ticks[MOTION_SCURVE_MAX_STEPS];	/* way to a stop from that step, in ticks at peak speed */
+
+}MOTION_SCURVE;
+
+void motion_set_pan_wrap(gboolean wraps, fixed_t min_pan, fixed_t max_pan);
+gboolean motion_pan_wraps(void);
+fixed_t motion_pan_delta(fixed_t from, fixed_t to);
+fixed_t motion_pan_wrap(fixed_t pan);
+
+void motion_segment_speeds(const PTZ_POS *from, const PTZ_POS *to, gfloat max_speed, fixed_t *pan_speed, fixed_t *tilt_speed, fixed_t *zoom_speed);
+
+gboolean motion_pan_arrived(fixed_t pan_pos, fixed_t pan_val, fixed_t pan_speed);
+gboolean motion_tilt_arrived(fixed_t tilt_pos, fixed_t tilt_val, fixed_t tilt_speed);
+gboolean motion_zoom_arrived(fixed_t zoom_pos, fixed_t zoom_val, fixed_t zoom_speed);
+
+fixed_t motion_travel(const PTZ_POS *from, const PTZ_POS *to);
+fixed_t motion_residual(const PTZ_POS *to, const STATUS_SAMPLE *sample);
+
+gboolean motion_blend_reached(const PTZ_POS *from, const PTZ_POS *to, const STATUS_SAMPLE *sample, fixed_t tolerance);
+
+gboolean motion_scurve_plan(MOTION_SCURVE *curve, gfloat peak_speed, gfloat max_accel, gfloat max_jerk, gdouble tick_s);
+gint motion_scurve_entry(const MOTION_SCURVE *curve, gfloat factor);
+gfloat motion_scurve_factor(const MOTION_SCURVE *curve, gint step, gfloat remaining_ticks);
+
+/*
+ * A waypoint of a taught path: the recorded sample it was kept from, the
+ * time the operator took to get there and how long they held it
+ */
+typedef struct MOTION_TEACH_POINT{
+
+	PTZ_POS pos;
+	gint sample;
+	gint64 move_us;
+	gint64 hold_us;
+
+}MOTION_TEACH_POINT;
+
+gdouble motion_predict_axis_time(gdouble distance, gdouble speed, gdouble accel, gdouble speed_in, gdouble speed_out);
+
+gdouble motion_segment_distance(const PTZ_POS *from, const PTZ_POS *to, const PTZ_POS *point);
+gint motion_teach_compress(const STATUS_SAMPLE *samples, gint count, fixed_t tolerance, gint64 min_hold_us, MOTION_TEACH_POINT *points);
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * Check and time the numeric backends of motion_math.h.
+ *
+ * The check sweeps both backends over the full unitless range against an
+ * exact 64-bit reference: q16 has to match exactly, float within one unit
+ * up to MOTION_MATH_FLOAT_RANGE.
+ * It then plans segments between positions across the range with the
+ * backend this binary was built with and checks the lead axis and the
+ * speed ratios. The benchmark times each backend on the same inputs; run
+ * it on the camera to pick MATH=q16 or MATH=float for that target.
+ *
+ * The teach benchmark compresses a recorded operator path (a synthetic
+ * one, or the .samples file panoramatv --teach saves) at a range of
+ * tolerances and prints the compression ratio against the path error and
+ * the replay error, how far the timed waypoints are from each sample at
+ * the time it was taken.
+ *
+ * Usage: panoramatv_mathbench [check|bench] [iterations]
+ *        panoramatv_mathbench teach [recording]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "motion.h"
+#include "motion_math.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20000000
+#define BENCH_INPUTS 4096
+
+/* unitless positions span +/-32768, deltas twice that */
+#define CHECK_DELTA_MAX 65536
+#define CHECK_DELTA_STEP 7
+
+/* synthetic teach recording, 100 Hz with a smoothed joystick */
+#define TEACH_SAMPLE_US 10000
+#define TEACH_JOYSTICK_TAU 0.4
+#define TEACH_MIN_HOLD_US 500000
+#define TEACH_PAN_RATE (700.0 * 32768.0 / 180.0)
+#define TEACH_TILT_RATE (500.0 * 16384.0 / 90.0)
+#define TEACH_ZOOM_RATE (35745.0 / 3.0)
+
+typedef struct CHECK_RESULT{
+
+	gint64 checked;
+	gint64 failed;
+	gint64 max_error;
+
+}CHECK_RESULT;
+
+static void check_value(CHECK_RESULT *result, gint64 reference, fixed_t value, gint64 tolerance)
+{
+	gint64 error = ABS(reference - value);
+
+	if(reference > G_MAXINT32 || reference < G_MININT32)
+		return;
+	result->checked ++;
+	result->max_error = MAX(result->max_error, error);
+	if(error > tolerance)
+	{
+		if(result->failed < 5)
+			printf("  mismatch: expected %" G_GINT64_FORMAT ", got %d\n", reference, value);
+		result->failed ++;
+	}
+}
+
+static gboolean report(const gchar *name, const CHECK_RESULT *result)
+{
+	printf("%-12s %" G_GINT64_FORMAT " values, max error %" G_GINT64_FORMAT ", %s\n", name, result->checked, result->max_error,
+		result->failed ? "FAILED" : "ok");
+	return result->failed == 0;
+}
+
+/*
+ * Both backends over every delta in the range (stepped), against Q16
+ * speeds and fractions and divisors across the range
+ */
+static gboolean check_backends(void)
+{
+	static const gfloat speeds[] = { 0.0001f, 0.01f, 0.1f, 0.3f, 0.5f, 1.0f, 1.4f, -0.3f, -1.0f };
+	static const fixed_t divisors[] = { 1, 2, 3, 7, 10, 100, 199, 1000, 4096, 9999, 16384, 32767, 32768, 50000, 65535, 65536 };
+	CHECK_RESULT scale_q16 = { 0 };
+	CHECK_RESULT scale_float = { 0 };
+	CHECK_RESULT mul_q16 = { 0 };
+	CHECK_RESULT mul_float = { 0 };
+	fixed_t x;
+	guint s;
+	guint d;
+	gboolean ok = TRUE;
+
+	for(x = -CHECK_DELTA_MAX ; x <= CHECK_DELTA_MAX ; x += CHECK_DELTA_STEP)
+	{
+		for(s = 0 ; s < G_N_ELEMENTS(speeds) ; s ++)
+		{
+			fixed_t q = fx_ftox(speeds[s], FIXMATH_FRAC_BITS);
+			gint64 product = (gint64)x * q;
+
+			for(d = 0 ; d < G_N_ELEMENTS(divisors) ; d ++)
+			{
+				check_value(&scale_q16, product / divisors[d], motion_math_scale_q16(x, q, divisors[d]), 0);
+				check_value(&scale_q16, product / -divisors[d], motion_math_scale_q16(x, q, -divisors[d]), 0);
+				if(ABS(product / divisors[d]) > MOTION_MATH_FLOAT_RANGE)
+					continue;
+				check_value(&scale_float, product / divisors[d], motion_math_scale_float(x, q, divisors[d]), 1);
+				check_value(&scale_float, product / -divisors[d], motion_math_scale_float(x, q, -divisors[d]), 1);
+			}
+			check_value(&mul_q16, product >> 16, motion_math_mul_q16(x, q), 0);
+			check_value(&mul_float, product >> 16, motion_math_mul_float(x, q), 1);
+		}
+	}
+	ok &= report("scale q16", &scale_q16);
+	ok &= report("scale float", &scale_float);
+	ok &= report("mul q16", &mul_q16);
+	ok &= report("mul float", &mul_float);
+	return ok;
+}
+
+/*
+ * Segment plans with the built-in backend: the lead axis gets the max
+ * speed and the others keep their share of the way within one unit
+ */
+static gboolean check_segment_speeds(void)
+{
+	static const gint32 axis_steps[] = { -32768, -20000, -9999, -1000, -201, -3, 0, 1, 5, 200, 1234, 16384, 32767 };
+	const gfloat max_speed = 0.3f;
+	const fixed_t lead = fx_ftox(max_speed, FIXMATH_FRAC_BITS);
+	const fixed_t gain = fx_ftox(1.4f, FIXMATH_FRAC_BITS);
+	CHECK_RESULT result = { 0 };
+	guint p;
+	guint t;
+	guint z;
+
+	motion_set_pan_wrap(FALSE, -32768, 32768);
+	for(p = 0 ; p < G_N_ELEMENTS(axis_steps) ; p ++)
+	{
+		for(t = 0 ; t < G_N_ELEMENTS(axis_steps) ; t ++)
+		{
+			for(z = 0 ; z < G_N_ELEMENTS(axis_steps) ; z ++)
+			{
+				PTZ_POS from = { 32767 - ABS(axis_steps[p]), -axis_steps[t] / 2, 20000, FALSE };
+				PTZ_POS to = { from.pan_val + axis_steps[p], from.tilt_val + axis_steps[t], from.zoom_val + axis_steps[z] / 2, FALSE };
+				fixed_t pan_delta = to.pan_val - from.pan_val;
+				fixed_t tilt_delta = to.tilt_val - from.tilt_val;
+				fixed_t zoom_delta = to.zoom_val - from.zoom_val;
+				fixed_t pan;
+				fixed_t tilt;
+				fixed_t zoom;
+
+				motion_segment_speeds(&from, &to, max_speed, &pan, &tilt, &zoom);
+				if(ABS(pan_delta) >= ABS(tilt_delta) && ABS(pan_delta) >= ABS(zoom_delta))
+				{
+					if(pan_delta == 0)
+						continue;
+					check_value(&result, pan_delta > 0 ? lead : -lead, pan, 0);
+					check_value(&result, (((gint64)tilt_delta * lead / ABS(pan_delta)) * gain) >> 16, tilt, 1);
+					check_value(&result, (((gint64)zoom_delta * lead / ABS(pan_delta)) * gain) >> 16, zoom, 1);
+				}
+				else if(ABS(tilt_delta) >= ABS(zoom_delta))
+				{
+					check_value(&result, ((tilt_delta > 0 ? (gint64)lead : -(gint64)lead) * gain) >> 16, tilt, 1);
+					check_value(&result, (gint64)pan_delta * lead / ABS(tilt_delta), pan, 1);
+				}
+				else
+				{
+					check_value(&result, ((zoom_delta > 0 ? (gint64)lead : -(gint64)lead) * gain) >> 16, zoom, 1);
+					check_value(&result, (gint64)pan_delta * lead / ABS(zoom_delta), pan, 1);
+				}
+			}
+		}
+	}
+	return report("segments " MOTION_MATH_BACKEND, &result);
+}
+
+static fixed_t bench_x[BENCH_INPUTS];
+static fixed_t bench_q[BENCH_INPUTS];
+static fixed_t bench_d[BENCH_INPUTS];
+
+static void bench_backend(const gchar *name, fixed_t (*scale)(fixed_t, fixed_t, fixed_t), fixed_t (*mul)(fixed_t, fixed_t), gint iterations)
+{
+	volatile fixed_t sink = 0;
+	gint64 start;
+	gint64 scale_us;
+	gint64 mul_us;
+	gint i;
+
+	start = g_get_monotonic_time();
+	for(i = 0 ; i < iterations ; i ++)
+		sink += scale(bench_x[i & (BENCH_INPUTS - 1)], bench_q[i & (BENCH_INPUTS - 1)], bench_d[i & (BENCH_INPUTS - 1)]);
+	scale_us = g_get_monotonic_time() - start;
+
+	start = g_get_monotonic_time();
+	for(i = 0 ; i < iterations ; i ++)
+		sink += mul(bench_x[i & (BENCH_INPUTS - 1)], bench_q[i & (BENCH_INPUTS - 1)]);
+	mul_us = g_get_monotonic_time() - start;
+
+	printf("%-6s scale %.2f ns/op, mul %.2f ns/op\n", name, scale_us * 1000.0 / iterations, mul_us * 1000.0 / iterations);
+}
+
+/*
+ * The backends are called through pointers so both see the same call
+ * overhead; the inlined cost in motion.c is lower for either
+ */
+static void bench_backends(gint iterations)
+{
+	gint i;
+
+	srand(1);
+	for(i = 0 ; i < BENCH_INPUTS ; i ++)
+	{
+		bench_x[i] = (rand() % (2 * CHECK_DELTA_MAX + 1)) - CHECK_DELTA_MAX;
+		bench_q[i] = rand() % fx_ftox(1.4f, FIXMATH_FRAC_BITS);
+		bench_d[i] = 1 + rand() % CHECK_DELTA_MAX;
+	}
+	printf("%d iterations, built with %s\n", iterations, MOTION_MATH_BACKEND);
+	bench_backend("q16", motion_math_scale_q16, motion_math_mul_q16, iterations);
+	bench_backend("float", motion_math_scale_float, motion_math_mul_float, iterations);
+}
+
+/*
+ * Joystick moves in unitless speed, held for the given seconds
+ */
+static const struct { gdouble seconds; gdouble pan; gdouble tilt; gdouble zoom; } teach_moves[] = {
+	{ 2, 0, 0, 0 }, { 8, 0.03, 0, 0 }, { 3, 0, 0, 0 }, { 6, -0.02, 0.01, 0.2 }, { 4, 0, 0, 0 },
+	{ 10, 0.04, -0.005, -0.1 }, { 2, 0, 0, 0 }, { 6, -0.05, 0, 0 }, { 3, 0, 0, 0 }
+};
+
+static GArray *teach_synthetic(void)
+{
+	GArray *samples = g_array_new(FALSE, FALSE, sizeof(STATUS_SAMPLE));
+	gdouble pos[3] = { 0, -4000, 3000 };
+	gdouble speed[3] = { 0, 0, 0 };
+	gdouble rate[3] = { TEACH_PAN_RATE, TEACH_TILT_RATE, TEACH_ZOOM_RATE };
+	gdouble dt = TEACH_SAMPLE_US / (gdouble)G_USEC_PER_SEC;
+	gint64 t = 0;
+	guint m;
+	gint axis;
+
+	for(m = 0 ; m < G_N_ELEMENTS(teach_moves) ; m ++)
+	{
+		gdouble command[3] = { teach_moves[m].pan, teach_moves[m].tilt, teach_moves[m].zoom };
+		gint64 end = t + (gint64)(teach_moves[m].seconds * G_USEC_PER_SEC);
+
+		for( ; t < end ; t += TEACH_SAMPLE_US)
+		{
+			STATUS_SAMPLE sample;
+
+			for(axis = 0 ; axis < 3 ; axis ++)
+			{
+				speed[axis] += (command[axis] - speed[axis]) * dt / TEACH_JOYSTICK_TAU;
+				pos[axis] += speed[axis] * rate[axis] * dt;
+			}
+			/* the operator weaves a little while panning */
+			pos[1] += 20 * fabs(speed[0]) / 0.03 * sin(2 * G_PI * t / (5.0 * G_USEC_PER_SEC));
+			pos[1] = CLAMP(pos[1], -16384, 3641);
+			pos[2] = CLAMP(pos[2], 3, 35748);
+			sample.time_us = t;
+			sample.pan_val = motion_pan_wrap((fixed_t)lround(pos[0]));
+			sample.tilt_val = (fixed_t)lround(pos[1]);
+			sample.zoom_val = (fixed_t)lround(pos[2]);
+			g_array_append_val(samples, sample);
+		}
+	}
+	return samples;
+}
+
+/*
+ * "time_us pan tilt zoom" per line
+ */
+static GArray *teach_load(const gchar *path)
+{
+	GArray *samples = g_array_new(FALSE, FALSE, sizeof(STATUS_SAMPLE));
+	gchar *contents = NULL;
+	gchar **lines;
+	gint i;
+
+	if(!g_file_get_contents(path, &contents, NULL, NULL))
+	{
+		fprintf(stderr, "can not read %s\n", path);
+		return samples;
+	}
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL ; i ++)
+	{
+		STATUS_SAMPLE sample;
+
+		if(lines[i][0] != '#' && sscanf(lines[i], "%" G_GINT64_FORMAT " %d %d %d", &sample.time_us, &sample.pan_val, &sample.tilt_val, &sample.zoom_val) == 4)
+			g_array_append_val(samples, sample);
+	}
+	g_strfreev(lines);
+	g_free(contents);
+	return samples;
+}
+
+/*
+ * Where the waypoints put the camera at <t>, moving linearly between them
+ */
+static void teach_replay_position(const MOTION_TEACH_POINT *points, gint n, gint64 t, PTZ_POS *pos)
+{
+	gint64 departed = 0;
+	gint i;
+
+	*pos = points[0].pos;
+	for(i = 0 ; i < n ; i ++)
+	{
+		gint64 arrived = departed + points[i].move_us;
+
+		if(t < arrived && i > 0)
+		{
+			const PTZ_POS *from = &points[i - 1].pos;
+			const PTZ_POS *to = &points[i].pos;
+			gdouble u = (gdouble)(t - departed) / points[i].move_us;
+
+			pos->pan_val = motion_pan_wrap(from->pan_val + (fixed_t)lround(u * motion_pan_delta(from->pan_val, to->pan_val)));
+			pos->tilt_val = from->tilt_val + (fixed_t)lround(u * (to->tilt_val - from->tilt_val));
+			pos->zoom_val = from->zoom_val + (fixed_t)lround(u * (to->zoom_val - from->zoom_val));
+			return;
+		}
+		*pos = points[i].pos;
+		departed = arrived + points[i].hold_us;
+		if(t < departed)
+			return;
+	}
+}
+
+/*
+ * Compression ratio against the path error (distance from the waypoint
+ * polyline, bounded by the tolerance) and the replay error; fails if the
+ * path error is above the tolerance
+ */
+static gboolean bench_teach(const gchar *path)
+{
+	static const fixed_t tolerances[] = { 10, 25, 50, 100, 200, 400, 800 };
+	GArray *recording;
+	const STATUS_SAMPLE *samples;
+	MOTION_TEACH_POINT *points;
+	gboolean ok = TRUE;
+	guint k;
+
+	motion_set_pan_wrap(TRUE, -32768, 32768);
+	recording = path ? teach_load(path) : teach_synthetic();
+	samples = (const STATUS_SAMPLE *)recording->data;
+	if(recording->len < 2)
+	{
+		g_array_free(recording, TRUE);
+		return FALSE;
+	}
+	points = g_new(MOTION_TEACH_POINT, recording->len);
+	printf("teach: %u samples over %.1f s from %s\n", recording->len, (samples[recording->len - 1].time_us - samples[0].time_us) / (gdouble)G_USEC_PER_SEC,
+		path ? path : "the synthetic operator");
+	printf("%9s %7s %7s %7s %9s %9s %10s %10s %9s\n", "tolerance", "points", "holds", "ratio", "path max", "path mean", "replay max", "replay mean", "time us");
+	for(k = 0 ; k < G_N_ELEMENTS(tolerances) ; k ++)
+	{
+		gint64 start = g_get_monotonic_time();
+		gint n = motion_teach_compress(samples, recording->len, tolerances[k], TEACH_MIN_HOLD_US, points);
+		gint64 elapsed = g_get_monotonic_time() - start;
+		gdouble path_max = 0;
+		gdouble path_sum = 0;
+		gdouble replay_max = 0;
+		gdouble replay_sum = 0;
+		gint holds = 0;
+		gint segment = 0;
+		guint i;
+
+		for(i = 0 ; i < (guint)n ; i ++)
+			holds += (points[i].hold_us > 0);
+		for(i = 0 ; i < recording->len ; i ++)
+		{
+			PTZ_POS here = { samples[i].pan_val, samples[i].tilt_val, samples[i].zoom_val, TRUE };
+			PTZ_POS replayed;
+			gdouble error;
+
+			while(segment + 1 < n - 1 && (gint)i >= points[segment + 1].sample)
+				segment ++;
+			error = (n > 1) ? motion_segment_distance(&points[segment].pos, &points[segment + 1].pos, &here) : 0;
+			path_max = MAX(path_max, error);
+			path_sum += error;
+			teach_replay_position(points, n, samples[i].time_us - samples[0].time_us, &replayed);
+			error = motion_segment_distance(&replayed, &replayed, &here);
+			replay_max = MAX(replay_max, error);
+			replay_sum += error;
+		}
+		printf("%9d %7d %7d %6.1fx %9.0f %9.1f %10.0f %10.1f %9" G_GINT64_FORMAT "\n", tolerances[k], n, holds, recording->len / (gdouble)n,
+			path_max, path_sum / recording->len, replay_max, replay_sum / recording->len, elapsed);
+		if(path_max > tolerances[k] + 1)
+			ok = FALSE;
+	}
+	g_free(points);
+	g_array_free(recording, TRUE);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	const gchar *mode = (argc > 1) ? argv[1] : "check";
+	gint iterations = (argc > 2) ? MAX(atoi(argv[2]), 1) : BENCH_DEFAULT_ITERATIONS;
+	gboolean ok = TRUE;
+
+	if(g_strcmp0(mode, "teach") == 0)
+	{
+		ok = bench_teach((argc > 2) ? argv[2] : NULL);
+		printf("%s\n", ok ? "PASSED" : "FAILED");
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if(g_strcmp0(mode, "check") != 0 && g_strcmp0(mode, "bench") != 0)
+	{
+		fprintf(stderr, "usage: %s [check|bench] [iterations]\n       %s teach [recording]\n", argv[0], argv[0]);
+		return EXIT_FAILURE;
+	}
+	ok &= check_backends();
+	ok &= check_segment_speeds();
+	if(g_strcmp0(mode, "bench") == 0)
+		bench_backends(iterations);
+	printf("%s\n", ok ? "PASSED" : "FAILED");
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,80 @@
+/*
+ * Numeric backend of the planning and arrival math.
+ *
+ * Positions are plain unitless integers held in fixed_t, speeds and
+ * fractions are Q16. Chaining fx_mulx/fx_divx over positions of +/-32768
+ * either overflows 32 bits or truncates an intermediate to whole units, so
+ * motion.c goes through these two operations instead:
+ *
+ *   motion_math_scale(x, num, den)  x * num / den, rounded toward zero
+ *   motion_math_mul(x, q)           x * q for a Q16 <q>, rounded down
+ *
+ * The default backend keeps the product in 64 bits and is exact. Building
+ * with MOTION_MATH_FLOAT ("make MATH=float") uses single precision floats
+ * instead, which is within one unit of the exact result for results up to
+ * MOTION_MATH_FLOAT_RANGE (speeds and positions stay far below) and can be
+ * faster on targets with a hardware FPU. panoramatv_mathbench checks both
+ * and times them.
+ */
+#ifndef __MOTION_MATH_H__
+#define __MOTION_MATH_H__
+
+#include <math.h>
+#include <glib.h>
+#include <fixmath.h>
+
+#define MOTION_MATH_FLOAT_RANGE (1 << 22)
+
+static inline fixed_t motion_math_clamp(gint64 value)
+{
+	return (fixed_t)CLAMP(value, G_MININT32, G_MAXINT32);
+}
+
+static inline fixed_t motion_math_scale_q16(fixed_t x, fixed_t num, fixed_t den)
+{
+	if(den == 0)
+		return 0;
+	return motion_math_clamp((gint64)x * num / den);
+}
+
+static inline fixed_t motion_math_mul_q16(fixed_t x, fixed_t q)
+{
+	return motion_math_clamp(((gint64)x * q) >> 16);
+}
+
+static inline fixed_t motion_math_scale_float(fixed_t x, fixed_t num, fixed_t den)
+{
+	gfloat value;
+
+	if(den == 0)
+		return 0;
+	value = (gfloat)x * (gfloat)num / (gfloat)den;
+	if(value >= (gfloat)G_MAXINT32)
+		return G_MAXINT32;
+	if(value <= (gfloat)G_MININT32)
+		return G_MININT32;
+	return (fixed_t)value;
+}
+
+static inline fixed_t motion_math_mul_float(fixed_t x, fixed_t q)
+{
+	gfloat value = (gfloat)x * (gfloat)q * (1.0f / 65536.0f);
+
+	if(value >= (gfloat)G_MAXINT32)
+		return G_MAXINT32;
+	if(value <= (gfloat)G_MININT32)
+		return G_MININT32;
+	return (fixed_t)floorf(value);
+}
+
+#ifdef MOTION_MATH_FLOAT
+#define MOTION_MATH_BACKEND "float"
+#define motion_math_scale motion_math_scale_float
+#define motion_math_mul motion_math_mul_float
+#else
+#define MOTION_MATH_BACKEND "q16"
+#define motion_math_scale motion_math_scale_q16
+#define motion_math_mul motion_math_mul_q16
+#endif
+
+#endif
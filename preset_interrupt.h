@@ -0,0 +1,19 @@
+/*
+ * Preset interrupt requests.
+ *
+ * panoramatv listens on a local datagram socket for one-line requests:
+ *
+ *   preset <number> [hold_ms] [sent_us]   go to the preset now, hold it
+ *   release                               end the hold, resume the tour
+ *
+ * <sent_us> is the sender's CLOCK_MONOTONIC time in microseconds; with it
+ * the trigger latency is measured from the sender instead of from the
+ * receive. panoramatv_trigger sends these for testing and from scripts.
+ */
+#ifndef __PRESET_INTERRUPT_H__
+#define __PRESET_INTERRUPT_H__
+
+#define PRESET_INTERRUPT_DEFAULT_SOCKET "/tmp/panoramatv.sock"
+#define PRESET_INTERRUPT_MESSAGE_LENGTH 128
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * libptzprof.so: LD_PRELOAD interposer that profiles the axptz calls of an
+ * unmodified panoramatv.
+ *
+ *   LD_PRELOAD=/tmp/libptzprof.so /usr/local/packages/panoramatv/panoramatv
+ *   kill -USR1 <pid>
+ *
+ * Every ax_ptz_* function panoramatv uses is wrapped: the wrapper looks the
+ * real one up with dlsym(RTLD_NEXT), times it on the monotonic clock and
+ * adds the latency to its record in shared memory (see ptzprof.h). The
+ * signal, and the exit, write the table sorted by total time to
+ * PTZPROF_OUTPUT, default /tmp/ptzprof.<pid>.txt. The signal is taken by a
+ * thread of the library in sigwait(), so the dump never runs in a signal
+ * handler and the profiled threads never see the signal.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <axsdk/axptz.h>
+#include "ptzprof.h"
+
+typedef enum
+{
+	PROF_CREATE,
+	PROF_DESTROY,
+	PROF_GET_APP_GROUP_INSTANCE,
+	PROF_CONTROL_QUEUE_REQUEST,
+	PROF_GET_MOVE_CAPABILITIES,
+	PROF_IS_PTZ_MOVING,
+	PROF_GET_PTZ_STATUS,
+	PROF_GET_PTZ_LIMITS,
+	PROF_SET_ABSOLUTE_SPACES,
+	PROF_ABSOLUTE_MOVEMENT_CREATE,
+	PROF_ABSOLUTE_MOVEMENT_SET,
+	PROF_ABSOLUTE_MOVEMENT_DESTROY,
+	PROF_ABSOLUTE_MOVE,
+	PROF_SET_RELATIVE_SPACES,
+	PROF_RELATIVE_MOVEMENT_CREATE,
+	PROF_RELATIVE_MOVEMENT_SET,
+	PROF_RELATIVE_MOVEMENT_DESTROY,
+	PROF_RELATIVE_MOVE,
+	PROF_SET_CONTINUOUS_SPACES,
+	PROF_CONTINUOUS_MOVEMENT_CREATE,
+	PROF_CONTINUOUS_MOVEMENT_SET,
+	PROF_CONTINUOUS_MOVEMENT_DESTROY,
+	PROF_CONTINUOUS_START,
+	PROF_CONTINUOUS_STOP,
+	PROF_QUERY_PRESETS,
+	PROF_GOTO_PRESET_NUMBER,
+	PROF_CALLS
+} PROF_CALL_ID;
+
+static const gchar *prof_names[PROF_CALLS] = {
+	"ax_ptz_create",
+	"ax_ptz_destroy",
+	"ax_ptz_control_queue_get_app_group_instance",
+	"ax_ptz_control_queue_request",
+	"ax_ptz_movement_handler_get_move_capabilities",
+	"ax_ptz_movement_handler_is_ptz_moving",
+	"ax_ptz_movement_handler_get_ptz_status",
+	"ax_ptz_movement_handler_get_ptz_limits",
+	"ax_ptz_movement_handler_set_absolute_spaces",
+	"ax_ptz_absolute_movement_create",
+	"ax_ptz_absolute_movement_set_pan_tilt_zoom",
+	"ax_ptz_absolute_movement_destroy",
+	"ax_ptz_movement_handler_absolute_move",
+	"ax_ptz_movement_handler_set_relative_spaces",
+	"ax_ptz_relative_movement_create",
+	"ax_ptz_relative_movement_set_pan_tilt_zoom",
+	"ax_ptz_relative_movement_destroy",
+	"ax_ptz_movement_handler_relative_move",
+	"ax_ptz_movement_handler_set_continuous_spaces",
+	"ax_ptz_continuous_movement_create",
+	"ax_ptz_continuous_movement_set_pan_tilt_zoom",
+	"ax_ptz_continuous_movement_destroy",
+	"ax_ptz_movement_handler_continuous_start",
+	"ax_ptz_movement_handler_continuous_stop",
+	"ax_ptz_preset_handler_query_presets",
+	"ax_ptz_preset_handler_goto_preset_number"
+};
+
+static gpointer prof_real[PROF_CALLS];
+static PTZPROF_SHM prof_private;//when there is no shared memory
+static PTZPROF_SHM *prof_shm = &prof_private;
+static gchar prof_shm_name[32];
+static GMutex prof_lock;
+static sigset_t prof_signals;
+
+static gint64 prof_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * The next definition of <id> after this library, the axptz one
+ */
+static gpointer prof_lookup(PROF_CALL_ID id)
+{
+	gpointer real = g_atomic_pointer_get(&prof_real[id]);
+
+	if(real == NULL)
+	{
+		if((real = dlsym(RTLD_NEXT, prof_names[id])) == NULL)
+		{
+			fprintf(stderr, "ptzprof: no %s to wrap: %s\n", prof_names[id], dlerror());
+			abort();
+		}
+		g_atomic_pointer_set(&prof_real[id], real);
+	}
+	return real;
+}
+
+static void prof_record(PROF_CALL_ID id, gint64 ns, gboolean failed)
+{
+	PTZPROF_CALL *call = &prof_shm->call[id];
+	guint64 us = (guint64)MAX(ns, 0) / 1000;
+	gint bucket = 0;
+
+	while(bucket < PTZPROF_BUCKETS - 1 && (us >> (bucket + 1)) != 0)
+		bucket ++;
+	g_mutex_lock(&prof_lock);
+	call->calls ++;
+	if(failed)
+		call->errors ++;
+	call->total_ns += ns;
+	call->max_ns = MAX(call->max_ns, (guint64)ns);
+	call->buckets[bucket] ++;
+	g_mutex_unlock(&prof_lock);
+}
+
+/*
+ * Upper bound in us of the bucket that holds <fraction> of the calls
+ */
+static guint64 prof_percentile(const PTZPROF_CALL *call, gdouble fraction)
+{
+	guint64 seen = 0;
+	gint bucket;
+
+	for(bucket = 0 ; bucket < PTZPROF_BUCKETS ; bucket ++)
+	{
+		seen += call->buckets[bucket];
+		if(seen >= fraction * call->calls)
+			break;
+	}
+	return (guint64)2 << MIN(bucket, PTZPROF_BUCKETS - 1);
+}
+
+static void prof_dump(void)
+{
+	const gchar *output = g_getenv("PTZPROF_OUTPUT");
+	g_autofree gchar *path = output ? g_strdup(output) : g_strdup_printf("%s.%d.txt", PTZPROF_DEFAULT_OUTPUT, getpid());
+	PTZPROF_CALL calls[PROF_CALLS];
+	guint64 total_ns = 0;
+	FILE *file;
+	gint order[PROF_CALLS];
+	gint i;
+	gint j;
+
+	g_mutex_lock(&prof_lock);
+	memcpy(calls, prof_shm->call, sizeof(calls));
+	g_mutex_unlock(&prof_lock);
+
+	/* the calls that cost the most time first */
+	for(i = 0 ; i < PROF_CALLS ; i ++)
+	{
+		total_ns += calls[i].total_ns;
+		for(j = i ; j > 0 && calls[order[j - 1]].total_ns < calls[i].total_ns ; j --)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	if((file = fopen(path, "a")) == NULL)
+	{
+		fprintf(stderr, "ptzprof: can not write %s\n", path);
+		return;
+	}
+	fprintf(file, "ptzprof pid %d, %.1f s profiled, %.3f s in axptz\n", getpid(),
+		(g_get_monotonic_time() - prof_shm->start_us) / (gdouble)G_USEC_PER_SEC, total_ns / 1e9);
+	fprintf(file, "%-46s %9s %6s %6s %10s %8s %8s %8s %10s\n", "call", "calls", "errors", "time%", "mean us", "p50 <us", "p90 <us", "p99 <us", "max us");
+	for(i = 0 ; i < PROF_CALLS ; i ++)
+	{
+		const PTZPROF_CALL *call = &calls[order[i]];
+
+		if(call->calls == 0)
+			continue;
+		fprintf(file, "%-46s %9" G_GUINT64_FORMAT " %6" G_GUINT64_FORMAT " %5.1f%% %10.1f %8" G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT " %10.1f\n",
+			call->name, call->calls, call->errors, total_ns ? 100.0 * call->total_ns / total_ns : 0.0, call->total_ns / 1000.0 / call->calls,
+			prof_percentile(call, 0.5), prof_percentile(call, 0.9), prof_percentile(call, 0.99), call->max_ns / 1000.0);
+	}
+	fprintf(file, "\n");
+	fclose(file);
+}
+
+static void *prof_signal_thread(void *data)
+{
+	gint signal;
+
+	while(sigwait(&prof_signals, &signal) == 0)
+		prof_dump();
+	return NULL;
+}
+
+/*
+ * Map the profile and start the dump thread before main(). PTZPROF_SIGNAL
+ * is blocked here, in the main thread, so every thread created later has
+ * it blocked too and only sigwait() takes it.
+ */
+__attribute__((constructor)) static void prof_init(void)
+{
+	pthread_t thread;
+	gint fd;
+	gint i;
+
+	g_snprintf(prof_shm_name, sizeof(prof_shm_name), "%s%d", PTZPROF_SHM_PREFIX, getpid());
+	if((fd = shm_open(prof_shm_name, O_RDWR | O_CREAT, 0644)) >= 0)
+	{
+		void *map = MAP_FAILED;
+
+		if(ftruncate(fd, sizeof(PTZPROF_SHM)) == 0)
+			map = mmap(NULL, sizeof(PTZPROF_SHM), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(map != MAP_FAILED)
+			prof_shm = map;
+		else
+			shm_unlink(prof_shm_name);
+	}
+	if(prof_shm == &prof_private)
+		fprintf(stderr, "ptzprof: no shared memory %s, profiling in private memory\n", prof_shm_name);
+
+	memset(prof_shm, 0, sizeof(*prof_shm));
+	memcpy(prof_shm->magic, PTZPROF_MAGIC, sizeof(prof_shm->magic));
+	prof_shm->version = PTZPROF_VERSION;
+	prof_shm->pid = getpid();
+	prof_shm->start_us = g_get_monotonic_time();
+	prof_shm->count = PROF_CALLS;
+	for(i = 0 ; i < PROF_CALLS ; i ++)
+		g_strlcpy(prof_shm->call[i].name, prof_names[i], PTZPROF_NAME_LENGTH);
+
+	sigemptyset(&prof_signals);
+	sigaddset(&prof_signals, PTZPROF_SIGNAL);
+	pthread_sigmask(SIG_BLOCK, &prof_signals, NULL);
+	if(pthread_create(&thread, NULL, prof_signal_thread, NULL) == 0)
+		pthread_detach(thread);
+}
+
+__attribute__((destructor)) static void prof_fini(void)
+{
+	prof_dump();
+	if(prof_shm != &prof_private)
+	{
+		munmap(prof_shm, sizeof(PTZPROF_SHM));
+		prof_shm = &prof_private;
+		shm_unlink(prof_shm_name);
+	}
+}
+
+/*
+ * <name><params> calls the real <name><args> and records it as <id>; a set
+ * error counts as an error, not a NULL result, since an empty GList is NULL.
+ * When the caller passes no error the call gets a local one.
+ */
+#define PROF_WRAP(id, type, name, params, args) \
+	type name params \
+	{ \
+		type (*real) params = prof_lookup(id); \
+		GError *prof_error = NULL; \
+		gint64 start; \
+		type result; \
+		if(error == NULL) \
+			error = &prof_error; \
+		start = prof_now_ns(); \
+		result = real args; \
+		prof_record(id, prof_now_ns() - start, *error != NULL); \
+		g_clear_error(&prof_error); \
+		return result; \
+	}
+
+PROF_WRAP(PROF_CREATE, gboolean, ax_ptz_create, (GError **error), (error))
+PROF_WRAP(PROF_DESTROY, gboolean, ax_ptz_destroy, (GError **error), (error))
+PROF_WRAP(PROF_GET_APP_GROUP_INSTANCE, AXPTZControlQueueGroup *, ax_ptz_control_queue_get_app_group_instance, (GError **error), (error))
+PROF_WRAP(PROF_CONTROL_QUEUE_REQUEST, gboolean, ax_ptz_control_queue_request,
+	(AXPTZControlQueueGroup *group, gint channel, AXPTZControlQueueRequest request, gint *queue_pos, gint *time_to_pos_one, gint *poll_time, GError **error),
+	(group, channel, request, queue_pos, time_to_pos_one, poll_time, error))
+
+PROF_WRAP(PROF_GET_MOVE_CAPABILITIES, GList *, ax_ptz_movement_handler_get_move_capabilities, (gint channel, GError **error), (channel, error))
+PROF_WRAP(PROF_IS_PTZ_MOVING, gboolean, ax_ptz_movement_handler_is_ptz_moving, (gint channel, gboolean *is_moving, GError **error), (channel, is_moving, error))
+PROF_WRAP(PROF_GET_PTZ_STATUS, gboolean, ax_ptz_movement_handler_get_ptz_status,
+	(gint channel, AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementZoomSpace zoom_space, AXPTZStatus **status, GError **error),
+	(channel, pan_tilt_space, zoom_space, status, error))
+PROF_WRAP(PROF_GET_PTZ_LIMITS, gboolean, ax_ptz_movement_handler_get_ptz_limits,
+	(gint channel, AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementZoomSpace zoom_space, AXPTZLimits **limits, GError **error),
+	(channel, pan_tilt_space, zoom_space, limits, error))
+
+PROF_WRAP(PROF_SET_ABSOLUTE_SPACES, gboolean, ax_ptz_movement_handler_set_absolute_spaces,
+	(AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, AXPTZMovementZoomSpace zoom_space, GError **error),
+	(pan_tilt_space, pan_tilt_speed_space, zoom_space, error))
+PROF_WRAP(PROF_ABSOLUTE_MOVEMENT_CREATE, AXPTZAbsoluteMovement *, ax_ptz_absolute_movement_create, (GError **error), (error))
+PROF_WRAP(PROF_ABSOLUTE_MOVEMENT_SET, gboolean, ax_ptz_absolute_movement_set_pan_tilt_zoom,
+	(AXPTZAbsoluteMovement *movement, fixed_t pan, fixed_t tilt, fixed_t pan_tilt_speed, fixed_t zoom, fixed_t zoom_speed, GError **error),
+	(movement, pan, tilt, pan_tilt_speed, zoom, zoom_speed, error))
+PROF_WRAP(PROF_ABSOLUTE_MOVEMENT_DESTROY, gboolean, ax_ptz_absolute_movement_destroy, (AXPTZAbsoluteMovement *movement, GError **error), (movement, error))
+PROF_WRAP(PROF_ABSOLUTE_MOVE, gboolean, ax_ptz_movement_handler_absolute_move,
+	(AXPTZControlQueueGroup *group, gint channel, AXPTZAbsoluteMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error),
+	(group, channel, movement, invoke, callback, user_data, error))
+
+PROF_WRAP(PROF_SET_RELATIVE_SPACES, gboolean, ax_ptz_movement_handler_set_relative_spaces,
+	(AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, AXPTZMovementZoomSpace zoom_space, GError **error),
+	(pan_tilt_space, pan_tilt_speed_space, zoom_space, error))
+PROF_WRAP(PROF_RELATIVE_MOVEMENT_CREATE, AXPTZRelativeMovement *, ax_ptz_relative_movement_create, (GError **error), (error))
+PROF_WRAP(PROF_RELATIVE_MOVEMENT_SET, gboolean, ax_ptz_relative_movement_set_pan_tilt_zoom,
+	(AXPTZRelativeMovement *movement, fixed_t pan, fixed_t tilt, fixed_t pan_tilt_speed, fixed_t zoom, fixed_t zoom_speed, GError **error),
+	(movement, pan, tilt, pan_tilt_speed, zoom, zoom_speed, error))
+PROF_WRAP(PROF_RELATIVE_MOVEMENT_DESTROY, gboolean, ax_ptz_relative_movement_destroy, (AXPTZRelativeMovement *movement, GError **error), (movement, error))
+PROF_WRAP(PROF_RELATIVE_MOVE, gboolean, ax_ptz_movement_handler_relative_move,
+	(AXPTZControlQueueGroup *group, gint channel, AXPTZRelativeMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error),
+	(group, channel, movement, invoke, callback, user_data, error))
+
+PROF_WRAP(PROF_SET_CONTINUOUS_SPACES, gboolean, ax_ptz_movement_handler_set_continuous_spaces,
+	(AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, GError **error),
+	(pan_tilt_speed_space, error))
+PROF_WRAP(PROF_CONTINUOUS_MOVEMENT_CREATE, AXPTZContinuousMovement *, ax_ptz_continuous_movement_create, (GError **error), (error))
+PROF_WRAP(PROF_CONTINUOUS_MOVEMENT_SET, gboolean, ax_ptz_continuous_movement_set_pan_tilt_zoom,
+	(AXPTZContinuousMovement *movement, fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_speed, fixed_t timeout, GError **error),
+	(movement, pan_speed, tilt_speed, zoom_speed, timeout, error))
+PROF_WRAP(PROF_CONTINUOUS_MOVEMENT_DESTROY, gboolean, ax_ptz_continuous_movement_destroy, (AXPTZContinuousMovement *movement, GError **error), (movement, error))
+PROF_WRAP(PROF_CONTINUOUS_START, gboolean, ax_ptz_movement_handler_continuous_start,
+	(AXPTZControlQueueGroup *group, gint channel, AXPTZContinuousMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error),
+	(group, channel, movement, invoke, callback, user_data, error))
+PROF_WRAP(PROF_CONTINUOUS_STOP, gboolean, ax_ptz_movement_handler_continuous_stop,
+	(AXPTZControlQueueGroup *group, gint channel, gboolean stop_pan_tilt, gboolean stop_zoom, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error),
+	(group, channel, stop_pan_tilt, stop_zoom, invoke, callback, user_data, error))
+
+PROF_WRAP(PROF_QUERY_PRESETS, GList *, ax_ptz_preset_handler_query_presets, (AXPTZControlQueueGroup *group, gint channel, gboolean only_home, GError **error), (group, channel, only_home, error))
+PROF_WRAP(PROF_GOTO_PRESET_NUMBER, gboolean, ax_ptz_preset_handler_goto_preset_number,
+	(AXPTZControlQueueGroup *group, gint channel, gint preset_number, fixed_t speed, AXPTZPresetMovementSpace speed_space, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error),
+	(group, channel, preset_number, speed, speed_space, invoke, callback, user_data, error))
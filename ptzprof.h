@@ -0,0 +1,46 @@
+/*
+ * axptz call profile kept by libptzprof.so in POSIX shared memory.
+ *
+ * One record per wrapped ax_ptz_* function: call and error counts, total
+ * and longest latency, and a histogram in power of two microsecond
+ * buckets, bucket 0 for calls under 2 us and bucket b for calls from
+ * 2^b us. The object is named PTZPROF_SHM_PREFIX<pid> and removed when the
+ * profiled process exits; SIGUSR1 writes the table out as text.
+ */
+#ifndef __PTZPROF_H__
+#define __PTZPROF_H__
+
+#include <glib.h>
+
+#define PTZPROF_SHM_PREFIX "/ptzprof-"
+#define PTZPROF_MAGIC "PTZPROF"
+#define PTZPROF_VERSION 1
+#define PTZPROF_SIGNAL SIGUSR1
+#define PTZPROF_DEFAULT_OUTPUT "/tmp/ptzprof"	/* .<pid>.txt appended */
+#define PTZPROF_BUCKETS 24
+#define PTZPROF_NAME_LENGTH 48
+#define PTZPROF_MAX_CALLS 32
+
+typedef struct PTZPROF_CALL{
+
+	gchar name[PTZPROF_NAME_LENGTH];
+	guint64 calls;
+	guint64 errors;		/* GError set */
+	guint64 total_ns;
+	guint64 max_ns;
+	guint64 buckets[PTZPROF_BUCKETS];
+
+}PTZPROF_CALL;
+
+typedef struct PTZPROF_SHM{
+
+	gchar magic[8];
+	guint32 version;
+	gint32 pid;
+	gint64 start_us;	/* monotonic time the profile started */
+	gint32 count;		/* records in use */
+	PTZPROF_CALL call[PTZPROF_MAX_CALLS];
+
+}PTZPROF_SHM;
+
+#endif
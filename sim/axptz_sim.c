@@ -0,0 +1,938 @@
+/*
+ * Simulated axptz/axparameter backend for running panoramatv on a Linux host.
+ *
+ * It models one PTZ head with per-axis speed limits and answers the subset of
+ * the axptz, axparameter and licensekey calls that axauto.c uses. Positions
+ * and speeds are in the unitless spaces, with the limits of the camera the
+ * tour was developed on.
+ *
+ * Environment:
+ *   AXPTZ_SIM_TIMESCALE   run the model this many times faster than real time
+ *   AXPTZ_SIM_LATENCY_US  extra latency added to every axptz call
+ *   AXPTZ_SIM_PRESETS     preset file, one "index name pan tilt zoom" per line
+ *   AXPTZ_SIM_PREEMPT_EVERY  model seconds between operator takeovers
+ *   AXPTZ_SIM_PREEMPT_FOR    model seconds an operator keeps the control
+ *   AXPTZ_SIM_JOYSTICK    operator joystick script for teach mode, one
+ *                         "seconds pan_speed tilt_speed zoom_speed" per line
+ *   AXPTZ_SIM_FAIL_EVERY  model seconds between bursts of failing calls
+ *   AXPTZ_SIM_FAIL_FOR    model seconds every call fails in a burst
+ *   AXPARAMETER_SIM_FILE  parameter file, defaults to ./param.conf
+ *
+ * SIGHUP re-reads the parameter file and calls the registered parameter
+ * callbacks for values that changed, like a change in the camera's web page.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <axsdk/axptz.h>
+#include <axsdk/axparameter.h>
+#include <licensekey.h>
+
+#define SIM_FRAC_BITS 16
+
+#define SIM_PAN_MIN -32768
+#define SIM_PAN_MAX 32768
+#define SIM_TILT_MIN -16384
+#define SIM_TILT_MAX 3641
+#define SIM_ZOOM_MIN 3
+#define SIM_ZOOM_MAX 35748
+
+/* unitless units per second at unitless speed 1.0 */
+#define SIM_PAN_RATE (700.0 * 32768.0 / 180.0)
+#define SIM_TILT_RATE (500.0 * 16384.0 / 90.0)
+#define SIM_ZOOM_RATE ((SIM_ZOOM_MAX - SIM_ZOOM_MIN) / 3.0)
+
+#define SIM_MAX_PRESETS 64
+
+/* how far the simulated operator pans away while holding the control */
+#define SIM_PREEMPT_PAN_OFFSET 8000
+
+#define SIM_MAX_JOYSTICK_MOVES 256
+
+typedef enum
+{
+	SIM_AXIS_IDLE,
+	SIM_AXIS_VELOCITY,
+	SIM_AXIS_TARGET
+} SIM_AXIS_MODE;
+
+typedef struct SIM_AXIS{
+
+	SIM_AXIS_MODE mode;
+	gdouble pos;
+	gdouble rate;
+	gdouble target;
+	gdouble min;
+	gdouble max;
+	gboolean wraps;
+
+}SIM_AXIS;
+
+typedef struct SIM_PRESET{
+
+	gint index;
+	gchar *name;
+	gdouble pan;
+	gdouble tilt;
+	gdouble zoom;
+
+}SIM_PRESET;
+
+typedef struct SIM_JOYSTICK_MOVE{
+
+	gint64 end_us;		/* model time from ax_ptz_create */
+	gdouble speed[3];	/* unitless pan/tilt/zoom speed */
+
+}SIM_JOYSTICK_MOVE;
+
+struct _AXPTZControlQueueGroup
+{
+	gint id;
+};
+
+struct _AXPTZAbsoluteMovement
+{
+	fixed_t pan;
+	fixed_t tilt;
+	fixed_t speed;
+	fixed_t zoom;
+	fixed_t zoom_speed;
+};
+
+struct _AXPTZRelativeMovement
+{
+	fixed_t pan;
+	fixed_t tilt;
+	fixed_t speed;
+	fixed_t zoom;
+	fixed_t zoom_speed;
+};
+
+struct _AXPTZContinuousMovement
+{
+	fixed_t pan_speed;
+	fixed_t tilt_speed;
+	fixed_t zoom_speed;
+	fixed_t timeout;
+};
+
+typedef struct SIM_PARAMETER_WATCH{
+
+	gchar *name;
+	AXParameterCallback callback;
+	gpointer data;
+
+}SIM_PARAMETER_WATCH;
+
+struct _AXParameter
+{
+	GHashTable *values;
+	gchar *path;
+	GList *watches;
+	guint reload_source;
+};
+
+static GMutex sim_lock;
+static gboolean sim_created = FALSE;
+static AXPTZControlQueueGroup sim_group = { 1 };
+
+static SIM_AXIS sim_pan = { SIM_AXIS_IDLE, 0, 0, 0, SIM_PAN_MIN, SIM_PAN_MAX, TRUE };
+static SIM_AXIS sim_tilt = { SIM_AXIS_IDLE, 0, 0, 0, SIM_TILT_MIN, SIM_TILT_MAX, FALSE };
+static SIM_AXIS sim_zoom = { SIM_AXIS_IDLE, SIM_ZOOM_MIN, 0, 0, SIM_ZOOM_MIN, SIM_ZOOM_MAX, FALSE };
+
+static gint64 sim_last_update = 0;
+static gint64 sim_continuous_end = 0;
+static gdouble sim_timescale = 1.0;
+static gulong sim_latency_us = 0;
+
+static gint64 sim_preempt_every_us = 0;
+static gint64 sim_preempt_for_us = 0;
+static gint64 sim_preempt_origin = 0;
+static gboolean sim_preempt_active = FALSE;
+static gint sim_preempt_commands = 0;
+
+/* failure bursts keep their schedule across ax_ptz_destroy/ax_ptz_create */
+static gint64 sim_fail_every_us = 0;
+static gint64 sim_fail_for_us = 0;
+static gint64 sim_fail_origin = 0;
+static gint sim_fail_count = 0;
+
+static SIM_PRESET sim_presets[SIM_MAX_PRESETS];
+static gint sim_preset_count = 0;
+
+static SIM_JOYSTICK_MOVE sim_joystick[SIM_MAX_JOYSTICK_MOVES];
+static gint sim_joystick_count = 0;
+static gint sim_joystick_step = 0;
+static gint64 sim_joystick_origin = 0;
+
+static GQuark sim_error_quark(void)
+{
+	return g_quark_from_static_string("axptz-sim-error");
+}
+
+/*
+ * Model time in microseconds, scaled by AXPTZ_SIM_TIMESCALE
+ */
+static gint64 sim_now(void)
+{
+	static gint64 start = 0;
+	gint64 now = g_get_monotonic_time();
+
+	if(start == 0)
+		start = now;
+	return start + (gint64)((now - start) * sim_timescale);
+}
+
+static void sim_axis_advance(SIM_AXIS *axis, gdouble dt)
+{
+	gdouble step;
+
+	if(axis->mode == SIM_AXIS_VELOCITY)
+	{
+		axis->pos += axis->rate * dt;
+		if(axis->wraps)
+		{
+			gdouble range = axis->max - axis->min;
+			while(axis->pos > axis->max)
+				axis->pos -= range;
+			while(axis->pos < axis->min)
+				axis->pos += range;
+		}
+		else if(axis->pos > axis->max || axis->pos < axis->min)
+		{
+			axis->pos = CLAMP(axis->pos, axis->min, axis->max);
+			axis->mode = SIM_AXIS_IDLE;
+		}
+	}
+	else if(axis->mode == SIM_AXIS_TARGET)
+	{
+		step = axis->rate * dt;
+		if(ABS(axis->target - axis->pos) <= step)
+		{
+			axis->pos = axis->target;
+			axis->mode = SIM_AXIS_IDLE;
+		}
+		else
+		{
+			axis->pos += (axis->target > axis->pos) ? step : -step;
+		}
+	}
+}
+
+static void sim_axis_joystick(SIM_AXIS *axis, gdouble speed, gdouble full_rate)
+{
+	axis->mode = (speed != 0) ? SIM_AXIS_VELOCITY : SIM_AXIS_IDLE;
+	axis->rate = speed * full_rate;
+}
+
+/*
+ * Play the joystick moves that started up to <now>, the model advanced to
+ * each switch so the path does not depend on how often it is polled
+ */
+static void sim_joystick_update(gint64 now)
+{
+	while(sim_joystick_step <= sim_joystick_count)
+	{
+		gint64 boundary = sim_joystick_origin + ((sim_joystick_step > 0) ? sim_joystick[sim_joystick_step - 1].end_us : 0);
+		const SIM_JOYSTICK_MOVE *move = &sim_joystick[sim_joystick_step];
+		gdouble dt;
+
+		if(now < boundary)
+			break;
+		if(boundary > sim_last_update)
+		{
+			dt = (gdouble)(boundary - sim_last_update) / G_USEC_PER_SEC;
+			sim_axis_advance(&sim_pan, dt);
+			sim_axis_advance(&sim_tilt, dt);
+			sim_axis_advance(&sim_zoom, dt);
+			sim_last_update = boundary;
+		}
+		/* the joystick lets go after the last move */
+		sim_axis_joystick(&sim_pan, (sim_joystick_step < sim_joystick_count) ? move->speed[0] : 0, SIM_PAN_RATE);
+		sim_axis_joystick(&sim_tilt, (sim_joystick_step < sim_joystick_count) ? move->speed[1] : 0, SIM_TILT_RATE);
+		sim_axis_joystick(&sim_zoom, (sim_joystick_step < sim_joystick_count) ? move->speed[2] : 0, SIM_ZOOM_RATE);
+		sim_joystick_step ++;
+	}
+}
+
+/*
+ * Bring the model up to the current time, caller holds sim_lock
+ */
+static void sim_update(void)
+{
+	gint64 now = sim_now();
+	gdouble dt;
+
+	if(sim_last_update == 0)
+		sim_last_update = now;
+	if(sim_joystick_count > 0)
+		sim_joystick_update(now);
+	if(sim_continuous_end != 0 && now >= sim_continuous_end)
+	{
+		/* the continuous timeout expired in this interval */
+		dt = (gdouble)(sim_continuous_end - sim_last_update) / G_USEC_PER_SEC;
+		sim_axis_advance(&sim_pan, dt);
+		sim_axis_advance(&sim_tilt, dt);
+		sim_axis_advance(&sim_zoom, dt);
+		if(sim_pan.mode == SIM_AXIS_VELOCITY)
+			sim_pan.mode = SIM_AXIS_IDLE;
+		if(sim_tilt.mode == SIM_AXIS_VELOCITY)
+			sim_tilt.mode = SIM_AXIS_IDLE;
+		if(sim_zoom.mode == SIM_AXIS_VELOCITY)
+			sim_zoom.mode = SIM_AXIS_IDLE;
+		sim_last_update = sim_continuous_end;
+		sim_continuous_end = 0;
+	}
+	dt = (gdouble)(now - sim_last_update) / G_USEC_PER_SEC;
+	sim_axis_advance(&sim_pan, dt);
+	sim_axis_advance(&sim_tilt, dt);
+	sim_axis_advance(&sim_zoom, dt);
+	sim_last_update = now;
+}
+
+static void sim_axis_velocity(SIM_AXIS *axis, fixed_t speed, gdouble full_rate)
+{
+	gdouble rate = fx_xtod(speed, SIM_FRAC_BITS) * full_rate;
+
+	axis->mode = (rate != 0) ? SIM_AXIS_VELOCITY : SIM_AXIS_IDLE;
+	axis->rate = rate;
+}
+
+static void sim_axis_target(SIM_AXIS *axis, gdouble target, gdouble speed, gdouble full_rate)
+{
+	axis->target = CLAMP(target, axis->min, axis->max);
+	axis->rate = ABS(speed) * full_rate;
+	axis->mode = (axis->rate > 0 && axis->target != axis->pos) ? SIM_AXIS_TARGET : SIM_AXIS_IDLE;
+}
+
+static gdouble sim_speed(fixed_t speed)
+{
+	if(speed == AX_PTZ_MOVEMENT_NO_VALUE)
+		return 1.0;
+	return CLAMP(fx_xtod(speed, SIM_FRAC_BITS), 0.0, 1.0);
+}
+
+/*
+ * Every simulated call goes through here: latency, then a model update, the
+ * operator takeover schedule and the failure bursts
+ */
+static gint64 sim_preempt_remaining(void);
+
+static gboolean sim_enter(GError **error)
+{
+	if(sim_latency_us > 0)
+		g_usleep(sim_latency_us);
+	g_mutex_lock(&sim_lock);
+	if(!sim_created)
+	{
+		g_mutex_unlock(&sim_lock);
+		g_set_error(error, sim_error_quark(), 1, "axptz library not created");
+		return FALSE;
+	}
+	sim_update();
+	sim_preempt_remaining();
+	if(sim_fail_every_us > 0 && sim_fail_for_us > 0 && (sim_now() - sim_fail_origin) % sim_fail_every_us >= sim_fail_every_us - sim_fail_for_us)
+	{
+		sim_fail_count ++;
+		g_mutex_unlock(&sim_lock);
+		g_set_error(error, sim_error_quark(), 4, "simulated axptz failure");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void sim_leave(void)
+{
+	g_mutex_unlock(&sim_lock);
+}
+
+/*
+ * Model time left in the current operator takeover, 0 when the application
+ * has the control. Entering a takeover stops the tour and pans away from it.
+ * Caller holds sim_lock.
+ */
+static gint64 sim_preempt_remaining(void)
+{
+	gint64 t;
+	gint64 phase;
+
+	if(sim_preempt_every_us <= 0 || sim_preempt_for_us <= 0)
+		return 0;
+	t = sim_last_update - sim_preempt_origin;
+	phase = t % sim_preempt_every_us;
+	if(t < sim_preempt_every_us || phase >= sim_preempt_for_us)
+	{
+		sim_preempt_active = FALSE;
+		return 0;
+	}
+	if(!sim_preempt_active)
+	{
+		sim_preempt_active = TRUE;
+		sim_continuous_end = 0;
+		sim_axis_target(&sim_pan, sim_pan.pos + SIM_PREEMPT_PAN_OFFSET, 1.0, SIM_PAN_RATE);
+		sim_axis_target(&sim_tilt, sim_tilt.pos, 1.0, SIM_TILT_RATE);
+		sim_axis_target(&sim_zoom, sim_zoom.pos, 1.0, SIM_ZOOM_RATE);
+	}
+	return sim_preempt_for_us - phase;
+}
+
+/*
+ * Movement requests from an application without the control are dropped
+ */
+static gboolean sim_command_ignored(void)
+{
+	if(!sim_preempt_active)
+		return FALSE;
+	sim_preempt_commands ++;
+	return TRUE;
+}
+
+static void sim_add_preset(gint index, const gchar *name, gdouble pan, gdouble tilt, gdouble zoom)
+{
+	if(sim_preset_count >= SIM_MAX_PRESETS)
+		return;
+	sim_presets[sim_preset_count].index = index;
+	sim_presets[sim_preset_count].name = g_strdup(name);
+	sim_presets[sim_preset_count].pan = pan;
+	sim_presets[sim_preset_count].tilt = tilt;
+	sim_presets[sim_preset_count].zoom = zoom;
+	sim_preset_count ++;
+}
+
+static void sim_load_presets(void)
+{
+	const gchar *path = g_getenv("AXPTZ_SIM_PRESETS");
+	gchar *contents = NULL;
+	gchar **lines;
+	gint i;
+
+	if(path == NULL || !g_file_get_contents(path, &contents, NULL, NULL))
+	{
+		sim_add_preset(1, "presetposno1", 0, 0, SIM_ZOOM_MIN);
+		sim_add_preset(2, "presetposno2=1_2000", -20000, -2000, 4000);
+		sim_add_preset(3, "presetposno3=2_1000", -6000, -4000, 12000);
+		sim_add_preset(4, "presetposno4=3_1000", 9000, -1000, 8000);
+		sim_add_preset(5, "presetposno5=4_2000", 24000, -6000, 20000);
+		return;
+	}
+
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL ; i ++)
+	{
+		gint index;
+		gchar name[64];
+		gdouble pan, tilt, zoom;
+
+		if(lines[i][0] == '#')
+			continue;
+		if(sscanf(lines[i], "%d %63s %lf %lf %lf", &index, name, &pan, &tilt, &zoom) == 5)
+			sim_add_preset(index, name, pan, tilt, zoom);
+	}
+	g_strfreev(lines);
+	g_free(contents);
+}
+
+static void sim_load_joystick(void)
+{
+	const gchar *path = g_getenv("AXPTZ_SIM_JOYSTICK");
+	gchar *contents = NULL;
+	gchar **lines;
+	gint64 end_us = 0;
+	gint i;
+
+	sim_joystick_count = 0;
+	sim_joystick_step = 0;
+	if(path == NULL || !g_file_get_contents(path, &contents, NULL, NULL))
+		return;
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL && sim_joystick_count < SIM_MAX_JOYSTICK_MOVES ; i ++)
+	{
+		SIM_JOYSTICK_MOVE *move = &sim_joystick[sim_joystick_count];
+		gdouble seconds;
+
+		if(lines[i][0] == '#')
+			continue;
+		if(sscanf(lines[i], "%lf %lf %lf %lf", &seconds, &move->speed[0], &move->speed[1], &move->speed[2]) != 4)
+			continue;
+		end_us += (gint64)(seconds * G_USEC_PER_SEC);
+		move->end_us = end_us;
+		sim_joystick_count ++;
+	}
+	g_strfreev(lines);
+	g_free(contents);
+}
+
+gboolean ax_ptz_create(GError **error)
+{
+	const gchar *env;
+
+	g_mutex_lock(&sim_lock);
+	if((env = g_getenv("AXPTZ_SIM_TIMESCALE")) != NULL)
+		sim_timescale = MAX(g_ascii_strtod(env, NULL), 0.001);
+	if((env = g_getenv("AXPTZ_SIM_LATENCY_US")) != NULL)
+		sim_latency_us = (gulong)g_ascii_strtoull(env, NULL, 10);
+	if((env = g_getenv("AXPTZ_SIM_PREEMPT_EVERY")) != NULL)
+		sim_preempt_every_us = (gint64)(g_ascii_strtod(env, NULL) * G_USEC_PER_SEC);
+	if((env = g_getenv("AXPTZ_SIM_PREEMPT_FOR")) != NULL)
+		sim_preempt_for_us = (gint64)(g_ascii_strtod(env, NULL) * G_USEC_PER_SEC);
+	if((env = g_getenv("AXPTZ_SIM_FAIL_EVERY")) != NULL)
+		sim_fail_every_us = (gint64)(g_ascii_strtod(env, NULL) * G_USEC_PER_SEC);
+	if((env = g_getenv("AXPTZ_SIM_FAIL_FOR")) != NULL)
+		sim_fail_for_us = (gint64)(g_ascii_strtod(env, NULL) * G_USEC_PER_SEC);
+	if(sim_fail_origin == 0)
+		sim_fail_origin = sim_now();
+	sim_preempt_origin = sim_now();
+	sim_preempt_active = FALSE;
+	sim_preempt_commands = 0;
+	if(sim_preset_count == 0)
+		sim_load_presets();
+	sim_load_joystick();
+	sim_joystick_origin = sim_now();
+	sim_created = TRUE;
+	sim_last_update = 0;
+	g_mutex_unlock(&sim_lock);
+	return TRUE;
+}
+
+gboolean ax_ptz_destroy(GError **error)
+{
+	gint i;
+
+	g_mutex_lock(&sim_lock);
+	sim_created = FALSE;
+	if(sim_preempt_every_us > 0 && sim_preempt_for_us > 0)
+		printf("axptz sim: %d commands ignored while preempted\n", sim_preempt_commands);
+	if(sim_fail_every_us > 0 && sim_fail_for_us > 0)
+		printf("axptz sim: %d calls failed so far\n", sim_fail_count);
+	for(i = 0 ; i < sim_preset_count ; i ++)
+		g_free(sim_presets[i].name);
+	sim_preset_count = 0;
+	g_mutex_unlock(&sim_lock);
+	return TRUE;
+}
+
+AXPTZControlQueueGroup *ax_ptz_control_queue_get_app_group_instance(GError **error)
+{
+	if(!sim_enter(error))
+		return NULL;
+	sim_leave();
+	return &sim_group;
+}
+
+gboolean ax_ptz_control_queue_request(AXPTZControlQueueGroup *group, gint channel, AXPTZControlQueueRequest request, gint *queue_pos, gint *time_to_pos_one, gint *poll_time, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	*queue_pos = (request == AX_PTZ_CONTROL_QUEUE_DROP) ? -1 : 1;
+	*time_to_pos_one = 0;
+	*poll_time = 1000;
+	if(request != AX_PTZ_CONTROL_QUEUE_DROP)
+	{
+		gint64 remaining = sim_preempt_remaining();
+
+		if(remaining > 0)
+		{
+			*queue_pos = 2;
+			*time_to_pos_one = (gint)(remaining / 1000);
+		}
+	}
+	sim_leave();
+	return TRUE;
+}
+
+GList *ax_ptz_movement_handler_get_move_capabilities(gint channel, GError **error)
+{
+	static const gchar *capabilities[] = {
+		"AX_PTZ_MOVE_ABS_PAN", "AX_PTZ_MOVE_ABS_TILT", "AX_PTZ_MOVE_ABS_ZOOM",
+		"AX_PTZ_MOVE_REL_PAN", "AX_PTZ_MOVE_REL_TILT", "AX_PTZ_MOVE_REL_ZOOM",
+		"AX_PTZ_MOVE_CONT_PAN", "AX_PTZ_MOVE_CONT_TILT", "AX_PTZ_MOVE_CONT_ZOOM",
+	};
+	GList *list = NULL;
+	guint i;
+
+	if(!sim_enter(error))
+		return NULL;
+	for(i = 0 ; i < G_N_ELEMENTS(capabilities) ; i ++)
+		list = g_list_append(list, g_strdup(capabilities[i]));
+	sim_leave();
+	return list;
+}
+
+gboolean ax_ptz_movement_handler_is_ptz_moving(gint channel, gboolean *is_moving, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	*is_moving = (sim_pan.mode != SIM_AXIS_IDLE || sim_tilt.mode != SIM_AXIS_IDLE || sim_zoom.mode != SIM_AXIS_IDLE);
+	sim_leave();
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_get_ptz_status(gint channel, AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementZoomSpace zoom_space, AXPTZStatus **status, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	*status = g_new0(AXPTZStatus, 1);
+	(*status)->pan_value = (fixed_t)sim_pan.pos;
+	(*status)->tilt_value = (fixed_t)sim_tilt.pos;
+	(*status)->zoom_value = (fixed_t)sim_zoom.pos;
+	sim_leave();
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_get_ptz_limits(gint channel, AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementZoomSpace zoom_space, AXPTZLimits **limits, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	*limits = g_new0(AXPTZLimits, 1);
+	(*limits)->min_pan_value = SIM_PAN_MIN;
+	(*limits)->max_pan_value = SIM_PAN_MAX;
+	(*limits)->min_tilt_value = SIM_TILT_MIN;
+	(*limits)->max_tilt_value = SIM_TILT_MAX;
+	(*limits)->min_zoom_value = SIM_ZOOM_MIN;
+	(*limits)->max_zoom_value = SIM_ZOOM_MAX;
+	sim_leave();
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_set_absolute_spaces(AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, AXPTZMovementZoomSpace zoom_space, GError **error)
+{
+	return TRUE;
+}
+
+AXPTZAbsoluteMovement *ax_ptz_absolute_movement_create(GError **error)
+{
+	return g_new0(AXPTZAbsoluteMovement, 1);
+}
+
+gboolean ax_ptz_absolute_movement_set_pan_tilt_zoom(AXPTZAbsoluteMovement *movement, fixed_t pan, fixed_t tilt, fixed_t pan_tilt_speed, fixed_t zoom, fixed_t zoom_speed, GError **error)
+{
+	movement->pan = pan;
+	movement->tilt = tilt;
+	movement->speed = pan_tilt_speed;
+	movement->zoom = zoom;
+	movement->zoom_speed = zoom_speed;
+	return TRUE;
+}
+
+gboolean ax_ptz_absolute_movement_destroy(AXPTZAbsoluteMovement *movement, GError **error)
+{
+	g_free(movement);
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_absolute_move(AXPTZControlQueueGroup *group, gint channel, AXPTZAbsoluteMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	if(sim_command_ignored())
+	{
+		sim_leave();
+		return TRUE;
+	}
+	sim_continuous_end = 0;
+	if(movement->pan != AX_PTZ_MOVEMENT_NO_VALUE)
+		sim_axis_target(&sim_pan, movement->pan, sim_speed(movement->speed), SIM_PAN_RATE);
+	if(movement->tilt != AX_PTZ_MOVEMENT_NO_VALUE)
+		sim_axis_target(&sim_tilt, movement->tilt, sim_speed(movement->speed), SIM_TILT_RATE);
+	if(movement->zoom != AX_PTZ_MOVEMENT_NO_VALUE)
+		sim_axis_target(&sim_zoom, movement->zoom, sim_speed(movement->zoom_speed), SIM_ZOOM_RATE);
+	sim_leave();
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_set_relative_spaces(AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, AXPTZMovementZoomSpace zoom_space, GError **error)
+{
+	return TRUE;
+}
+
+AXPTZRelativeMovement *ax_ptz_relative_movement_create(GError **error)
+{
+	return g_new0(AXPTZRelativeMovement, 1);
+}
+
+gboolean ax_ptz_relative_movement_set_pan_tilt_zoom(AXPTZRelativeMovement *movement, fixed_t pan, fixed_t tilt, fixed_t pan_tilt_speed, fixed_t zoom, fixed_t zoom_speed, GError **error)
+{
+	movement->pan = pan;
+	movement->tilt = tilt;
+	movement->speed = pan_tilt_speed;
+	movement->zoom = zoom;
+	movement->zoom_speed = zoom_speed;
+	return TRUE;
+}
+
+gboolean ax_ptz_relative_movement_destroy(AXPTZRelativeMovement *movement, GError **error)
+{
+	g_free(movement);
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_relative_move(AXPTZControlQueueGroup *group, gint channel, AXPTZRelativeMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	if(sim_command_ignored())
+	{
+		sim_leave();
+		return TRUE;
+	}
+	sim_continuous_end = 0;
+	if(movement->pan != AX_PTZ_MOVEMENT_NO_VALUE)
+		sim_axis_target(&sim_pan, sim_pan.pos + movement->pan, sim_speed(movement->speed), SIM_PAN_RATE);
+	if(movement->tilt != AX_PTZ_MOVEMENT_NO_VALUE)
+		sim_axis_target(&sim_tilt, sim_tilt.pos + movement->tilt, sim_speed(movement->speed), SIM_TILT_RATE);
+	if(movement->zoom != AX_PTZ_MOVEMENT_NO_VALUE)
+		sim_axis_target(&sim_zoom, sim_zoom.pos + movement->zoom, sim_speed(movement->zoom_speed), SIM_ZOOM_RATE);
+	sim_leave();
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_set_continuous_spaces(AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, GError **error)
+{
+	return TRUE;
+}
+
+AXPTZContinuousMovement *ax_ptz_continuous_movement_create(GError **error)
+{
+	return g_new0(AXPTZContinuousMovement, 1);
+}
+
+gboolean ax_ptz_continuous_movement_set_pan_tilt_zoom(AXPTZContinuousMovement *movement, fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_speed, fixed_t timeout, GError **error)
+{
+	movement->pan_speed = pan_speed;
+	movement->tilt_speed = tilt_speed;
+	movement->zoom_speed = zoom_speed;
+	movement->timeout = timeout;
+	return TRUE;
+}
+
+gboolean ax_ptz_continuous_movement_destroy(AXPTZContinuousMovement *movement, GError **error)
+{
+	g_free(movement);
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_continuous_start(AXPTZControlQueueGroup *group, gint channel, AXPTZContinuousMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	if(sim_command_ignored())
+	{
+		sim_leave();
+		return TRUE;
+	}
+	sim_axis_velocity(&sim_pan, movement->pan_speed, SIM_PAN_RATE);
+	sim_axis_velocity(&sim_tilt, movement->tilt_speed, SIM_TILT_RATE);
+	sim_axis_velocity(&sim_zoom, movement->zoom_speed, SIM_ZOOM_RATE);
+	sim_continuous_end = sim_last_update + (gint64)(fx_xtod(movement->timeout, SIM_FRAC_BITS) * G_USEC_PER_SEC);
+	sim_leave();
+	return TRUE;
+}
+
+gboolean ax_ptz_movement_handler_continuous_stop(AXPTZControlQueueGroup *group, gint channel, gboolean stop_pan_tilt, gboolean stop_zoom, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error)
+{
+	if(!sim_enter(error))
+		return FALSE;
+	if(sim_command_ignored())
+	{
+		sim_leave();
+		return TRUE;
+	}
+	if(stop_pan_tilt)
+	{
+		if(sim_pan.mode == SIM_AXIS_VELOCITY)
+			sim_pan.mode = SIM_AXIS_IDLE;
+		if(sim_tilt.mode == SIM_AXIS_VELOCITY)
+			sim_tilt.mode = SIM_AXIS_IDLE;
+	}
+	if(stop_zoom && sim_zoom.mode == SIM_AXIS_VELOCITY)
+		sim_zoom.mode = SIM_AXIS_IDLE;
+	sim_leave();
+	return TRUE;
+}
+
+GList *ax_ptz_preset_handler_query_presets(AXPTZControlQueueGroup *group, gint channel, gboolean only_home, GError **error)
+{
+	GList *list = NULL;
+	gint i;
+
+	if(!sim_enter(error))
+		return NULL;
+	for(i = 0 ; i < sim_preset_count ; i ++)
+		list = g_list_append(list, g_strdup(sim_presets[i].name));
+	sim_leave();
+	return list;
+}
+
+gboolean ax_ptz_preset_handler_goto_preset_number(AXPTZControlQueueGroup *group, gint channel, gint preset_number, fixed_t speed, AXPTZPresetMovementSpace speed_space, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error)
+{
+	gint i;
+
+	if(!sim_enter(error))
+		return FALSE;
+	if(sim_command_ignored())
+	{
+		sim_leave();
+		return TRUE;
+	}
+	for(i = 0 ; i < sim_preset_count ; i ++)
+	{
+		if(sim_presets[i].index == preset_number)
+		{
+			sim_continuous_end = 0;
+			sim_axis_target(&sim_pan, sim_presets[i].pan, sim_speed(speed), SIM_PAN_RATE);
+			sim_axis_target(&sim_tilt, sim_presets[i].tilt, sim_speed(speed), SIM_TILT_RATE);
+			sim_axis_target(&sim_zoom, sim_presets[i].zoom, sim_speed(speed), SIM_ZOOM_RATE);
+			sim_leave();
+			return TRUE;
+		}
+	}
+	sim_leave();
+	g_set_error(error, sim_error_quark(), 2, "no preset number %d", preset_number);
+	return FALSE;
+}
+
+/*
+ * Parameters are read from a param.conf style file: Name="value" per line
+ */
+static GHashTable *sim_parameter_load(const gchar *path, GError **error)
+{
+	GHashTable *values;
+	gchar *contents = NULL;
+	gchar **lines;
+	gint i;
+
+	if(!g_file_get_contents(path, &contents, NULL, error))
+		return NULL;
+
+	values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	lines = g_strsplit(contents, "\n", -1);
+	for(i = 0 ; lines[i] != NULL ; i ++)
+	{
+		gchar **kv;
+
+		if(lines[i][0] == '#' || strchr(lines[i], '=') == NULL)
+			continue;
+		kv = g_strsplit(lines[i], "=", 2);
+		g_strstrip(kv[0]);
+		g_strstrip(kv[1]);
+		if(kv[1][0] == '"')
+		{
+			gsize len = strlen(kv[1]);
+			if(len >= 2 && kv[1][len - 1] == '"')
+				kv[1][len - 1] = '\0';
+			memmove(kv[1], kv[1] + 1, strlen(kv[1]));
+		}
+		g_hash_table_replace(values, g_strdup(kv[0]), g_strdup(kv[1]));
+		g_strfreev(kv);
+	}
+	g_strfreev(lines);
+	g_free(contents);
+	return values;
+}
+
+/*
+ * SIGHUP: re-read the file and report changed watched values
+ */
+static gboolean sim_parameter_reload(gpointer data)
+{
+	AXParameter *parameter = data;
+	GError *local_error = NULL;
+	GHashTable *values = sim_parameter_load(parameter->path, &local_error);
+	GList *it;
+
+	if(values == NULL)
+	{
+		fprintf(stderr, "axparameter sim: %s\n", local_error->message);
+		g_error_free(local_error);
+		return G_SOURCE_CONTINUE;
+	}
+	for(it = parameter->watches ; it != NULL ; it = g_list_next(it))
+	{
+		SIM_PARAMETER_WATCH *watch = it->data;
+		const gchar *value = g_hash_table_lookup(values, watch->name);
+
+		if(value != NULL && g_strcmp0(value, g_hash_table_lookup(parameter->values, watch->name)) != 0)
+			watch->callback(watch->name, value, watch->data);
+	}
+	g_hash_table_destroy(parameter->values);
+	parameter->values = values;
+	return G_SOURCE_CONTINUE;
+}
+
+static void sim_parameter_watch_free(gpointer data)
+{
+	SIM_PARAMETER_WATCH *watch = data;
+
+	g_free(watch->name);
+	g_free(watch);
+}
+
+AXParameter *ax_parameter_new(const gchar *app_name, GError **error)
+{
+	const gchar *path = g_getenv("AXPARAMETER_SIM_FILE");
+	AXParameter *parameter;
+	GHashTable *values;
+
+	if(path == NULL)
+		path = "param.conf";
+	if(!(values = sim_parameter_load(path, error)))
+		return NULL;
+
+	parameter = g_new0(AXParameter, 1);
+	parameter->values = values;
+	parameter->path = g_strdup(path);
+	return parameter;
+}
+
+void ax_parameter_free(AXParameter *parameter)
+{
+	if(parameter == NULL)
+		return;
+	if(parameter->reload_source != 0)
+		g_source_remove(parameter->reload_source);
+	g_list_free_full(parameter->watches, sim_parameter_watch_free);
+	g_hash_table_destroy(parameter->values);
+	g_free(parameter->path);
+	g_free(parameter);
+}
+
+gboolean ax_parameter_get(AXParameter *parameter, const gchar *name, gchar **value, GError **error)
+{
+	const gchar *found = g_hash_table_lookup(parameter->values, name);
+
+	if(found == NULL)
+	{
+		g_set_error(error, sim_error_quark(), 3, "no parameter %s", name);
+		return FALSE;
+	}
+	*value = g_strdup(found);
+	return TRUE;
+}
+
+gboolean ax_parameter_set(AXParameter *parameter, const gchar *name, const gchar *value, gboolean do_sync, GError **error)
+{
+	g_hash_table_replace(parameter->values, g_strdup(name), g_strdup(value));
+	return TRUE;
+}
+
+gboolean ax_parameter_register_callback(AXParameter *parameter, const gchar *name, AXParameterCallback callback, gpointer userdata, GError **error)
+{
+	SIM_PARAMETER_WATCH *watch = g_new0(SIM_PARAMETER_WATCH, 1);
+
+	watch->name = g_strdup(name);
+	watch->callback = callback;
+	watch->data = userdata;
+	parameter->watches = g_list_append(parameter->watches, watch);
+	if(parameter->reload_source == 0)
+		parameter->reload_source = g_unix_signal_add(SIGHUP, sim_parameter_reload, parameter);
+	return TRUE;
+}
+
+int licensekey_verify(const char *app_name, int app_id, int major_version, int minor_version)
+{
+	return 1;
+}
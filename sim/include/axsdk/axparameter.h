@@ -0,0 +1,20 @@
+/*
+ * Host replacement for the SDK axparameter header, used by the simulator build.
+ * Only the calls used by panoramatv are declared.
+ */
+#ifndef __SIM_AXPARAMETER_H__
+#define __SIM_AXPARAMETER_H__
+
+#include <glib.h>
+
+typedef struct _AXParameter AXParameter;
+
+typedef void (*AXParameterCallback)(const gchar *name, const gchar *value, gpointer data);
+
+AXParameter *ax_parameter_new(const gchar *app_name, GError **error);
+void ax_parameter_free(AXParameter *parameter);
+gboolean ax_parameter_get(AXParameter *parameter, const gchar *name, gchar **value, GError **error);
+gboolean ax_parameter_set(AXParameter *parameter, const gchar *name, const gchar *value, gboolean do_sync, GError **error);
+gboolean ax_parameter_register_callback(AXParameter *parameter, const gchar *name, AXParameterCallback callback, gpointer userdata, GError **error);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Host replacement for the SDK axptz header, used by the simulator build.
+ * Only the types and calls used by panoramatv are declared.
+ */
+#ifndef __SIM_AXPTZ_H__
+#define __SIM_AXPTZ_H__
+
+#include <glib.h>
+#include <fixmath.h>
+
+#define AX_PTZ_MOVEMENT_NO_VALUE ((fixed_t)0x7fffffff)
+
+typedef struct _AXPTZControlQueueGroup AXPTZControlQueueGroup;
+typedef struct _AXPTZAbsoluteMovement AXPTZAbsoluteMovement;
+typedef struct _AXPTZRelativeMovement AXPTZRelativeMovement;
+typedef struct _AXPTZContinuousMovement AXPTZContinuousMovement;
+
+typedef struct _AXPTZStatus
+{
+  fixed_t pan_value;
+  fixed_t tilt_value;
+  fixed_t zoom_value;
+} AXPTZStatus;
+
+typedef struct _AXPTZLimits
+{
+  fixed_t min_pan_value;
+  fixed_t max_pan_value;
+  fixed_t min_tilt_value;
+  fixed_t max_tilt_value;
+  fixed_t min_zoom_value;
+  fixed_t max_zoom_value;
+} AXPTZLimits;
+
+typedef enum
+{
+  AX_PTZ_MOVEMENT_PAN_TILT_UNITLESS,
+  AX_PTZ_MOVEMENT_PAN_TILT_DEGREE
+} AXPTZMovementPanTiltSpace;
+
+typedef enum
+{
+  AX_PTZ_MOVEMENT_PAN_TILT_SPEED_UNITLESS,
+  AX_PTZ_MOVEMENT_PAN_TILT_SPEED_DEGREE
+} AXPTZMovementPanTiltSpeedSpace;
+
+typedef enum
+{
+  AX_PTZ_MOVEMENT_ZOOM_UNITLESS
+} AXPTZMovementZoomSpace;
+
+typedef enum
+{
+  AX_PTZ_PRESET_MOVEMENT_UNITLESS
+} AXPTZPresetMovementSpace;
+
+typedef enum
+{
+  AX_PTZ_INVOKE_ASYNC,
+  AX_PTZ_INVOKE_SYNC
+} AXPTZInvoke;
+
+typedef enum
+{
+  AX_PTZ_CONTROL_QUEUE_REQUEST,
+  AX_PTZ_CONTROL_QUEUE_DROP,
+  AX_PTZ_CONTROL_QUEUE_GET,
+  AX_PTZ_CONTROL_QUEUE_QUERY_STATUS
+} AXPTZControlQueueRequest;
+
+typedef void (*AXPTZCallback)(gpointer user_data, GError *error);
+
+gboolean ax_ptz_create(GError **error);
+gboolean ax_ptz_destroy(GError **error);
+
+AXPTZControlQueueGroup *ax_ptz_control_queue_get_app_group_instance(GError **error);
+gboolean ax_ptz_control_queue_request(AXPTZControlQueueGroup *group, gint channel, AXPTZControlQueueRequest request, gint *queue_pos, gint *time_to_pos_one, gint *poll_time, GError **error);
+
+GList *ax_ptz_movement_handler_get_move_capabilities(gint channel, GError **error);
+gboolean ax_ptz_movement_handler_is_ptz_moving(gint channel, gboolean *is_moving, GError **error);
+gboolean ax_ptz_movement_handler_get_ptz_status(gint channel, AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementZoomSpace zoom_space, AXPTZStatus **status, GError **error);
+gboolean ax_ptz_movement_handler_get_ptz_limits(gint channel, AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementZoomSpace zoom_space, AXPTZLimits **limits, GError **error);
+
+gboolean ax_ptz_movement_handler_set_absolute_spaces(AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, AXPTZMovementZoomSpace zoom_space, GError **error);
+AXPTZAbsoluteMovement *ax_ptz_absolute_movement_create(GError **error);
+gboolean ax_ptz_absolute_movement_set_pan_tilt_zoom(AXPTZAbsoluteMovement *movement, fixed_t pan, fixed_t tilt, fixed_t pan_tilt_speed, fixed_t zoom, fixed_t zoom_speed, GError **error);
+gboolean ax_ptz_absolute_movement_destroy(AXPTZAbsoluteMovement *movement, GError **error);
+gboolean ax_ptz_movement_handler_absolute_move(AXPTZControlQueueGroup *group, gint channel, AXPTZAbsoluteMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error);
+
+gboolean ax_ptz_movement_handler_set_relative_spaces(AXPTZMovementPanTiltSpace pan_tilt_space, AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, AXPTZMovementZoomSpace zoom_space, GError **error);
+AXPTZRelativeMovement *ax_ptz_relative_movement_create(GError **error);
+gboolean ax_ptz_relative_movement_set_pan_tilt_zoom(AXPTZRelativeMovement *movement, fixed_t pan, fixed_t tilt, fixed_t pan_tilt_speed, fixed_t zoom, fixed_t zoom_speed, GError **error);
+gboolean ax_ptz_relative_movement_destroy(AXPTZRelativeMovement *movement, GError **error);
+gboolean ax_ptz_movement_handler_relative_move(AXPTZControlQueueGroup *group, gint channel, AXPTZRelativeMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error);
+
+gboolean ax_ptz_movement_handler_set_continuous_spaces(AXPTZMovementPanTiltSpeedSpace pan_tilt_speed_space, GError **error);
+AXPTZContinuousMovement *ax_ptz_continuous_movement_create(GError **error);
+gboolean ax_ptz_continuous_movement_set_pan_tilt_zoom(AXPTZContinuousMovement *movement, fixed_t pan_speed, fixed_t tilt_speed, fixed_t zoom_speed, fixed_t timeout, GError **error);
+gboolean ax_ptz_continuous_movement_destroy(AXPTZContinuousMovement *movement, GError **error);
+gboolean ax_ptz_movement_handler_continuous_start(AXPTZControlQueueGroup *group, gint channel, AXPTZContinuousMovement *movement, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error);
+gboolean ax_ptz_movement_handler_continuous_stop(AXPTZControlQueueGroup *group, gint channel, gboolean stop_pan_tilt, gboolean stop_zoom, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error);
+
+GList *ax_ptz_preset_handler_query_presets(AXPTZControlQueueGroup *group, gint channel, gboolean only_home, GError **error);
+gboolean ax_ptz_preset_handler_goto_preset_number(AXPTZControlQueueGroup *group, gint channel, gint preset_number, fixed_t speed, AXPTZPresetMovementSpace speed_space, AXPTZInvoke invoke, AXPTZCallback callback, gpointer user_data, GError **error);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Host replacement for the SDK fixmath header, used by the simulator build
+ */
+#ifndef __SIM_FIXMATH_H__
+#define __SIM_FIXMATH_H__
+
+#include <stdint.h>
+
+typedef int32_t fixed_t;
+
+#define fx_itox(ival, frac_bits) ((fixed_t)((ival) * (1 << (frac_bits))))
+#define fx_ftox(fval, frac_bits) ((fixed_t)((fval) * (1 << (frac_bits))))
+#define fx_dtox(dval, frac_bits) ((fixed_t)((dval) * (1 << (frac_bits))))
+#define fx_xtoi(fxval, frac_bits) ((fxval) >> (frac_bits))
+#define fx_xtof(fxval, frac_bits) ((float)(fxval) / (1 << (frac_bits)))
+#define fx_xtod(fxval, frac_bits) ((double)(fxval) / (1 << (frac_bits)))
+
+#define fx_addx(op1, op2) ((op1) + (op2))
+#define fx_subx(op1, op2) ((op1) - (op2))
+#define fx_mulx(op1, op2, frac_bits) ((fixed_t)(((int64_t)(op1) * (op2)) >> (frac_bits)))
+#define fx_divx(op1, op2, frac_bits) ((fixed_t)(((int64_t)(op1) << (frac_bits)) / (op2)))
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ * Host replacement for the SDK license key header, used by the simulator build
+ */
+#ifndef __SIM_LICENSEKEY_H__
+#define __SIM_LICENSEKEY_H__
+
+int licensekey_verify(const char *app_name, int app_id, int major_version, int minor_version);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * status.cgi: the panoramatv tour state as JSON.
+ *
+ * Installed through HTTPCGIPATHS, served at /local/panoramatv/status.cgi.
+ * It only reads the shared-memory snapshot panoramatv publishes, so a
+ * request costs the tour nothing. Run it from a shell to query a local
+ * panoramatv_sim the same way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "status_snapshot.h"
+
+static const gchar *state_names[] = { "starting", "calibrating", "touring", "paused", "stopped", "interrupted", "recovering" };
+static const gchar *segment_mode_names[] = { "continuous", "absolute", "hybrid" };
+
+/*
+ * Print <text> as a quoted JSON string
+ */
+static void print_json_string(const gchar *text)
+{
+	const guchar *c;
+
+	putchar('"');
+	for(c = (const guchar *)text ; *c != '\0' ; c ++)
+	{
+		if(*c == '"' || *c == '\\')
+			printf("\\%c", *c);
+		else if(*c < 0x20)
+			printf("\\u%04x", *c);
+		else
+			putchar(*c);
+	}
+	putchar('"');
+}
+
+int main(int argc, char **argv)
+{
+	GError *local_error = NULL;
+	const STATUS_SNAPSHOT_SHM *shm;
+	STATUS_SNAPSHOT s;
+	gint64 now = g_get_monotonic_time();
+
+	printf("Content-Type: application/json\r\nCache-Control: no-cache\r\n\r\n");
+
+	if(!(shm = status_snapshot_map(&local_error)))
+	{
+		printf("{\"running\":false,\"error\":");
+		print_json_string(local_error->message);
+		printf("}\n");
+		g_error_free(local_error);
+		return EXIT_SUCCESS;
+	}
+	if(!status_snapshot_read(shm, &s))
+	{
+		printf("{\"running\":true,\"error\":\"snapshot busy\"}\n");
+		status_snapshot_unmap(shm);
+		return EXIT_SUCCESS;
+	}
+	status_snapshot_unmap(shm);
+
+	printf("{\"running\":true,\"pid\":%d,\"uptime_s\":%.1f,\"age_ms\":%.1f,", s.pid,
+		(now - s.start_us) / (gdouble)G_USEC_PER_SEC, (now - s.updated_us) / 1000.0);
+	s.profile[sizeof(s.profile) - 1] = '\0';
+	printf("\"state\":\"%s\",\"segment_mode\":\"%s\",\"profile\":",
+		state_names[CLAMP(s.state, STATUS_STATE_STARTING, STATUS_STATE_RECOVERING)], segment_mode_names[CLAMP(s.segment_mode, 0, 2)]);
+	print_json_string(s.profile);
+	printf(",");
+	printf("\"tour\":{\"lap\":%d,\"segment\":%d,\"waypoints\":%d,\"target\":[%d,%d,%d],\"from\":[%d,%d,%d]},",
+		s.lap, s.segment, s.waypoints, s.target[0], s.target[1], s.target[2], s.position[0], s.position[1], s.position[2]);
+	printf("\"control_queue\":{\"queue_pos\":%d,\"time_to_pos_one\":%d,\"poll_time\":%d},",
+		s.queue_pos, s.time_to_pos_one, s.poll_time);
+	printf("\"counters\":{\"laps\":%d,\"lap_mean_ms\":%d,\"lap_max_ms\":%d,\"lap_last_ms\":%d,\"presets\":%d,",
+		s.laps, s.lap_mean_ms, s.lap_max_ms, s.lap_last_ms, s.presets);
+	printf("\"arrival_mean\":{\"continuous\":%d,\"absolute\":%d,\"approach\":%d},",
+		s.arrival_mean[0], s.arrival_mean[1], s.arrival_mean[2]);
+	printf("\"arrival_max\":{\"continuous\":%d,\"absolute\":%d,\"approach\":%d},",
+		s.arrival_max[0], s.arrival_max[1], s.arrival_max[2]);
+	printf("\"stalls\":%d,\"skipped\":%d,\"pauses\":%d,\"paused_ms\":%d,\"resume_latency_max_us\":%d,",
+		s.stalls, s.skipped, s.pauses, s.paused_ms, s.resume_latency_max_us);
+	printf("\"interrupts\":%d,\"interrupt_command_max_us\":%d,\"interrupt_motion_max_us\":%d,\"tick_overruns\":%d,\"tick_max_latency_us\":%d,",
+		s.interrupts, s.interrupt_command_max_us, s.interrupt_motion_max_us, s.tick_overruns, s.tick_max_latency_us);
+	printf("\"ptz_errors\":%d,\"ptz_restarts\":%d,\"ptz_outage_max_ms\":%d}}\n",
+		s.ptz_errors, s.ptz_restarts, s.ptz_outage_max_ms);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/*
+ * Tour status snapshot in POSIX shared memory.
+ *
+ * There is a single writer, the thread driving the tour. It bumps the
+ * sequence to odd, copies the snapshot and bumps it back to even; readers
+ * copy the snapshot out and retry when the sequence was odd or changed.
+ * Neither side takes a lock or makes a system call per update.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "status_snapshot.h"
+
+#define STATUS_SNAPSHOT_READ_RETRIES 100
+
+static STATUS_SNAPSHOT_SHM *snapshot_shm = NULL;
+
+static GQuark status_snapshot_error_quark(void)
+{
+	return g_quark_from_static_string("panoramatv-status-snapshot-error");
+}
+
+gboolean status_snapshot_open(GError **error)
+{
+	gint fd;
+	void *map;
+
+	if((fd = shm_open(STATUS_SNAPSHOT_NAME, O_RDWR | O_CREAT, 0644)) < 0)
+	{
+		g_set_error(error, status_snapshot_error_quark(), errno, "can not open shared memory %s: %s", STATUS_SNAPSHOT_NAME, strerror(errno));
+		return FALSE;
+	}
+	if(ftruncate(fd, sizeof(STATUS_SNAPSHOT_SHM)) != 0)
+	{
+		g_set_error(error, status_snapshot_error_quark(), errno, "can not size shared memory %s: %s", STATUS_SNAPSHOT_NAME, strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+	map = mmap(NULL, sizeof(STATUS_SNAPSHOT_SHM), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		g_set_error(error, status_snapshot_error_quark(), errno, "can not map shared memory %s: %s", STATUS_SNAPSHOT_NAME, strerror(errno));
+		return FALSE;
+	}
+
+	snapshot_shm = map;
+	memset(snapshot_shm, 0, sizeof(*snapshot_shm));
+	memcpy(snapshot_shm->magic, STATUS_SNAPSHOT_MAGIC, sizeof(snapshot_shm->magic));
+	snapshot_shm->version = STATUS_SNAPSHOT_VERSION;
+	return TRUE;
+}
+
+/*
+ * Unmap and remove the object, so a stopped application serves nothing stale
+ */
+void status_snapshot_close(void)
+{
+	if(snapshot_shm == NULL)
+		return;
+	munmap(snapshot_shm, sizeof(STATUS_SNAPSHOT_SHM));
+	shm_unlink(STATUS_SNAPSHOT_NAME);
+	snapshot_shm = NULL;
+}
+
+void status_snapshot_publish(const STATUS_SNAPSHOT *snapshot)
+{
+	if(snapshot_shm == NULL)
+		return;
+
+	g_atomic_int_inc(&snapshot_shm->sequence);
+	memcpy(&snapshot_shm->snapshot, snapshot, sizeof(*snapshot));
+	g_atomic_int_inc(&snapshot_shm->sequence);
+}
+
+/*
+ * Map the snapshot read-only for status.cgi
+ */
+const STATUS_SNAPSHOT_SHM *status_snapshot_map(GError **error)
+{
+	struct stat st;
+	const STATUS_SNAPSHOT_SHM *shm;
+	gint fd;
+	void *map;
+
+	if((fd = shm_open(STATUS_SNAPSHOT_NAME, O_RDONLY, 0)) < 0 || fstat(fd, &st) != 0)
+	{
+		g_set_error(error, status_snapshot_error_quark(), errno, "can not open shared memory %s: %s", STATUS_SNAPSHOT_NAME, strerror(errno));
+		if(fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	if((gsize)st.st_size < sizeof(STATUS_SNAPSHOT_SHM))
+	{
+		g_set_error(error, status_snapshot_error_quark(), EINVAL, "%s is too short for a status snapshot", STATUS_SNAPSHOT_NAME);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, sizeof(STATUS_SNAPSHOT_SHM), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		g_set_error(error, status_snapshot_error_quark(), errno, "can not map shared memory %s: %s", STATUS_SNAPSHOT_NAME, strerror(errno));
+		return NULL;
+	}
+
+	shm = map;
+	if(memcmp(shm->magic, STATUS_SNAPSHOT_MAGIC, sizeof(shm->magic)) != 0 || shm->version != STATUS_SNAPSHOT_VERSION)
+	{
+		g_set_error(error, status_snapshot_error_quark(), EINVAL, "%s is not a version %d status snapshot", STATUS_SNAPSHOT_NAME, STATUS_SNAPSHOT_VERSION);
+		munmap(map, sizeof(STATUS_SNAPSHOT_SHM));
+		return NULL;
+	}
+	return shm;
+}
+
+void status_snapshot_unmap(const STATUS_SNAPSHOT_SHM *shm)
+{
+	munmap((void *)shm, sizeof(STATUS_SNAPSHOT_SHM));
+}
+
+/*
+ * Copy out a consistent snapshot, FALSE if the writer kept overtaking us
+ */
+gboolean status_snapshot_read(const STATUS_SNAPSHOT_SHM *shm, STATUS_SNAPSHOT *snapshot)
+{
+	gint i;
+
+	for(i = 0 ; i < STATUS_SNAPSHOT_READ_RETRIES ; i ++)
+	{
+		gint before = g_atomic_int_get(&shm->sequence);
+
+		if(before & 1)
+		{
+			g_usleep(10);
+			continue;
+		}
+		memcpy(snapshot, &shm->snapshot, sizeof(*snapshot));
+		if(g_atomic_int_get(&shm->sequence) == before)
+			return TRUE;
+	}
+	return FALSE;
+}
@@ -0,0 +1,90 @@
+/*
+ * Tour status snapshot in POSIX shared memory.
+ *
+ * panoramatv publishes its tour state and rolling counters at segment,
+ * lap and pause boundaries; status.cgi maps the same object read-only and
+ * serves it, so a request never has to reach the control loop.
+ */
+#ifndef __STATUS_SNAPSHOT_H__
+#define __STATUS_SNAPSHOT_H__
+
+#include <glib.h>
+
+#define STATUS_SNAPSHOT_NAME "/panoramatv-status"
+#define STATUS_SNAPSHOT_MAGIC "PTVSTATE"
+#define STATUS_SNAPSHOT_VERSION 4
+
+typedef enum
+{
+	STATUS_STATE_STARTING = 0,
+	STATUS_STATE_CALIBRATING,
+	STATUS_STATE_TOURING,
+	STATUS_STATE_PAUSED,
+	STATUS_STATE_STOPPED,
+	STATUS_STATE_INTERRUPTED,
+	STATUS_STATE_RECOVERING
+} STATUS_STATE;
+
+typedef struct STATUS_SNAPSHOT{
+
+	gint64 start_us;		/* monotonic time panoramatv started */
+	gint64 updated_us;		/* monotonic time of this snapshot */
+	gint32 pid;
+	gint32 state;			/* STATUS_STATE */
+	gint32 segment_mode;		/* 0 continuous, 1 absolute, 2 hybrid */
+	gchar profile[16];		/* active tour profile */
+
+	/* tour position */
+	gint32 lap;
+	gint32 segment;
+	gint32 waypoints;
+	gint32 target[3];		/* pan/tilt/zoom of the waypoint moved to */
+	gint32 position[3];		/* pan/tilt/zoom at the segment start */
+
+	/* control queue, as last reported */
+	gint32 queue_pos;
+	gint32 time_to_pos_one;
+	gint32 poll_time;
+
+	/* counters since the start */
+	gint32 laps;
+	gint32 lap_mean_ms;
+	gint32 lap_max_ms;
+	gint32 lap_last_ms;
+	gint32 presets;
+	gint32 arrival_mean[3];		/* continuous, absolute, approach */
+	gint32 arrival_max[3];
+	gint32 stalls;
+	gint32 skipped;
+	gint32 pauses;
+	gint32 paused_ms;
+	gint32 resume_latency_max_us;
+	gint32 interrupts;
+	gint32 interrupt_command_max_us;
+	gint32 interrupt_motion_max_us;
+	gint32 tick_overruns;
+	gint32 tick_max_latency_us;
+	gint32 ptz_errors;
+	gint32 ptz_restarts;		/* axptz library created again */
+	gint32 ptz_outage_max_ms;
+
+}STATUS_SNAPSHOT;
+
+typedef struct STATUS_SNAPSHOT_SHM{
+
+	gchar magic[8];
+	guint32 version;
+	gint sequence;			/* odd while the writer is copying */
+	STATUS_SNAPSHOT snapshot;
+
+}STATUS_SNAPSHOT_SHM;
+
+gboolean status_snapshot_open(GError **error);
+void status_snapshot_close(void);
+void status_snapshot_publish(const STATUS_SNAPSHOT *snapshot);
+
+const STATUS_SNAPSHOT_SHM *status_snapshot_map(GError **error);
+void status_snapshot_unmap(const STATUS_SNAPSHOT_SHM *shm);
+gboolean status_snapshot_read(const STATUS_SNAPSHOT_SHM *shm, STATUS_SNAPSHOT *snapshot);
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * Tour schedule over UDP multicast.
+ *
+ * One thread per instance. The leader sends the schedule set with
+ * tour_sync_set_schedule once per announce interval; a follower takes the
+ * receive time right off poll() and keeps the clock offset as the largest
+ * (sent_us - received_us) of the last TOUR_SYNC_OFFSET_WINDOW announcements,
+ * which is the one that waited least on the way. On one host all instances
+ * share the monotonic clock and the offset is the delivery delay, a few us.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "tour_sync.h"
+
+#define TOUR_SYNC_OFFSET_WINDOW 16
+
+static gint sync_fd = -1;
+static struct sockaddr_in sync_addr;
+static gboolean sync_leader = FALSE;
+static gint sync_announce_ms = 1000;
+static gint sync_running = FALSE;
+static GThread *sync_thread = NULL;
+
+/* the schedule, guarded by sync_lock */
+static GMutex sync_lock;
+static TOUR_SYNC_SCHEDULE sync_schedule;
+static gint64 sync_offsets[TOUR_SYNC_OFFSET_WINDOW];
+static gint sync_offset_count = 0;
+
+static GQuark tour_sync_error_quark(void)
+{
+	return g_quark_from_static_string("panoramatv-tour-sync-error");
+}
+
+static void sync_announce(void)
+{
+	gchar message[TOUR_SYNC_MESSAGE_LENGTH];
+	gint len;
+
+	g_mutex_lock(&sync_lock);
+	if(!sync_schedule.valid)
+	{
+		g_mutex_unlock(&sync_lock);
+		return;
+	}
+	len = g_snprintf(message, sizeof(message), "ptvsync %d %u %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT,
+		TOUR_SYNC_VERSION, ++ sync_schedule.sequence, sync_schedule.epoch_us, sync_schedule.period_us, g_get_monotonic_time());
+	g_mutex_unlock(&sync_lock);
+	/* a lost announcement is made up for by the next one */
+	sendto(sync_fd, message, len, 0, (struct sockaddr *)&sync_addr, sizeof(sync_addr));
+}
+
+static void sync_receive(gint64 received_us)
+{
+	gchar message[TOUR_SYNC_MESSAGE_LENGTH];
+	gint version;
+	guint sequence;
+	gint64 epoch_us;
+	gint64 period_us;
+	gint64 sent_us;
+	gint64 offset_us;
+	gssize len;
+	gint i;
+
+	if((len = recv(sync_fd, message, sizeof(message) - 1, 0)) <= 0)
+		return;
+	message[len] = '\0';
+	if(sscanf(message, "ptvsync %d %u %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT, &version, &sequence, &epoch_us, &period_us, &sent_us) != 5
+		|| version != TOUR_SYNC_VERSION || period_us <= 0)
+		return;
+
+	g_mutex_lock(&sync_lock);
+	sync_offsets[sync_offset_count ++ % TOUR_SYNC_OFFSET_WINDOW] = sent_us - received_us;
+	offset_us = G_MININT64;
+	for(i = 0 ; i < MIN(sync_offset_count, TOUR_SYNC_OFFSET_WINDOW) ; i ++)
+		offset_us = MAX(offset_us, sync_offsets[i]);
+	sync_schedule.offset_us = offset_us;
+	sync_schedule.epoch_us = epoch_us - offset_us;
+	sync_schedule.period_us = period_us;
+	sync_schedule.received_us = received_us;
+	sync_schedule.sequence = sequence;
+	sync_schedule.valid = TRUE;
+	g_mutex_unlock(&sync_lock);
+}
+
+static gpointer sync_thread_func(gpointer data)
+{
+	struct pollfd fds = { sync_fd, POLLIN, 0 };
+	gint64 next_announce_us = g_get_monotonic_time();
+
+	while(g_atomic_int_get(&sync_running))
+	{
+		gint timeout_ms = sync_announce_ms;
+
+		if(sync_leader)
+		{
+			gint64 now = g_get_monotonic_time();
+
+			if(now >= next_announce_us)
+			{
+				sync_announce();
+				next_announce_us = now + (gint64)sync_announce_ms * 1000;
+			}
+			timeout_ms = (gint)((next_announce_us - now) / 1000) + 1;
+		}
+		if(poll(&fds, 1, MIN(timeout_ms, sync_announce_ms)) > 0 && (fds.revents & POLLIN))
+		{
+			gint64 received_us = g_get_monotonic_time();
+
+			/* the leader hears its own announcements on loopback */
+			if(sync_leader)
+				recv(sync_fd, NULL, 0, MSG_DONTWAIT);
+			else
+				sync_receive(received_us);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Join <group>:<port>. Several instances on one host can share the port.
+ */
+gboolean tour_sync_open(const gchar *group, gint port, gboolean leader, gint announce_ms, GError **error)
+{
+	struct ip_mreq mreq;
+	struct sockaddr_in bind_addr;
+	gint reuse = 1;
+
+	memset(&sync_addr, 0, sizeof(sync_addr));
+	sync_addr.sin_family = AF_INET;
+	sync_addr.sin_port = htons(port);
+	if(inet_pton(AF_INET, group, &sync_addr.sin_addr) != 1 || !IN_MULTICAST(ntohl(sync_addr.sin_addr.s_addr)))
+	{
+		g_set_error(error, tour_sync_error_quark(), EINVAL, "%s is not a multicast group", group);
+		return FALSE;
+	}
+	memset(&bind_addr, 0, sizeof(bind_addr));
+	bind_addr.sin_family = AF_INET;
+	bind_addr.sin_port = htons(port);
+	bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.imr_multiaddr = sync_addr.sin_addr;
+	mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+	if((sync_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0
+		|| setsockopt(sync_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+		|| bind(sync_fd, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) != 0
+		|| setsockopt(sync_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0)
+	{
+		g_set_error(error, tour_sync_error_quark(), errno, "can not join %s:%d: %s", group, port, strerror(errno));
+		if(sync_fd >= 0)
+			close(sync_fd);
+		sync_fd = -1;
+		return FALSE;
+	}
+
+	memset(&sync_schedule, 0, sizeof(sync_schedule));
+	sync_offset_count = 0;
+	sync_leader = leader;
+	sync_announce_ms = MAX(announce_ms, 10);
+	g_atomic_int_set(&sync_running, TRUE);
+	sync_thread = g_thread_new("sync", sync_thread_func, NULL);
+	return TRUE;
+}
+
+void tour_sync_close(void)
+{
+	if(sync_thread == NULL)
+		return;
+	g_atomic_int_set(&sync_running, FALSE);
+	g_thread_join(sync_thread);
+	sync_thread = NULL;
+	close(sync_fd);
+	sync_fd = -1;
+}
+
+/*
+ * The schedule the leader announces, on its own clock
+ */
+void tour_sync_set_schedule(gint64 epoch_us, gint64 period_us)
+{
+	g_mutex_lock(&sync_lock);
+	sync_schedule.epoch_us = epoch_us;
+	sync_schedule.period_us = period_us;
+	sync_schedule.received_us = g_get_monotonic_time();
+	sync_schedule.valid = TRUE;
+	g_mutex_unlock(&sync_lock);
+}
+
+/*
+ * The schedule on the local clock, FALSE when none was heard within
+ * <max_age_us> (the leader's own schedule never ages)
+ */
+gboolean tour_sync_get_schedule(TOUR_SYNC_SCHEDULE *schedule, gint64 max_age_us)
+{
+	g_mutex_lock(&sync_lock);
+	*schedule = sync_schedule;
+	g_mutex_unlock(&sync_lock);
+	return schedule->valid && (sync_leader || g_get_monotonic_time() - schedule->received_us <= max_age_us);
+}
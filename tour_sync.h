@@ -0,0 +1,39 @@
+/*
+ * Shared tour schedule for cameras that tour in step.
+ *
+ * The leader announces its schedule, an epoch on its monotonic clock and
+ * a lap period, to a UDP multicast group once per interval:
+ *
+ *   ptvsync <version> <sequence> <epoch_us> <period_us> <sent_us>
+ *
+ * Followers map the epoch onto their own clock. Lap k of an instance
+ * starts at epoch + (k + phase) * period, phase being its share of the lap
+ * behind the epoch, so instances run in lockstep or at a fixed offset.
+ */
+#ifndef __TOUR_SYNC_H__
+#define __TOUR_SYNC_H__
+
+#include <glib.h>
+
+#define TOUR_SYNC_DEFAULT_GROUP "239.255.80.84"
+#define TOUR_SYNC_DEFAULT_PORT 5680
+#define TOUR_SYNC_VERSION 1
+#define TOUR_SYNC_MESSAGE_LENGTH 128
+
+typedef struct TOUR_SYNC_SCHEDULE{
+
+	gint64 epoch_us;	/* lap 0 start, on the local monotonic clock */
+	gint64 period_us;
+	gint64 offset_us;	/* leader clock minus local clock */
+	gint64 received_us;	/* local time of the last announcement */
+	guint sequence;
+	gboolean valid;
+
+}TOUR_SYNC_SCHEDULE;
+
+gboolean tour_sync_open(const gchar *group, gint port, gboolean leader, gint announce_ms, GError **error);
+void tour_sync_close(void);
+void tour_sync_set_schedule(gint64 epoch_us, gint64 period_us);
+gboolean tour_sync_get_schedule(TOUR_SYNC_SCHEDULE *schedule, gint64 max_age_us);
+
+#endif
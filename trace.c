@@ -0,0 +1,176 @@
+/*
+ * Binary motion trace in a memory-mapped ring file.
+ *
+ * Writers reserve a slot with one atomic add and copy the record into the
+ * mapping, so tracing costs no system call per record. The capacity is a
+ * power of two so the running count keeps indexing correctly when it wraps.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+static TRACE_HEADER *trace_header = NULL;
+static TRACE_RECORD *trace_records = NULL;
+static gsize trace_length = 0;
+static guint16 trace_segment = 0;
+
+static GQuark trace_error_quark(void)
+{
+	return g_quark_from_static_string("panoramatv-trace-error");
+}
+
+static guint32 round_up_power_of_two(guint32 n)
+{
+	guint32 p = 1;
+
+	while(p < n && p < 0x80000000u)
+		p <<= 1;
+	return p;
+}
+
+gboolean trace_open(const gchar *path, guint capacity, GError **error)
+{
+	gint fd;
+	void *map;
+
+	capacity = round_up_power_of_two(MAX(capacity, 64));
+	trace_length = sizeof(TRACE_HEADER) + (gsize)capacity * sizeof(TRACE_RECORD);
+
+	if((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+	{
+		g_set_error(error, trace_error_quark(), errno, "can not open trace file %s: %s", path, strerror(errno));
+		return FALSE;
+	}
+	if(ftruncate(fd, trace_length) != 0)
+	{
+		g_set_error(error, trace_error_quark(), errno, "can not size trace file %s: %s", path, strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+	map = mmap(NULL, trace_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		g_set_error(error, trace_error_quark(), errno, "can not map trace file %s: %s", path, strerror(errno));
+		return FALSE;
+	}
+
+	trace_header = map;
+	memcpy(trace_header->magic, TRACE_MAGIC, sizeof(trace_header->magic));
+	trace_header->version = TRACE_VERSION;
+	trace_header->record_size = sizeof(TRACE_RECORD);
+	trace_header->capacity = capacity;
+	trace_header->count = 0;
+	trace_header->start_us = g_get_monotonic_time();
+	trace_records = (TRACE_RECORD *)(trace_header + 1);
+	return TRUE;
+}
+
+void trace_close(void)
+{
+	if(trace_header == NULL)
+		return;
+	msync(trace_header, trace_length, MS_ASYNC);
+	munmap(trace_header, trace_length);
+	trace_header = NULL;
+	trace_records = NULL;
+}
+
+gboolean trace_enabled(void)
+{
+	return trace_header != NULL;
+}
+
+void trace_set_segment(guint16 segment)
+{
+	trace_segment = segment;
+}
+
+void trace_write(guint8 type, guint8 flags, gint32 v0, gint32 v1, gint32 v2, gint32 v3, gint32 v4, gint32 v5)
+{
+	TRACE_RECORD *record;
+	guint32 n;
+
+	if(trace_header == NULL)
+		return;
+
+	n = (guint32)g_atomic_int_add((gint *)&trace_header->count, 1);
+	record = &trace_records[n & (trace_header->capacity - 1)];
+	record->time_us = g_get_monotonic_time();
+	record->type = type;
+	record->flags = flags;
+	record->segment = trace_segment;
+	record->v[0] = v0;
+	record->v[1] = v1;
+	record->v[2] = v2;
+	record->v[3] = v3;
+	record->v[4] = v4;
+	record->v[5] = v5;
+	record->reserved = 0;
+}
+
+/*
+ * Map a trace file read-only for the replay tool
+ */
+const TRACE_HEADER *trace_map_file(const gchar *path, gsize *length, GError **error)
+{
+	struct stat st;
+	const TRACE_HEADER *header;
+	gint fd;
+	void *map;
+
+	if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) != 0)
+	{
+		g_set_error(error, trace_error_quark(), errno, "can not open trace file %s: %s", path, strerror(errno));
+		if(fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	if((gsize)st.st_size < sizeof(TRACE_HEADER))
+	{
+		g_set_error(error, trace_error_quark(), EINVAL, "%s is too short for a trace file", path);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		g_set_error(error, trace_error_quark(), errno, "can not map trace file %s: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	header = map;
+	if(memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 || header->version != TRACE_VERSION || header->record_size != sizeof(TRACE_RECORD)
+		|| header->capacity == 0 || (header->capacity & (header->capacity - 1)) != 0
+		|| sizeof(TRACE_HEADER) + (gsize)header->capacity * sizeof(TRACE_RECORD) > (gsize)st.st_size)
+	{
+		g_set_error(error, trace_error_quark(), EINVAL, "%s is not a version %d trace file", path, TRACE_VERSION);
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	*length = st.st_size;
+	return header;
+}
+
+void trace_unmap_file(const TRACE_HEADER *header, gsize length)
+{
+	munmap((void *)header, length);
+}
+
+/*
+ * Record n counted from the oldest one still in the ring
+ */
+const TRACE_RECORD *trace_file_record(const TRACE_HEADER *header, guint32 n)
+{
+	const TRACE_RECORD *records = (const TRACE_RECORD *)(header + 1);
+	guint32 first = (header->count > header->capacity) ? header->count - header->capacity : 0;
+
+	return &records[(first + n) & (header->capacity - 1)];
+}
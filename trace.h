@@ -0,0 +1,84 @@
+/*
+ * Binary motion trace: fixed size records in a memory-mapped ring file.
+ *
+ * panoramatv writes the status samples the controller acted on, every
+ * command it issued, the arrival decisions and the control queue requests.
+ * panoramatv_replay reads the file back off-device.
+ */
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <glib.h>
+
+#define TRACE_MAGIC "PTVTRACE"
+#define TRACE_VERSION 1
+#define TRACE_DEFAULT_RECORDS 65536
+
+typedef enum
+{
+	TRACE_CONFIG = 1,	/* flags TRACE_CONFIG_*, v0 max speed, v1 arrival units, v2 tick us, v3 blend tolerance, v4/v5 pan limits */
+	TRACE_STATUS,		/* v0..v2 pan/tilt/zoom of the sample, v3 sample age us */
+	TRACE_SEGMENT,		/* flags pass-through, v0..v2 target, v3..v5 planned speeds */
+	TRACE_COMMAND,		/* flags TRACE_CMD_*, v0..v5 command arguments */
+	TRACE_ARRIVAL,		/* flags TRACE_AXIS_*, v0 position, v1 target, v2 speed, v3 arrived;
+				   TRACE_AXIS_BLEND: v0..v2 position, v3 reached */
+	TRACE_QUEUE,		/* flags request, v0 queue_pos, v1 time_to_pos_one, v2 poll_time */
+	TRACE_SPEED		/* v0 max speed of the segments that follow */
+} TRACE_TYPE;
+
+typedef enum
+{
+	TRACE_CONFIG_PAN_WRAPS = 1,
+	TRACE_CONFIG_FLOAT_MATH = 2
+} TRACE_CONFIG_FLAGS;
+
+typedef enum
+{
+	TRACE_CMD_CONTINUOUS = 1,	/* v0..v2 speeds, v3 timeout ms */
+	TRACE_CMD_STOP,			/* v0 pan/tilt, v1 zoom */
+	TRACE_CMD_ABSOLUTE,		/* v0..v2 position, v3 speed */
+	TRACE_CMD_RELATIVE,		/* v0..v2 offset, v3 speed */
+	TRACE_CMD_PRESET		/* v0 preset number, v1 speed */
+} TRACE_COMMAND_KIND;
+
+typedef enum
+{
+	TRACE_AXIS_PAN = 1,
+	TRACE_AXIS_TILT,
+	TRACE_AXIS_ZOOM,
+	TRACE_AXIS_BLEND
+} TRACE_AXIS;
+
+typedef struct TRACE_RECORD{
+
+	gint64 time_us;
+	guint8 type;
+	guint8 flags;
+	guint16 segment;
+	gint32 v[6];
+	gint32 reserved;
+
+}TRACE_RECORD;
+
+typedef struct TRACE_HEADER{
+
+	gchar magic[8];
+	guint32 version;
+	guint32 record_size;
+	guint32 capacity;
+	guint32 count;
+	gint64 start_us;
+
+}TRACE_HEADER;
+
+gboolean trace_open(const gchar *path, guint capacity, GError **error);
+void trace_close(void);
+gboolean trace_enabled(void);
+void trace_set_segment(guint16 segment);
+void trace_write(guint8 type, guint8 flags, gint32 v0, gint32 v1, gint32 v2, gint32 v3, gint32 v4, gint32 v5);
+
+const TRACE_HEADER *trace_map_file(const gchar *path, gsize *length, GError **error);
+void trace_unmap_file(const TRACE_HEADER *header, gsize length);
+const TRACE_RECORD *trace_file_record(const TRACE_HEADER *header, guint32 n);
+
+#endif
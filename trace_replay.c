@@ -0,0 +1,185 @@
+/*
+ * Offline replay of a panoramatv motion trace.
+ *
+ * Feeds the traced status samples back through the planning and arrival
+ * logic in motion.c and checks that every traced segment plan and arrival
+ * decision comes out the same. Prints a summary of the trace and exits
+ * with a failure if anything differs.
+ *
+ * Usage: panoramatv_replay <trace file> [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "motion.h"
+#include "motion_math.h"
+#include "trace.h"
+
+static const gchar *command_names[] = { "?", "continuous", "stop", "absolute", "relative", "preset" };
+static const gchar *axis_names[] = { "?", "pan", "tilt", "zoom", "blend" };
+
+int main(int argc, char **argv)
+{
+	GError *local_error = NULL;
+	const TRACE_HEADER *header;
+	gsize length = 0;
+	gboolean verbose = (argc > 2 && g_strcmp0(argv[2], "-v") == 0);
+	gfloat max_speed = -1.0f;
+	PTZ_POS from = { 0, 0, 0, FALSE };
+	gboolean have_from = FALSE;
+	fixed_t blend_tolerance = 0;
+	PTZ_POS segment_from = { 0, 0, 0, FALSE };
+	PTZ_POS segment_to = { 0, 0, 0, FALSE };
+	gint pass_through_segments = 0;
+	guint32 total;
+	guint32 n;
+	gint counts[TRACE_SPEED + 1] = { 0 };
+	gint commands[TRACE_CMD_PRESET + 1] = { 0 };
+	gint segment_mismatches = 0;
+	gint arrival_mismatches = 0;
+	gint skipped_segments = 0;
+	gint64 age_sum = 0;
+	gint age_max = 0;
+	gint queue_not_first = 0;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s <trace file> [-v]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(!(header = trace_map_file(argv[1], &length, &local_error)))
+	{
+		fprintf(stderr, "%s\n", local_error->message);
+		g_error_free(local_error);
+		return EXIT_FAILURE;
+	}
+
+	total = MIN(header->count, header->capacity);
+	printf("%s: %u records of %u written, ring of %u\n", argv[1], total, header->count, header->capacity);
+	if(header->count > header->capacity)
+		printf("ring wrapped, replaying the newest %u records\n", total);
+
+	for(n = 0 ; n < total ; n ++)
+	{
+		const TRACE_RECORD *record = trace_file_record(header, n);
+
+		if(record->type >= 1 && record->type <= TRACE_SPEED)
+			counts[record->type] ++;
+
+		switch(record->type)
+		{
+		case TRACE_CONFIG:
+			max_speed = fx_xtof(record->v[0], FIXMATH_FRAC_BITS);
+			blend_tolerance = record->v[3];
+			motion_set_pan_wrap((record->flags & TRACE_CONFIG_PAN_WRAPS) != 0, record->v[4], record->v[5]);
+			printf("config: max speed %.3f, arrival units %d, tick %d us, blend tolerance %.2f, pan %d..%d%s, %s math\n", max_speed, record->v[1], record->v[2],
+				fx_xtof(blend_tolerance, FIXMATH_FRAC_BITS), record->v[4], record->v[5], motion_pan_wraps() ? " wrapping" : "",
+				(record->flags & TRACE_CONFIG_FLOAT_MATH) ? "float" : "q16");
+			if(((record->flags & TRACE_CONFIG_FLOAT_MATH) != 0) != (g_strcmp0(MOTION_MATH_BACKEND, "float") == 0))
+				printf("warning: replaying with %s math, speeds may differ by one unit\n", MOTION_MATH_BACKEND);
+			break;
+
+		case TRACE_STATUS:
+			from.pan_val = record->v[0];
+			from.tilt_val = record->v[1];
+			from.zoom_val = record->v[2];
+			have_from = TRUE;
+			age_sum += record->v[3];
+			age_max = MAX(age_max, record->v[3]);
+			break;
+
+		case TRACE_SEGMENT:
+		{
+			PTZ_POS to = { record->v[0], record->v[1], record->v[2], record->flags != 0 };
+			fixed_t pan_speed;
+			fixed_t tilt_speed;
+			fixed_t zoom_speed;
+
+			if(!have_from || max_speed < 0)
+			{
+				skipped_segments ++;
+				break;
+			}
+			segment_from = from;
+			segment_to = to;
+			if(to.pass_through)
+				pass_through_segments ++;
+			motion_segment_speeds(&from, &to, max_speed, &pan_speed, &tilt_speed, &zoom_speed);
+			if(pan_speed != record->v[3] || tilt_speed != record->v[4] || zoom_speed != record->v[5])
+			{
+				segment_mismatches ++;
+				printf("segment %u MISMATCH: traced %d/%d/%d, replayed %d/%d/%d\n", record->segment,
+					record->v[3], record->v[4], record->v[5], pan_speed, tilt_speed, zoom_speed);
+			}
+			else if(verbose)
+				printf("segment %u to %d/%d/%d speeds %d/%d/%d\n", record->segment, to.pan_val, to.tilt_val, to.zoom_val, pan_speed, tilt_speed, zoom_speed);
+			break;
+		}
+
+		case TRACE_COMMAND:
+			if(record->flags <= TRACE_CMD_PRESET)
+				commands[record->flags] ++;
+			if(verbose)
+				printf("segment %u %s %d %d %d %d\n", record->segment, command_names[record->flags <= TRACE_CMD_PRESET ? record->flags : 0],
+					record->v[0], record->v[1], record->v[2], record->v[3]);
+			break;
+
+		case TRACE_ARRIVAL:
+		{
+			gboolean arrived = FALSE;
+
+			if(record->flags == TRACE_AXIS_PAN)
+				arrived = motion_pan_arrived(record->v[0], record->v[1], record->v[2]);
+			else if(record->flags == TRACE_AXIS_TILT)
+				arrived = motion_tilt_arrived(record->v[0], record->v[1], record->v[2]);
+			else if(record->flags == TRACE_AXIS_ZOOM)
+				arrived = motion_zoom_arrived(record->v[0], record->v[1], record->v[2]);
+			else if(record->flags == TRACE_AXIS_BLEND)
+			{
+				STATUS_SAMPLE sample = { record->time_us, record->v[0], record->v[1], record->v[2] };
+				arrived = motion_blend_reached(&segment_from, &segment_to, &sample, blend_tolerance);
+			}
+			if(arrived != (record->v[3] != 0))
+			{
+				arrival_mismatches ++;
+				printf("segment %u %s arrival MISMATCH at %d target %d speed %d: traced %d, replayed %d\n", record->segment,
+					axis_names[record->flags <= TRACE_AXIS_BLEND ? record->flags : 0], record->v[0], record->v[1], record->v[2], record->v[3] != 0, arrived);
+			}
+			break;
+		}
+
+		case TRACE_QUEUE:
+			if(record->v[0] != 1)
+				queue_not_first ++;
+			break;
+
+		case TRACE_SPEED:
+			max_speed = fx_xtof(record->v[0], FIXMATH_FRAC_BITS);
+			if(verbose)
+				printf("segment %u max speed %.3f\n", record->segment, max_speed);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	printf("status samples: %d, mean age %.1f ms, max age %.1f ms\n", counts[TRACE_STATUS],
+		counts[TRACE_STATUS] ? (gdouble)age_sum / counts[TRACE_STATUS] / 1000.0 : 0.0, age_max / 1000.0);
+	printf("commands: continuous %d, stop %d, absolute %d, relative %d, preset %d\n", commands[TRACE_CMD_CONTINUOUS],
+		commands[TRACE_CMD_STOP], commands[TRACE_CMD_ABSOLUTE], commands[TRACE_CMD_RELATIVE], commands[TRACE_CMD_PRESET]);
+	printf("queue requests: %d, not at position 1: %d\n", counts[TRACE_QUEUE], queue_not_first);
+	printf("segments: %d replayed (%d pass-through), %d skipped, %d mismatched\n", counts[TRACE_SEGMENT] - skipped_segments, pass_through_segments,
+		skipped_segments, segment_mismatches);
+	printf("arrival checks: %d replayed, %d mismatched\n", counts[TRACE_ARRIVAL], arrival_mismatches);
+
+	trace_unmap_file(header, length);
+
+	if(segment_mismatches > 0 || arrival_mismatches > 0)
+	{
+		printf("replay FAILED\n");
+		return EXIT_FAILURE;
+	}
+	printf("replay PASSED\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+ * panoramatv_trigger: send a preset interrupt request to panoramatv.
+ *
+ * Stands in for an I/O port or event trigger: run it from a shell, an
+ * event script or a test to swing the camera to a preset mid-tour.
+ * The request carries the send time, so panoramatv reports the latency
+ * from here to the preset command.
+ *
+ * Usage: panoramatv_trigger [-s socket] preset <number> [hold_ms]
+ *        panoramatv_trigger [-s socket] release
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <glib.h>
+#include "preset_interrupt.h"
+
+static int usage(const gchar *name)
+{
+	fprintf(stderr, "usage: %s [-s socket] preset <number> [hold_ms]\n       %s [-s socket] release\n", name, name);
+	return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+	const gchar *path = PRESET_INTERRUPT_DEFAULT_SOCKET;
+	gchar message[PRESET_INTERRUPT_MESSAGE_LENGTH];
+	struct sockaddr_un addr;
+	gint arg = 1;
+	gint fd;
+
+	if(argc > 2 && g_strcmp0(argv[1], "-s") == 0)
+	{
+		path = argv[2];
+		arg = 3;
+	}
+	if(argc - arg >= 2 && g_strcmp0(argv[arg], "preset") == 0)
+	{
+		gint hold_ms = (argc - arg >= 3) ? atoi(argv[arg + 2]) : -1;
+
+		g_snprintf(message, sizeof(message), "preset %d %d %" G_GINT64_FORMAT, atoi(argv[arg + 1]), hold_ms, g_get_monotonic_time());
+	}
+	else if(argc - arg == 1 && g_strcmp0(argv[arg], "release") == 0)
+	{
+		g_strlcpy(message, "release", sizeof(message));
+	}
+	else
+	{
+		return usage(argv[0]);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "socket path %s is too long\n", path);
+		return EXIT_FAILURE;
+	}
+	g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+	if((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0)
+	{
+		fprintf(stderr, "can not create socket: %s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if(sendto(fd, message, strlen(message), 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		fprintf(stderr, "can not send to %s: %s\n", path, strerror(errno));
+		close(fd);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	return EXIT_SUCCESS;
+}